@@ -0,0 +1,910 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include "CavQMSerial.h"
+#include "CavQMUapi.h"
+
+// Create /dev/cavatN next to the AT ttyUSB node
+static bool at_broker;
+
+// Default time a command may take until its final result code
+static uint at_timeout_ms = CAV_AT_TIMEOUT_MS_DEFAULT;
+
+// Client states
+#define CAV_AT_IDLE 0
+#define CAV_AT_QUEUED 1 // waiting for the port
+#define CAV_AT_ACTIVE 2 // sent, waiting for the final result code
+#define CAV_AT_DONE 3 // response ready to read
+
+// Broker drain states, the response being received has no client
+#define CAV_AT_DRAIN_CLOSED 1 // owner of the command in progress closed
+#define CAV_AT_DRAIN_LATE 2 // command timed out, its result may follow
+
+// Open file of /dev/cavatN, one command in progress at a time
+typedef struct _cav_at_client {
+	struct list_head List; // broker Queue while CAV_AT_QUEUED
+	struct _cav_at_broker *pBroker;
+	struct mutex Lock; // serializes read and write of the client
+	wait_queue_head_t Wait;
+	int State;
+	char Cmd[CAV_AT_CMD_MAX];
+	unsigned int CmdLen;
+	char *pResp;
+	unsigned int RespLen;
+	unsigned int RespRead;
+	unsigned int TimeoutMs;
+	ktime_t QueuedAt;
+	ktime_t SentAt;
+	struct cav_at_result Result; // of the last completed command
+} cav_at_client;
+
+typedef struct _cav_at_broker {
+	cav_device_context *Context;
+	cav_char_dev Char;
+	spinlock_t Lock; // everything below and the client states
+	struct list_head Queue;
+	cav_at_client *pCurrent;
+	int bDraining; // CAV_AT_DRAIN_*, queue held until a result code
+	unsigned long Deadline; // jiffies, of the command or the drain
+	ktime_t SentAt;
+	struct delayed_work TimeoutWork;
+	char Line[CAV_AT_LINE_MAX]; // start of the response line being read
+	unsigned int LineLen;
+	unsigned int Depth; // commands queued or in progress
+	unsigned int DepthMax;
+	u64 Commands;
+	u64 Timeouts;
+	u64 RttTotalUs;
+	unsigned int RttUs;
+	unsigned int RttMaxUs;
+} cav_at_broker;
+
+/*===========================================================================
+METHOD:
+   CavAtFinal
+
+DESCRIPTION:
+   Check whether a response line is a final result code
+
+PARAMETERS:
+   pLine: [ I ] - NULL-terminated response line without its line ending
+   len:   [ I ] - line length
+
+RETURN VALUE:
+   int - zero if the command continues
+       - CAV_AT_OK for OK and CONNECT
+       - CAV_AT_ERROR for the error result codes
+===========================================================================*/
+int CavAtFinal(const char *pLine, unsigned int len)
+{
+	static const char *const errors[] = {
+		"ERROR",      "+CME ERROR:", "+CMS ERROR:", "NO CARRIER",
+		"BUSY",       "NO ANSWER",   "NO DIALTONE",
+	};
+	unsigned int index;
+
+	if (((len == 2) && (memcmp(pLine, "OK", 2) == 0)) ||
+	    ((len >= 7) && (memcmp(pLine, "CONNECT", 7) == 0))) {
+		return CAV_AT_OK;
+	}
+	for (index = 0; index < ARRAY_SIZE(errors); index++) {
+		if (strncmp(pLine, errors[index], strlen(errors[index])) ==
+		    0) {
+			return CAV_AT_ERROR;
+		}
+	}
+	return 0;
+} // CavAtFinal
+
+/*===========================================================================
+METHOD:
+   CavAtStart
+
+DESCRIPTION:
+   Send the command at the head of the queue if the port is free. A
+   command is only sent whole, while the write queue has no room for it
+   it stays queued until CavAtTxRoom. Called with the broker lock held.
+
+PARAMETERS:
+   pBroker: [ I ] - AT broker of the port
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavAtStart(cav_at_broker *pBroker)
+{
+	cav_at_client *pClient;
+
+	if ((pBroker->pCurrent != NULL) || (pBroker->bDraining != 0) ||
+	    list_empty(&pBroker->Queue)) {
+		return;
+	}
+
+	pClient = list_first_entry(&pBroker->Queue, cav_at_client, List);
+	// Current before the command can reach the device, so CavAtRx takes
+	// the response
+	pBroker->pCurrent = pClient;
+	pBroker->LineLen = 0;
+	if (CavTxQueueAll(pBroker->Context,
+			  (const unsigned char *)pClient->Cmd,
+			  pClient->CmdLen) == false) {
+		pBroker->pCurrent = NULL;
+		return;
+	}
+
+	list_del_init(&pClient->List);
+	pClient->State = CAV_AT_ACTIVE;
+	pClient->SentAt = ktime_get();
+	pBroker->SentAt = pClient->SentAt;
+	pBroker->Deadline = jiffies + msecs_to_jiffies(pClient->TimeoutMs);
+	mod_delayed_work(system_wq, &pBroker->TimeoutWork,
+			 msecs_to_jiffies(pClient->TimeoutMs));
+	CavTxKick(pBroker->Context);
+} // CavAtStart
+
+/*===========================================================================
+METHOD:
+   CavAtDrained
+
+DESCRIPTION:
+   End the wait for the late result code of a command that timed out and
+   start the next command. Called with the broker lock held.
+
+PARAMETERS:
+   pBroker: [ I ] - AT broker of the port
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavAtDrained(cav_at_broker *pBroker)
+{
+	pBroker->bDraining = 0;
+	pBroker->LineLen = 0;
+	CavAtStart(pBroker);
+} // CavAtDrained
+
+/*===========================================================================
+METHOD:
+   CavAtComplete
+
+DESCRIPTION:
+   Finish the command in progress, hand the response to its client and
+   start the next one. After a timeout the next command waits until the
+   late result code or CAV_AT_DRAIN_MS without data, so the late result
+   is not taken for its own. Called with the broker lock held.
+
+PARAMETERS:
+   pBroker: [ I ] - AT broker of the port
+   status:  [ I ] - CAV_AT_OK, CAV_AT_ERROR or CAV_AT_TIMEOUT
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavAtComplete(cav_at_broker *pBroker, int status)
+{
+	cav_at_client *pClient = pBroker->pCurrent;
+	unsigned int rtt = ktime_us_delta(ktime_get(), pBroker->SentAt);
+
+	pBroker->Depth--;
+	pBroker->Commands++;
+	if (status == CAV_AT_TIMEOUT) {
+		pBroker->Timeouts++;
+	}
+	pBroker->RttUs = rtt;
+	pBroker->RttTotalUs += rtt;
+	if (rtt > pBroker->RttMaxUs) {
+		pBroker->RttMaxUs = rtt;
+	}
+	pBroker->pCurrent = NULL;
+	pBroker->bDraining = 0;
+	if (status == CAV_AT_TIMEOUT) {
+		pBroker->bDraining = CAV_AT_DRAIN_LATE;
+		pBroker->Deadline = jiffies + msecs_to_jiffies(CAV_AT_DRAIN_MS);
+		mod_delayed_work(system_wq, &pBroker->TimeoutWork,
+				 msecs_to_jiffies(CAV_AT_DRAIN_MS));
+	}
+
+	if (pClient != NULL) {
+		pClient->Result.status = status;
+		pClient->Result.rtt_us = rtt;
+		pClient->Result.queue_us =
+			ktime_us_delta(pClient->SentAt, pClient->QueuedAt);
+		pClient->Result.resp_len = pClient->RespLen;
+		pClient->State = CAV_AT_DONE;
+		wake_up_interruptible(&pClient->Wait);
+		CavDbg(pBroker->Context, CAV_DBG_RX,
+		       "<%s> AT command done, status %d rtt %u us\n",
+		       CavPort(pBroker->Context, NULL), status, rtt);
+	}
+	CavAtStart(pBroker);
+} // CavAtComplete
+
+/*===========================================================================
+METHOD:
+   CavAtRx
+
+DESCRIPTION:
+   Collect the response of the command in progress from received data.
+   The data up to and including the final result code belongs to the
+   command, the rest goes to the TTY.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - received data
+   len:     [ I ] - number of bytes received
+
+RETURN VALUE:
+   number of bytes taken by the broker
+===========================================================================*/
+int CavAtRx(cav_device_context *context, const unsigned char *pData,
+	    int len)
+{
+	cav_at_broker *pBroker = context->pAtBroker;
+	cav_at_client *pClient;
+	unsigned long flags;
+	int index, final;
+	char ch;
+
+	if ((pBroker == NULL) || (len == 0) ||
+	    ((READ_ONCE(pBroker->pCurrent) == NULL) &&
+	     (READ_ONCE(pBroker->bDraining) == 0))) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&pBroker->Lock, flags);
+	if (pBroker->bDraining == CAV_AT_DRAIN_LATE) {
+		// The drain lasts while data keeps coming
+		pBroker->Deadline = jiffies + msecs_to_jiffies(CAV_AT_DRAIN_MS);
+	}
+	for (index = 0; index < len; index++) {
+		pClient = pBroker->pCurrent;
+		if ((pClient == NULL) && (pBroker->bDraining == 0)) {
+			break;
+		}
+		ch = pData[index];
+		if ((pClient != NULL) && (pClient->RespLen < CAV_AT_RESP_MAX)) {
+			pClient->pResp[pClient->RespLen++] = ch;
+		}
+		if ((ch != '\r') && (ch != '\n')) {
+			if (pBroker->LineLen < CAV_AT_LINE_MAX - 1) {
+				pBroker->Line[pBroker->LineLen++] = ch;
+			}
+			continue;
+		}
+		pBroker->Line[pBroker->LineLen] = 0;
+		final = CavAtFinal(pBroker->Line, pBroker->LineLen);
+		pBroker->LineLen = 0;
+		if (final != 0) {
+			// Keep the line ending with the result code
+			if ((ch == '\r') && (index + 1 < len) &&
+			    (pData[index + 1] == '\n')) {
+				index++;
+				if ((pClient != NULL) &&
+				    (pClient->RespLen < CAV_AT_RESP_MAX)) {
+					pClient->pResp[pClient->RespLen++] =
+						'\n';
+				}
+			}
+			// The rest was sent before the next command
+			if (pBroker->bDraining == CAV_AT_DRAIN_LATE) {
+				CavAtDrained(pBroker);
+			} else {
+				CavAtComplete(pBroker, final);
+			}
+			index++;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&pBroker->Lock, flags);
+
+	return index;
+} // CavAtRx
+
+/*===========================================================================
+METHOD:
+   CavAtTimeoutWork
+
+DESCRIPTION:
+   Fail the command in progress once its deadline passed, or end the
+   wait for a late result code
+
+PARAMETERS:
+   pWork: [ I ] - TimeoutWork of the broker
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavAtTimeoutWork(struct work_struct *pWork)
+{
+	cav_at_broker *pBroker =
+		container_of(to_delayed_work(pWork), cav_at_broker,
+			     TimeoutWork);
+	unsigned long flags;
+
+	spin_lock_irqsave(&pBroker->Lock, flags);
+	if ((pBroker->pCurrent != NULL) || (pBroker->bDraining != 0)) {
+		if (time_after_eq(jiffies, pBroker->Deadline) == false) {
+			// A later command started or data arrived meanwhile
+			mod_delayed_work(system_wq, &pBroker->TimeoutWork,
+					 pBroker->Deadline - jiffies);
+		} else if (pBroker->bDraining == CAV_AT_DRAIN_LATE) {
+			CavAtDrained(pBroker);
+		} else {
+			CavAtComplete(pBroker, CAV_AT_TIMEOUT);
+		}
+	}
+	spin_unlock_irqrestore(&pBroker->Lock, flags);
+} // CavAtTimeoutWork
+
+/*===========================================================================
+METHOD:
+   CavAtOpen
+
+DESCRIPTION:
+   Open /dev/cavatN as a new broker client, keeps the bulk-IN read engine
+   running
+
+PARAMETERS:
+   pInode: [ I ] - inode being opened
+   pFile:  [ I ] - file being opened
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static int CavAtOpen(struct inode *pInode, struct file *pFile)
+{
+	cav_char_dev *pChar = CavCharOpen(pInode);
+	cav_device_context *context;
+	cav_at_client *pClient;
+	int nRetval;
+
+	if (pChar == NULL) {
+		return -ENODEV;
+	}
+	context = pChar->Context;
+
+	nRetval = CavWaitReady(context);
+	if (nRetval != 0) {
+		CavContextPut(context);
+		return nRetval;
+	}
+
+	pClient = kzalloc(sizeof(cav_at_client), GFP_KERNEL);
+	if (pClient != NULL) {
+		pClient->pResp = kmalloc(CAV_AT_RESP_MAX, GFP_KERNEL);
+	}
+	if ((pClient == NULL) || (pClient->pResp == NULL)) {
+		kfree(pClient);
+		CavContextPut(context);
+		return -ENOMEM;
+	}
+	INIT_LIST_HEAD(&pClient->List);
+	mutex_init(&pClient->Lock);
+	init_waitqueue_head(&pClient->Wait);
+	pClient->pBroker = context->pAtBroker;
+	pClient->TimeoutMs = READ_ONCE(at_timeout_ms);
+
+	nRetval = CavRxGet(context);
+	if (nRetval != 0) {
+		kfree(pClient->pResp);
+		kfree(pClient);
+		CavContextPut(context);
+		return nRetval;
+	}
+
+	pFile->private_data = pClient;
+	return nonseekable_open(pInode, pFile);
+} // CavAtOpen
+
+/*===========================================================================
+METHOD:
+   CavAtRelease
+
+DESCRIPTION:
+   Close /dev/cavatN. A queued command is dropped, the response of a
+   command in progress is discarded when it arrives.
+
+PARAMETERS:
+   pInode: [ I ] - inode being closed
+   pFile:  [ I ] - file being closed
+
+RETURN VALUE:
+   int - zero
+===========================================================================*/
+static int CavAtRelease(struct inode *pInode, struct file *pFile)
+{
+	cav_at_client *pClient = pFile->private_data;
+	cav_at_broker *pBroker = pClient->pBroker;
+	cav_device_context *context = pBroker->Context;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pBroker->Lock, flags);
+	if (pClient->State == CAV_AT_QUEUED) {
+		list_del(&pClient->List);
+		pBroker->Depth--;
+	} else if (pBroker->pCurrent == pClient) {
+		pBroker->pCurrent = NULL;
+		pBroker->bDraining = CAV_AT_DRAIN_CLOSED;
+	}
+	spin_unlock_irqrestore(&pBroker->Lock, flags);
+
+	kfree(pClient->pResp);
+	kfree(pClient);
+	CavRxPut(context);
+	CavContextPut(context);
+	return 0;
+} // CavAtRelease
+
+/*===========================================================================
+METHOD:
+   CavAtWrite
+
+DESCRIPTION:
+   Queue one AT command. A missing carriage return is added, a trailing
+   newline is dropped. The unread response of the previous command is
+   discarded.
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pBuf:  [ I ] - command
+   count: [ I ] - length of the command
+   pPos:  [ I ] - unused, the device is not seekable
+
+RETURN VALUE:
+   ssize_t - count on success
+           - -EBUSY while the previous command is in progress
+           - negative errno on error
+===========================================================================*/
+static ssize_t CavAtWrite(struct file *pFile, const char __user *pBuf,
+			  size_t count, loff_t *pPos)
+{
+	cav_at_client *pClient = pFile->private_data;
+	cav_at_broker *pBroker = pClient->pBroker;
+	char cmd[CAV_AT_CMD_MAX];
+	unsigned long flags;
+	unsigned int len = count;
+
+	if (pBroker->Context->bDevRemoved != 0) {
+		return -ENODEV;
+	}
+	if ((count == 0) || (count > CAV_AT_CMD_MAX - 1)) {
+		return -EINVAL;
+	}
+	if (copy_from_user(cmd, pBuf, count) != 0) {
+		return -EFAULT;
+	}
+	if (cmd[len - 1] == '\n') {
+		len--;
+	}
+	if ((len == 0) || (cmd[len - 1] != '\r')) {
+		cmd[len++] = '\r';
+	}
+
+	if (mutex_lock_interruptible(&pClient->Lock) != 0) {
+		return -ERESTARTSYS;
+	}
+	spin_lock_irqsave(&pBroker->Lock, flags);
+	if ((pClient->State == CAV_AT_QUEUED) ||
+	    (pClient->State == CAV_AT_ACTIVE)) {
+		spin_unlock_irqrestore(&pBroker->Lock, flags);
+		mutex_unlock(&pClient->Lock);
+		return -EBUSY;
+	}
+	memcpy(pClient->Cmd, cmd, len);
+	pClient->CmdLen = len;
+	pClient->RespLen = 0;
+	pClient->RespRead = 0;
+	pClient->State = CAV_AT_QUEUED;
+	pClient->QueuedAt = ktime_get();
+	list_add_tail(&pClient->List, &pBroker->Queue);
+	pBroker->Depth++;
+	if (pBroker->Depth > pBroker->DepthMax) {
+		pBroker->DepthMax = pBroker->Depth;
+	}
+	CavAtStart(pBroker);
+	spin_unlock_irqrestore(&pBroker->Lock, flags);
+	mutex_unlock(&pClient->Lock);
+
+	return count;
+} // CavAtWrite
+
+/*===========================================================================
+METHOD:
+   CavAtRead
+
+DESCRIPTION:
+   Return the response of the last command, blocking until its final
+   result code or timeout
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pBuf:  [ O ] - user buffer
+   count: [ I ] - size of pBuf
+   pPos:  [ I ] - unused, the device is not seekable
+
+RETURN VALUE:
+   ssize_t - number of bytes read, zero once the response was read or if
+             no command was written
+           - -ETIMEDOUT if the command timed out without any response
+           - negative errno on error
+===========================================================================*/
+static ssize_t CavAtRead(struct file *pFile, char __user *pBuf, size_t count,
+			 loff_t *pPos)
+{
+	cav_at_client *pClient = pFile->private_data;
+	cav_at_broker *pBroker = pClient->pBroker;
+	cav_device_context *context = pBroker->Context;
+	unsigned long flags;
+	ssize_t nRetval;
+	int state;
+
+	if (mutex_lock_interruptible(&pClient->Lock) != 0) {
+		return -ERESTARTSYS;
+	}
+
+	state = READ_ONCE(pClient->State);
+	if ((state == CAV_AT_QUEUED) || (state == CAV_AT_ACTIVE)) {
+		if ((pFile->f_flags & O_NONBLOCK) != 0) {
+			mutex_unlock(&pClient->Lock);
+			return -EAGAIN;
+		}
+		if (wait_event_interruptible(
+			    pClient->Wait,
+			    (READ_ONCE(pClient->State) == CAV_AT_DONE) ||
+				    (context->bDevRemoved != 0)) != 0) {
+			mutex_unlock(&pClient->Lock);
+			return -ERESTARTSYS;
+		}
+	}
+
+	spin_lock_irqsave(&pBroker->Lock, flags);
+	if (pClient->State != CAV_AT_DONE) {
+		nRetval = (pClient->State == CAV_AT_IDLE) ? 0 : -ENODEV;
+	} else if ((pClient->Result.status == CAV_AT_TIMEOUT) &&
+		   (pClient->RespLen == 0)) {
+		pClient->State = CAV_AT_IDLE;
+		nRetval = -ETIMEDOUT;
+	} else {
+		nRetval = min_t(size_t, count,
+				pClient->RespLen - pClient->RespRead);
+	}
+	spin_unlock_irqrestore(&pBroker->Lock, flags);
+
+	// Only this reader changes the response of a completed command
+	if (nRetval > 0) {
+		if (copy_to_user(pBuf, pClient->pResp + pClient->RespRead,
+				 nRetval) != 0) {
+			nRetval = -EFAULT;
+		} else {
+			pClient->RespRead += nRetval;
+		}
+	}
+	if ((nRetval >= 0) && (pClient->State == CAV_AT_DONE) &&
+	    (pClient->RespRead == pClient->RespLen)) {
+		WRITE_ONCE(pClient->State, CAV_AT_IDLE);
+	}
+
+	mutex_unlock(&pClient->Lock);
+	return nRetval;
+} // CavAtRead
+
+/*===========================================================================
+METHOD:
+   CavAtPoll
+
+DESCRIPTION:
+   Report POLLIN when a response is ready and POLLOUT when a new command
+   can be written
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pWait: [ I ] - poll table
+
+RETURN VALUE:
+   poll mask
+===========================================================================*/
+static __poll_t CavAtPoll(struct file *pFile, poll_table *pWait)
+{
+	cav_at_client *pClient = pFile->private_data;
+	int state = READ_ONCE(pClient->State);
+	__poll_t mask = 0;
+
+	poll_wait(pFile, &pClient->Wait, pWait);
+	if (state == CAV_AT_DONE) {
+		mask |= EPOLLIN | EPOLLRDNORM;
+	}
+	if ((state == CAV_AT_IDLE) || (state == CAV_AT_DONE)) {
+		mask |= EPOLLOUT | EPOLLWRNORM;
+	}
+	if (pClient->pBroker->Context->bDevRemoved != 0) {
+		mask |= EPOLLHUP | EPOLLERR;
+	}
+	return mask;
+} // CavAtPoll
+
+/*===========================================================================
+METHOD:
+   CavAtIoctl
+
+DESCRIPTION:
+   Set the command timeout of the client or read the result of its last
+   command
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   cmd:   [ I ] - CAV_AT_IOC_*
+   arg:   [ I ] - user pointer
+
+RETURN VALUE:
+   long - zero for success
+        - negative errno on error
+===========================================================================*/
+static long CavAtIoctl(struct file *pFile, unsigned int cmd,
+		       unsigned long arg)
+{
+	cav_at_client *pClient = pFile->private_data;
+	struct cav_at_result result;
+	unsigned long flags;
+	__u32 timeout;
+
+	switch (cmd) {
+	case CAV_AT_IOC_SET_TIMEOUT:
+		if (get_user(timeout, (__u32 __user *)arg) != 0) {
+			return -EFAULT;
+		}
+		if ((timeout == 0) || (timeout > CAV_AT_TIMEOUT_MS_MAX)) {
+			return -EINVAL;
+		}
+		pClient->TimeoutMs = timeout;
+		return 0;
+	case CAV_AT_IOC_GET_RESULT:
+		spin_lock_irqsave(&pClient->pBroker->Lock, flags);
+		result = pClient->Result;
+		spin_unlock_irqrestore(&pClient->pBroker->Lock, flags);
+		if (copy_to_user((void __user *)arg, &result,
+				 sizeof(result)) != 0) {
+			return -EFAULT;
+		}
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+} // CavAtIoctl
+
+static const struct file_operations CavAtFops = {
+	.owner = THIS_MODULE,
+	.open = CavAtOpen,
+	.release = CavAtRelease,
+	.read = CavAtRead,
+	.write = CavAtWrite,
+	.poll = CavAtPoll,
+	.unlocked_ioctl = CavAtIoctl,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 5, 0))
+	.compat_ioctl = compat_ptr_ioctl,
+#endif
+};
+
+/*===========================================================================
+METHOD:
+   CavAtAdd
+
+DESCRIPTION:
+   Allocate the broker and create /dev/cavatN for an AT port
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success or if the device is not wanted
+===========================================================================*/
+int CavAtAdd(cav_device_context *context)
+{
+	cav_at_broker *pBroker;
+	int nRetval;
+
+	if ((at_broker == false) || (context->pProfile->Role != CAV_ROLE_AT) ||
+	    (context->RxUrbCount == 0) || (context->TxUrbCount == 0)) {
+		return 0;
+	}
+
+	pBroker = kzalloc(sizeof(cav_at_broker), GFP_KERNEL);
+	if (pBroker == NULL) {
+		return -ENOMEM;
+	}
+	pBroker->Context = context;
+	spin_lock_init(&pBroker->Lock);
+	INIT_LIST_HEAD(&pBroker->Queue);
+	INIT_DELAYED_WORK(&pBroker->TimeoutWork, CavAtTimeoutWork);
+	context->pAtBroker = pBroker;
+
+	nRetval = CavCharAdd(&pBroker->Char, context, &CavAtFops, "cavat");
+	if (nRetval != 0) {
+		context->pAtBroker = NULL;
+		kfree(pBroker);
+	}
+	return nRetval;
+} // CavAtAdd
+
+/*===========================================================================
+METHOD:
+   CavAtRemove
+
+DESCRIPTION:
+   Remove /dev/cavatN, clients still open get -ENODEV
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavAtRemove(cav_device_context *context)
+{
+	if (context->pAtBroker == NULL) {
+		return;
+	}
+	CavCharRemove(&context->pAtBroker->Char);
+} // CavAtRemove
+
+/*===========================================================================
+METHOD:
+   CavAtDisconnect
+
+DESCRIPTION:
+   Fail the command in progress and wake up the clients blocked in read
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavAtDisconnect(cav_device_context *context)
+{
+	cav_at_broker *pBroker = context->pAtBroker;
+	cav_at_client *pClient;
+	unsigned long flags;
+
+	if (pBroker == NULL) {
+		return;
+	}
+	cancel_delayed_work_sync(&pBroker->TimeoutWork);
+
+	spin_lock_irqsave(&pBroker->Lock, flags);
+	pClient = pBroker->pCurrent;
+	if (pClient != NULL) {
+		wake_up_interruptible(&pClient->Wait);
+	}
+	list_for_each_entry(pClient, &pBroker->Queue, List) {
+		wake_up_interruptible(&pClient->Wait);
+	}
+	spin_unlock_irqrestore(&pBroker->Lock, flags);
+} // CavAtDisconnect
+
+/*===========================================================================
+METHOD:
+   CavAtFree
+
+DESCRIPTION:
+   Free the broker, called when the last context reference is dropped
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavAtFree(cav_device_context *context)
+{
+	if (context->pAtBroker == NULL) {
+		return;
+	}
+	cancel_delayed_work_sync(&context->pAtBroker->TimeoutWork);
+	kfree(context->pAtBroker);
+	context->pAtBroker = NULL;
+} // CavAtFree
+
+/*===========================================================================
+METHOD:
+   CavAtBusy
+
+DESCRIPTION:
+   Check whether received data may belong to a broker command
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   bool - true while a command is in progress or its late response is
+          being drained
+===========================================================================*/
+bool CavAtBusy(cav_device_context *context)
+{
+	cav_at_broker *pBroker = context->pAtBroker;
+
+	return (pBroker != NULL) &&
+	       ((READ_ONCE(pBroker->pCurrent) != NULL) ||
+		(READ_ONCE(pBroker->bDraining) != 0));
+} // CavAtBusy
+
+/*===========================================================================
+METHOD:
+   CavAtTxRoom
+
+DESCRIPTION:
+   The write queue drained, send a command that found it full
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavAtTxRoom(cav_device_context *context)
+{
+	cav_at_broker *pBroker = context->pAtBroker;
+	unsigned long flags;
+
+	if ((pBroker == NULL) || (context->bDevRemoved != 0) ||
+	    (READ_ONCE(pBroker->pCurrent) != NULL)) {
+		return;
+	}
+	spin_lock_irqsave(&pBroker->Lock, flags);
+	CavAtStart(pBroker);
+	spin_unlock_irqrestore(&pBroker->Lock, flags);
+} // CavAtTxRoom
+
+/*===========================================================================
+METHOD:
+   CavAtStatsShow
+
+DESCRIPTION:
+   Print the queue depth and round-trip times of the broker
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   buf:     [ O ] - PAGE_SIZE sysfs buffer
+
+RETURN VALUE:
+   number of bytes written to buf
+===========================================================================*/
+ssize_t CavAtStatsShow(cav_device_context *context, char *buf)
+{
+	cav_at_broker *pBroker = context->pAtBroker;
+	unsigned long flags;
+	ssize_t len;
+
+	if (pBroker == NULL) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&pBroker->Lock, flags);
+	len = sprintf(buf,
+		      "depth=%u depth_max=%u commands=%llu timeouts=%llu "
+		      "rtt_us=%u rtt_max_us=%u rtt_avg_us=%llu\n",
+		      pBroker->Depth, pBroker->DepthMax, pBroker->Commands,
+		      pBroker->Timeouts, pBroker->RttUs, pBroker->RttMaxUs,
+		      (pBroker->Commands != 0) ?
+			      div64_u64(pBroker->RttTotalUs,
+					pBroker->Commands) :
+			      0);
+	spin_unlock_irqrestore(&pBroker->Lock, flags);
+	return len;
+} // CavAtStatsShow
+
+module_param(at_broker, bool, S_IRUGO);
+MODULE_PARM_DESC(at_broker, "Create /dev/cavatN AT command broker");
+module_param(at_timeout_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(at_timeout_ms, "Default AT command timeout in milliseconds");
@@ -0,0 +1,470 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/jump_label.h>
+#include <linux/debugfs.h>
+#include <linux/vmalloc.h>
+#include "CavQMSerial.h"
+
+// Records kept by the capture ring of a port, oldest are overwritten
+static uint capture_records = CAV_CAPTURE_RECORDS_DEFAULT;
+
+// Payload bytes kept per record
+static uint capture_snaplen = CAV_CAPTURE_SNAPLEN_DEFAULT;
+
+// Enabled while any port captures
+DEFINE_STATIC_KEY_FALSE(CavCaptureKey);
+
+// Serializes capture enable/disable
+static DEFINE_MUTEX(CavCaptureMutex);
+
+typedef struct _cav_capture_rec {
+	u64 Id;
+	u64 TimeNs; // CLOCK_REALTIME
+	s32 Status;
+	u32 Len;
+	u16 CapLen;
+	u8 Event; // 'S'ubmit or 'C'omplete
+	u8 XferType;
+	u8 Ep;
+	u8 Data[];
+} cav_capture_rec;
+
+typedef struct _cav_capture {
+	spinlock_t Lock;
+	bool bEnabled;
+	unsigned int Records;
+	unsigned int SnapLen;
+	unsigned int Stride;
+	unsigned long Head; // records written since enabled
+	unsigned long Epoch; // times enabled
+	u8 *pSlots;
+} cav_capture;
+
+// Open capture.pcap, holds the pcap header or the record being read
+typedef struct _cav_capture_file {
+	cav_device_context *Context;
+	cav_capture *pCap; // NULL if capture was never enabled
+	unsigned long Epoch;
+	unsigned long Next; // next record to convert
+	unsigned long End; // Head at open time
+	size_t Len; // bytes in Buf
+	size_t Off; // bytes of Buf already read
+	u8 Buf[];
+} cav_capture_file;
+
+// pcap file header, nanosecond resolution
+struct cav_pcap_hdr {
+	u32 Magic;
+	u16 VersionMajor;
+	u16 VersionMinor;
+	s32 ThisZone;
+	u32 SigFigs;
+	u32 SnapLen;
+	u32 Network;
+} __packed;
+
+struct cav_pcap_rec_hdr {
+	u32 TsSec;
+	u32 TsNsec;
+	u32 InclLen;
+	u32 OrigLen;
+} __packed;
+
+// usbmon binary header, LINKTYPE_USB_LINUX_MMAPPED
+struct cav_usbmon_hdr {
+	u64 Id;
+	u8 Type;
+	u8 XferType;
+	u8 EpNum;
+	u8 DevNum;
+	u16 BusNum;
+	s8 FlagSetup;
+	s8 FlagData;
+	s64 TsSec;
+	s32 TsUsec;
+	s32 Status;
+	u32 Len;
+	u32 LenCap;
+	u8 Setup[8];
+	s32 Interval;
+	s32 StartFrame;
+	u32 XferFlags;
+	u32 NDesc;
+} __packed;
+
+#define CAV_PCAP_MAGIC_NS 0xa1b23c4d
+#define CAV_PCAP_LINKTYPE_USB_MMAPPED 220
+
+/*===========================================================================
+METHOD:
+   CavCaptureAdd
+
+DESCRIPTION:
+   Record a URB event in the capture ring of a port, called through the
+   CavCapture macro only while some port captures
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pURB:    [ I ] - URB submitted or completed
+   event:   [ I ] - 'S' for submission, 'C' for completion
+   status:  [ I ] - URB status
+   pData:   [ I ] - payload, NULL if none is recorded
+   len:     [ I ] - payload length
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavCaptureAdd(cav_device_context *context, struct urb *pURB, u8 event,
+		   int status, const void *pData, unsigned int len)
+{
+	cav_capture *pCap = context->pCapture;
+	cav_capture_rec *pRec;
+	unsigned long flags;
+
+	if ((pCap == NULL) || (READ_ONCE(pCap->bEnabled) == false)) {
+		return;
+	}
+
+	spin_lock_irqsave(&pCap->Lock, flags);
+	pRec = (cav_capture_rec *)(pCap->pSlots +
+				   (pCap->Head % pCap->Records) * pCap->Stride);
+	pCap->Head++;
+	pRec->Id = (unsigned long)pURB;
+	pRec->TimeNs = ktime_get_real_ns();
+	pRec->Status = status;
+	pRec->Len = len;
+	pRec->CapLen = (pData != NULL) ? min(len, pCap->SnapLen) : 0;
+	pRec->Event = event;
+	pRec->XferType = usb_pipetype(pURB->pipe);
+	pRec->Ep = usb_pipeendpoint(pURB->pipe) |
+		   (usb_pipein(pURB->pipe) ? USB_DIR_IN : 0);
+	memcpy(pRec->Data, pData, pRec->CapLen);
+	spin_unlock_irqrestore(&pCap->Lock, flags);
+} // CavCaptureAdd
+
+/*===========================================================================
+METHOD:
+   CavCaptureEnable
+
+DESCRIPTION:
+   Start or stop capturing on a port. The ring is allocated on the first
+   start and cleared on every start; stopping keeps it readable.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   bEnable: [ I ] - start or stop
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+static int CavCaptureEnable(cav_device_context *context, bool bEnable)
+{
+	cav_capture *pCap;
+	unsigned long flags;
+	int nRetval = 0;
+
+	mutex_lock(&CavCaptureMutex);
+	pCap = context->pCapture;
+	if (bEnable && (pCap == NULL)) {
+		pCap = kzalloc(sizeof(cav_capture), GFP_KERNEL);
+		if (pCap == NULL) {
+			nRetval = -ENOMEM;
+			goto unlock;
+		}
+		pCap->Records = clamp_t(uint, capture_records, 16,
+					CAV_CAPTURE_RECORDS_MAX);
+		pCap->SnapLen = min_t(uint, capture_snaplen,
+				      CAV_CAPTURE_SNAPLEN_MAX);
+		pCap->Stride =
+			ALIGN(sizeof(cav_capture_rec) + pCap->SnapLen, 8);
+		pCap->Records = min_t(uint, pCap->Records,
+				      CAV_CAPTURE_BYTES_MAX / pCap->Stride);
+		pCap->pSlots = vmalloc(pCap->Records * pCap->Stride);
+		if (pCap->pSlots == NULL) {
+			kfree(pCap);
+			nRetval = -ENOMEM;
+			goto unlock;
+		}
+		spin_lock_init(&pCap->Lock);
+		context->pCapture = pCap;
+	}
+	if ((pCap == NULL) || (pCap->bEnabled == bEnable)) {
+		goto unlock;
+	}
+
+	spin_lock_irqsave(&pCap->Lock, flags);
+	if (bEnable) {
+		pCap->Head = 0;
+		pCap->Epoch++;
+	}
+	WRITE_ONCE(pCap->bEnabled, bEnable);
+	spin_unlock_irqrestore(&pCap->Lock, flags);
+
+	if (bEnable) {
+		static_branch_inc(&CavCaptureKey);
+	} else {
+		static_branch_dec(&CavCaptureKey);
+	}
+
+unlock:
+	mutex_unlock(&CavCaptureMutex);
+	return nRetval;
+} // CavCaptureEnable
+
+/*===========================================================================
+METHOD:
+   CavCaptureFree
+
+DESCRIPTION:
+   Stop capturing and free the ring, called when the last context
+   reference is dropped
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavCaptureFree(cav_device_context *context)
+{
+	cav_capture *pCap = context->pCapture;
+
+	if (pCap == NULL) {
+		return;
+	}
+	CavCaptureEnable(context, false);
+	context->pCapture = NULL;
+	vfree(pCap->pSlots);
+	kfree(pCap);
+} // CavCaptureFree
+
+static int CavCaptureEnableGet(void *data, u64 *val)
+{
+	cav_device_context *context = data;
+
+	*val = (context->pCapture != NULL) &&
+	       READ_ONCE(context->pCapture->bEnabled);
+	return 0;
+}
+
+static int CavCaptureEnableSet(void *data, u64 val)
+{
+	return CavCaptureEnable(data, val != 0);
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(CavCaptureEnableFops, CavCaptureEnableGet,
+			 CavCaptureEnableSet, "%llu\n");
+
+/*===========================================================================
+METHOD:
+   CavCaptureNext
+
+DESCRIPTION:
+   Convert the next record of the ring into the buffer of an open
+   capture.pcap. Records overwritten since the file was opened are
+   skipped, a capture restarted meanwhile ends the file.
+
+PARAMETERS:
+   pCapFile: [ I ] - open capture.pcap
+
+RETURN VALUE:
+   bool - false at the end of the file
+===========================================================================*/
+static bool CavCaptureNext(cav_capture_file *pCapFile)
+{
+	cav_capture *pCap = pCapFile->pCap;
+	struct usb_device *pDev = pCapFile->Context->MySerial->dev;
+	struct cav_pcap_rec_hdr *pRecHdr;
+	struct cav_usbmon_hdr *pMon;
+	cav_capture_rec *pRec;
+	unsigned long flags;
+	u32 nsec;
+	u64 sec;
+
+	if (pCap == NULL) {
+		return false;
+	}
+
+	spin_lock_irqsave(&pCap->Lock, flags);
+	if ((pCap->Epoch != pCapFile->Epoch) ||
+	    (pCapFile->Next >= pCapFile->End)) {
+		spin_unlock_irqrestore(&pCap->Lock, flags);
+		return false;
+	}
+	if (pCap->Head - pCapFile->Next > pCap->Records) {
+		pCapFile->Next = pCap->Head - pCap->Records;
+	}
+	pRec = (cav_capture_rec *)(pCap->pSlots +
+				   (pCapFile->Next % pCap->Records) *
+					   pCap->Stride);
+	pCapFile->Next++;
+	sec = div_u64_rem(pRec->TimeNs, NSEC_PER_SEC, &nsec);
+
+	pRecHdr = (struct cav_pcap_rec_hdr *)pCapFile->Buf;
+	pRecHdr->TsSec = sec;
+	pRecHdr->TsNsec = nsec;
+	pRecHdr->InclLen = sizeof(*pMon) + pRec->CapLen;
+	pRecHdr->OrigLen = sizeof(*pMon) + pRec->Len;
+
+	pMon = (struct cav_usbmon_hdr *)(pRecHdr + 1);
+	memset(pMon, 0, sizeof(*pMon));
+	pMon->Id = pRec->Id;
+	pMon->Type = pRec->Event;
+	pMon->XferType = pRec->XferType;
+	pMon->EpNum = pRec->Ep;
+	pMon->DevNum = pDev->devnum;
+	pMon->BusNum = pDev->bus->busnum;
+	pMon->FlagSetup = '-';
+	if (pRec->CapLen == 0) {
+		pMon->FlagData = (pRec->Ep & USB_DIR_IN) ? '<' : '>';
+	}
+	pMon->TsSec = sec;
+	pMon->TsUsec = nsec / NSEC_PER_USEC;
+	pMon->Status = pRec->Status;
+	pMon->Len = pRec->Len;
+	pMon->LenCap = pRec->CapLen;
+
+	memcpy(pMon + 1, pRec->Data, pRec->CapLen);
+	pCapFile->Len = sizeof(*pRecHdr) + sizeof(*pMon) + pRec->CapLen;
+	pCapFile->Off = 0;
+	spin_unlock_irqrestore(&pCap->Lock, flags);
+
+	return true;
+} // CavCaptureNext
+
+/*===========================================================================
+METHOD:
+   CavCaptureOpen
+
+DESCRIPTION:
+   Open capture.pcap. The file covers the records in the ring at open
+   time, they are converted one at a time while it is read, so capture
+   can keep running.
+
+PARAMETERS:
+   pInode: [ I ] - debugfs inode, i_private is the context
+   pFile:  [ I ] - file being opened
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static int CavCaptureOpen(struct inode *pInode, struct file *pFile)
+{
+	cav_device_context *context = pInode->i_private;
+	cav_capture *pCap = context->pCapture;
+	cav_capture_file *pCapFile;
+	struct cav_pcap_hdr *pHdr;
+	unsigned long flags;
+	size_t size;
+
+	size = sizeof(struct cav_pcap_rec_hdr) + sizeof(struct cav_usbmon_hdr);
+	if (pCap != NULL) {
+		size += pCap->SnapLen;
+	}
+	pCapFile = kzalloc(sizeof(cav_capture_file) + size, GFP_KERNEL);
+	if (pCapFile == NULL) {
+		return -ENOMEM;
+	}
+	pCapFile->Context = context;
+	pCapFile->pCap = pCap;
+	if (pCap != NULL) {
+		spin_lock_irqsave(&pCap->Lock, flags);
+		pCapFile->Epoch = pCap->Epoch;
+		pCapFile->End = pCap->Head;
+		pCapFile->Next = (pCap->Head > pCap->Records) ?
+					 pCap->Head - pCap->Records : 0;
+		spin_unlock_irqrestore(&pCap->Lock, flags);
+	}
+
+	// The pcap header is read first
+	pHdr = (struct cav_pcap_hdr *)pCapFile->Buf;
+	pHdr->Magic = CAV_PCAP_MAGIC_NS;
+	pHdr->VersionMajor = 2;
+	pHdr->VersionMinor = 4;
+	pHdr->SnapLen = sizeof(struct cav_usbmon_hdr) +
+			((pCap != NULL) ? pCap->SnapLen : 0);
+	pHdr->Network = CAV_PCAP_LINKTYPE_USB_MMAPPED;
+	pCapFile->Len = sizeof(struct cav_pcap_hdr);
+
+	pFile->private_data = pCapFile;
+	return nonseekable_open(pInode, pFile);
+} // CavCaptureOpen
+
+static ssize_t CavCaptureRead(struct file *pFile, char __user *pBuf,
+			      size_t count, loff_t *pPos)
+{
+	cav_capture_file *pCapFile = pFile->private_data;
+	ssize_t nRetval = 0;
+	size_t chunk;
+
+	while (nRetval < count) {
+		if ((pCapFile->Off == pCapFile->Len) &&
+		    (CavCaptureNext(pCapFile) == false)) {
+			break;
+		}
+		chunk = min_t(size_t, count - nRetval,
+			      pCapFile->Len - pCapFile->Off);
+		if (copy_to_user(pBuf + nRetval,
+				 pCapFile->Buf + pCapFile->Off, chunk) != 0) {
+			return -EFAULT;
+		}
+		pCapFile->Off += chunk;
+		nRetval += chunk;
+	}
+	*pPos += nRetval;
+	return nRetval;
+}
+
+static int CavCaptureRelease(struct inode *pInode, struct file *pFile)
+{
+	kfree(pFile->private_data);
+	return 0;
+}
+
+static const struct file_operations CavCaptureFops = {
+	.owner = THIS_MODULE,
+	.open = CavCaptureOpen,
+	.read = CavCaptureRead,
+	.release = CavCaptureRelease,
+};
+
+/*===========================================================================
+METHOD:
+   CavCaptureDebugfsAdd
+
+DESCRIPTION:
+   Create the capture files in the debugfs directory of a port:
+      capture_enable - write 1 to start, 0 to stop
+      capture.pcap   - snapshot of the ring, usbmon link type
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavCaptureDebugfsAdd(cav_device_context *context)
+{
+	debugfs_create_file_unsafe("capture_enable", S_IRUSR | S_IWUSR,
+				   context->pDebugfsDir, context,
+				   &CavCaptureEnableFops);
+	debugfs_create_file("capture.pcap", S_IRUSR, context->pDebugfsDir,
+			    context, &CavCaptureFops);
+} // CavCaptureDebugfsAdd
+
+module_param(capture_records, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(capture_records,
+		 "Records per port capture ring, applied when first enabled");
+module_param(capture_snaplen, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(capture_snaplen,
+		 "Payload bytes kept per captured record");
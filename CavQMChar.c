@@ -0,0 +1,201 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/cdev.h>
+#include <linux/idr.h>
+#include "CavQMSerial.h"
+
+// Companion character devices of all ports, indexed by minor
+static dev_t CavCharDevt;
+static struct class *CavCharClass;
+static DEFINE_IDR(CavCharIdr);
+static DEFINE_MUTEX(CavCharMutex);
+
+/*===========================================================================
+METHOD:
+   CavCharInit
+
+DESCRIPTION:
+   Reserve the character device region and class of the driver
+
+PARAMETERS:
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavCharInit(void)
+{
+	int nRetval;
+
+	nRetval = alloc_chrdev_region(&CavCharDevt, 0, CAV_CHAR_MINORS,
+				      "CavQMSerial");
+	if (nRetval != 0) {
+		return nRetval;
+	}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0))
+	CavCharClass = class_create("cavqm");
+#else
+	CavCharClass = class_create(THIS_MODULE, "cavqm");
+#endif
+	if (IS_ERR(CavCharClass)) {
+		unregister_chrdev_region(CavCharDevt, CAV_CHAR_MINORS);
+		return PTR_ERR(CavCharClass);
+	}
+	return 0;
+} // CavCharInit
+
+/*===========================================================================
+METHOD:
+   CavCharExit
+
+DESCRIPTION:
+   Release the character device region and class of the driver
+
+PARAMETERS:
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavCharExit(void)
+{
+	class_destroy(CavCharClass);
+	unregister_chrdev_region(CavCharDevt, CAV_CHAR_MINORS);
+	idr_destroy(&CavCharIdr);
+} // CavCharExit
+
+/*===========================================================================
+METHOD:
+   CavCharAdd
+
+DESCRIPTION:
+   Create a companion character device /dev/<name>N for a port, where N
+   is the ttyUSB number of the port
+
+PARAMETERS:
+   pChar:   [ O ] - character device state
+   context: [ I ] - private context for the serial device
+   fops:    [ I ] - file operations of the device
+   name:    [ I ] - device name prefix
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavCharAdd(cav_char_dev *pChar, cav_device_context *context,
+	       const struct file_operations *fops, const char *name)
+{
+	struct usb_serial_port *pPort = context->MyPort;
+	struct device *pDevice;
+	dev_t devt;
+	int minor, nRetval;
+
+	pChar->Context = context;
+	mutex_lock(&CavCharMutex);
+	minor = idr_alloc(&CavCharIdr, pChar, 0, CAV_CHAR_MINORS, GFP_KERNEL);
+	mutex_unlock(&CavCharMutex);
+	if (minor < 0) {
+		return minor;
+	}
+	pChar->Minor = minor;
+	devt = MKDEV(MAJOR(CavCharDevt), minor);
+
+	pChar->pCdev = cdev_alloc();
+	if (pChar->pCdev == NULL) {
+		nRetval = -ENOMEM;
+		goto remove_minor;
+	}
+	pChar->pCdev->owner = THIS_MODULE;
+	pChar->pCdev->ops = fops;
+	nRetval = cdev_add(pChar->pCdev, devt, 1);
+	if (nRetval != 0) {
+		kobject_put(&pChar->pCdev->kobj);
+		goto remove_minor;
+	}
+
+	pDevice = device_create(CavCharClass, &pPort->dev, devt, pChar,
+				"%s%d", name, pPort->minor);
+	if (IS_ERR(pDevice)) {
+		nRetval = PTR_ERR(pDevice);
+		cdev_del(pChar->pCdev);
+		goto remove_minor;
+	}
+	pChar->pDevice = pDevice;
+	return 0;
+
+remove_minor:
+	pChar->pCdev = NULL;
+	mutex_lock(&CavCharMutex);
+	idr_remove(&CavCharIdr, minor);
+	mutex_unlock(&CavCharMutex);
+	return nRetval;
+} // CavCharAdd
+
+/*===========================================================================
+METHOD:
+   CavCharRemove
+
+DESCRIPTION:
+   Remove a companion character device, files already open keep their
+   reference on the context
+
+PARAMETERS:
+   pChar: [ I ] - character device state
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavCharRemove(cav_char_dev *pChar)
+{
+	if (pChar->pCdev == NULL) {
+		return;
+	}
+
+	mutex_lock(&CavCharMutex);
+	idr_remove(&CavCharIdr, pChar->Minor);
+	mutex_unlock(&CavCharMutex);
+
+	device_destroy(CavCharClass, MKDEV(MAJOR(CavCharDevt), pChar->Minor));
+	cdev_del(pChar->pCdev);
+	pChar->pCdev = NULL;
+	pChar->pDevice = NULL;
+} // CavCharRemove
+
+/*===========================================================================
+METHOD:
+   CavCharOpen
+
+DESCRIPTION:
+   Look up the character device behind an inode and take a reference on
+   its context
+
+PARAMETERS:
+   pInode: [ I ] - inode being opened
+
+RETURN VALUE:
+   character device state, NULL if the port is gone
+===========================================================================*/
+cav_char_dev *CavCharOpen(struct inode *pInode)
+{
+	cav_char_dev *pChar;
+
+	mutex_lock(&CavCharMutex);
+	pChar = idr_find(&CavCharIdr, iminor(pInode));
+	if ((pChar != NULL) && (pChar->Context->bDevRemoved == 0)) {
+		CavContextGet(pChar->Context);
+	} else {
+		pChar = NULL;
+	}
+	mutex_unlock(&CavCharMutex);
+
+	return pChar;
+} // CavCharOpen
@@ -0,0 +1,239 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/jump_label.h>
+#include <linux/debugfs.h>
+#include <linux/fault-inject.h>
+#include "CavQMSerial.h"
+
+#define CREATE_TRACE_POINTS
+#include "CavQMTrace.h"
+
+// Debug mask of new devices and of messages without a device, see
+// CAV_DBG_*
+ulong debug;
+
+// One key per category, enabled while debug or any device mask has the
+// category set
+DEFINE_STATIC_KEY_ARRAY_FALSE(CavDbgKeys, CAV_DBG_CATEGORIES);
+
+// Serializes mask updates against the key reference counts
+static DEFINE_MUTEX(CavDbgMutex);
+
+// /sys/kernel/debug/CavQMSerial, one directory per port below
+static struct dentry *CavDebugfsRoot;
+
+#ifdef CONFIG_FAULT_INJECTION_DEBUG_FS
+// Completed interrupt URBs failed with -EPROTO, configured in
+// /sys/kernel/debug/CavQMSerial/fail_int, see fault-injection.rst
+static DECLARE_FAULT_ATTR(CavFailInt);
+
+/*===========================================================================
+METHOD:
+   CavFailIntUrb
+
+DESCRIPTION:
+   Decide whether to fail a completed interrupt URB, for measuring the
+   recovery from error storms on the interrupt pipe
+
+PARAMETERS:
+
+RETURN VALUE:
+   bool - true to fail the URB
+===========================================================================*/
+bool CavFailIntUrb(void)
+{
+	return should_fail(&CavFailInt, 1);
+} // CavFailIntUrb
+#endif
+
+/*===========================================================================
+METHOD:
+   CavDbgKeysUpdate
+
+DESCRIPTION:
+   Move the category key references from one mask to another. Called with
+   CavDbgMutex held.
+
+PARAMETERS:
+   oldMask: [ I ] - mask being replaced
+   newMask: [ I ] - new mask
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavDbgKeysUpdate(ulong oldMask, ulong newMask)
+{
+	int cat;
+
+	for (cat = 0; cat < CAV_DBG_CATEGORIES; cat++) {
+		bool bOld = (oldMask & BIT(cat)) != 0;
+		bool bNew = (newMask & BIT(cat)) != 0;
+
+		if (bNew && !bOld) {
+			static_branch_inc(&CavDbgKeys[cat]);
+		} else if (bOld && !bNew) {
+			static_branch_dec(&CavDbgKeys[cat]);
+		}
+	}
+} // CavDbgKeysUpdate
+
+/*===========================================================================
+METHOD:
+   CavDbgSetMask
+
+DESCRIPTION:
+   Set the debug mask of a device
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   mask:    [ I ] - CAV_DBG_* category bits
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavDbgSetMask(cav_device_context *context, ulong mask)
+{
+	mask &= CAV_DBG_ALL;
+
+	mutex_lock(&CavDbgMutex);
+	CavDbgKeysUpdate(context->DebugMask, mask);
+	WRITE_ONCE(context->DebugMask, mask);
+	mutex_unlock(&CavDbgMutex);
+} // CavDbgSetMask
+CAV_KUNIT_EXPORT(CavDbgSetMask);
+
+/*===========================================================================
+METHOD:
+   CavDebugSet
+
+DESCRIPTION:
+   Set handler of the debug module parameter. 1, the old on switch,
+   enables every category. Ports that exist keep their mask.
+
+PARAMETERS:
+   val: [ I ] - new value
+   kp:  [ I ] - parameter
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static int CavDebugSet(const char *val, const struct kernel_param *kp)
+{
+	ulong mask;
+	int nRetval;
+
+	nRetval = kstrtoul(val, 0, &mask);
+	if (nRetval != 0) {
+		return nRetval;
+	}
+	if (mask == 1) {
+		mask = CAV_DBG_ALL;
+	}
+	mask &= CAV_DBG_ALL;
+
+	mutex_lock(&CavDbgMutex);
+	CavDbgKeysUpdate(debug, mask);
+	WRITE_ONCE(debug, mask);
+	mutex_unlock(&CavDbgMutex);
+	return 0;
+} // CavDebugSet
+
+/*===========================================================================
+METHOD:
+   CavDebugfsInit
+
+DESCRIPTION:
+   Create the debugfs root directory of the driver and the fault
+   injection attributes in it
+
+PARAMETERS:
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavDebugfsInit(void)
+{
+	CavDebugfsRoot = debugfs_create_dir("CavQMSerial", NULL);
+#ifdef CONFIG_FAULT_INJECTION_DEBUG_FS
+	fault_create_debugfs_attr("fail_int", CavDebugfsRoot, &CavFailInt);
+#endif
+} // CavDebugfsInit
+
+/*===========================================================================
+METHOD:
+   CavDebugfsExit
+
+DESCRIPTION:
+   Remove the debugfs root directory of the driver
+
+PARAMETERS:
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavDebugfsExit(void)
+{
+	debugfs_remove_recursive(CavDebugfsRoot);
+	CavDebugfsRoot = NULL;
+} // CavDebugfsExit
+
+/*===========================================================================
+METHOD:
+   CavDebugfsAdd
+
+DESCRIPTION:
+   Create the debugfs directory of a port, named after its ttyUSB node
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavDebugfsAdd(cav_device_context *context)
+{
+	context->pDebugfsDir =
+		debugfs_create_dir(dev_name(&context->MyPort->dev),
+				   CavDebugfsRoot);
+	CavCaptureDebugfsAdd(context);
+	CavHistDebugfsAdd(context);
+} // CavDebugfsAdd
+
+/*===========================================================================
+METHOD:
+   CavDebugfsRemove
+
+DESCRIPTION:
+   Remove the debugfs directory of a port, waits for open files to leave
+   their file operations
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavDebugfsRemove(cav_device_context *context)
+{
+	debugfs_remove_recursive(context->pDebugfsDir);
+	context->pDebugfsDir = NULL;
+} // CavDebugfsRemove
+
+static const struct kernel_param_ops CavDebugOps = {
+	.set = CavDebugSet,
+	.get = param_get_ulong,
+};
+
+module_param_cb(debug, &CavDebugOps, &debug, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(debug,
+		 "Debug mask of new ports, 1 enables all: "
+		 "0x2 open, 0x4 rx, 0x8 tx, 0x10 int, 0x20 data");
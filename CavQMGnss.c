@@ -0,0 +1,755 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include "CavQMSerial.h"
+#include "CavQMUapi.h"
+
+// Create /dev/cavgnssN next to the GNSS ttyUSB node
+static bool gnss_cdev;
+
+// Size of the GNSS ring in bytes, rounded down to a power of two
+static uint gnss_ring_size = CAV_GNSS_RING_SIZE_DEFAULT;
+
+// Share the ring between any number of readers
+static bool gnss_fanout;
+
+/*===========================================================================
+METHOD:
+   CavGnssRx
+
+DESCRIPTION:
+   Copy received GNSS data into the ring shared with user space and stamp
+   it with its arrival time. In fan-out mode the oldest data is
+   overwritten, readers that fall behind by more than the ring size lose
+   their own data.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - received data
+   len:     [ I ] - number of bytes received
+   rxTime:  [ I ] - CLOCK_MONOTONIC time of the URB completion
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavGnssRx(cav_device_context *context, const unsigned char *pData,
+	       int len, ktime_t rxTime)
+{
+	cav_gnss_ring *pRing = context->GnssRing;
+	struct cav_gnss_ring_ctrl *pCtrl;
+	cav_gnss_stamp *pStamp;
+	unsigned long flags;
+	unsigned int head, used, count, offset, first;
+	int frame;
+
+	if ((pRing == NULL) || (READ_ONCE(pRing->Users) == 0) || (len == 0)) {
+		return;
+	}
+	pCtrl = pRing->pCtrl;
+	frame = usb_get_current_frame_number(context->MySerial->dev);
+
+	spin_lock_irqsave(&pRing->Lock, flags);
+	head = pRing->Head;
+	if (pRing->bFanout != 0) {
+		if (len > pRing->Size) {
+			// Only the last ring size bytes can be kept
+			head += len - pRing->Size;
+			pData += len - pRing->Size;
+			len = pRing->Size;
+		}
+		count = len;
+	} else {
+		used = head - smp_load_acquire(&pCtrl->tail);
+		if (used > pRing->Size) {
+			// The application corrupted tail, treat the ring as
+			// full
+			used = pRing->Size;
+		}
+		count = min_t(unsigned int, len, pRing->Size - used);
+		pCtrl->overruns += len - count;
+	}
+
+	offset = head & (pRing->Size - 1);
+	first = min_t(unsigned int, count, pRing->Size - offset);
+	memcpy(pRing->pData + offset, pData, first);
+	memcpy(pRing->pData, pData + first, count - first);
+	smp_store_release(&pRing->Head, head + count);
+	smp_store_release(&pCtrl->head, head + count);
+
+	if (count != 0) {
+		pStamp = &pRing->pStamps[pRing->StampHead++ &
+					 (CAV_GNSS_STAMPS - 1)];
+		pStamp->Start = head;
+		pStamp->Len = count;
+		pStamp->Time = rxTime;
+		pStamp->RealTime = ktime_mono_to_real(rxTime);
+		pStamp->Frame = frame;
+	}
+	spin_unlock_irqrestore(&pRing->Lock, flags);
+
+	if (count != 0) {
+		wake_up_interruptible(&pRing->Wait);
+	}
+} // CavGnssRx
+
+/*===========================================================================
+METHOD:
+   CavGnssOpen
+
+DESCRIPTION:
+   Open /dev/cavgnssN, keeps the bulk-IN read engine running
+
+PARAMETERS:
+   pInode: [ I ] - inode being opened
+   pFile:  [ I ] - file being opened
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static int CavGnssOpen(struct inode *pInode, struct file *pFile)
+{
+	cav_char_dev *pChar = CavCharOpen(pInode);
+	cav_device_context *context;
+	cav_gnss_ring *pRing;
+	cav_gnss_reader *pReader;
+	unsigned long flags;
+	int nRetval;
+
+	if (pChar == NULL) {
+		return -ENODEV;
+	}
+	context = pChar->Context;
+	pRing = context->GnssRing;
+
+	nRetval = CavWaitReady(context);
+	if (nRetval != 0) {
+		CavContextPut(context);
+		return nRetval;
+	}
+
+	pReader = kzalloc(sizeof(cav_gnss_reader), GFP_KERNEL);
+	if (pReader == NULL) {
+		CavContextPut(context);
+		return -ENOMEM;
+	}
+	pReader->Context = context;
+	mutex_init(&pReader->ReadLock);
+	pReader->Pid = task_tgid_nr(current);
+	memcpy(pReader->Comm, current->comm, TASK_COMM_LEN);
+
+	mutex_lock(&context->OpenLock);
+	pRing->Users++;
+	mutex_unlock(&context->OpenLock);
+
+	nRetval = CavRxGet(context);
+	if (nRetval != 0) {
+		mutex_lock(&context->OpenLock);
+		pRing->Users--;
+		mutex_unlock(&context->OpenLock);
+		kfree(pReader);
+		CavContextPut(context);
+		return nRetval;
+	}
+
+	// New readers start with the next received byte
+	spin_lock_irqsave(&pRing->Lock, flags);
+	pReader->Cursor = pRing->Head;
+	list_add_tail(&pReader->List, &pRing->Readers);
+	spin_unlock_irqrestore(&pRing->Lock, flags);
+
+	pFile->private_data = pReader;
+	return nonseekable_open(pInode, pFile);
+} // CavGnssOpen
+
+/*===========================================================================
+METHOD:
+   CavGnssRelease
+
+DESCRIPTION:
+   Close /dev/cavgnssN
+
+PARAMETERS:
+   pInode: [ I ] - inode being closed
+   pFile:  [ I ] - file being closed
+
+RETURN VALUE:
+   int - zero
+===========================================================================*/
+static int CavGnssRelease(struct inode *pInode, struct file *pFile)
+{
+	cav_gnss_reader *pReader = pFile->private_data;
+	cav_device_context *context = pReader->Context;
+	cav_gnss_ring *pRing = context->GnssRing;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pRing->Lock, flags);
+	list_del(&pReader->List);
+	spin_unlock_irqrestore(&pRing->Lock, flags);
+	kfree(pReader);
+
+	mutex_lock(&context->OpenLock);
+	pRing->Users--;
+	mutex_unlock(&context->OpenLock);
+
+	CavRxPut(context);
+	CavContextPut(context);
+	return 0;
+} // CavGnssRelease
+
+/*===========================================================================
+METHOD:
+   CavGnssReadRecords
+
+DESCRIPTION:
+   Return the transfers after the stamp cursor of a reader in record
+   mode, each as struct cav_gnss_record followed by its data. Records
+   whose stamp or data were overwritten are skipped and reported in the
+   dropped field of the next record. Called with the read lock held.
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pBuf:  [ O ] - user buffer
+   count: [ I ] - size of pBuf, at least one record header
+
+RETURN VALUE:
+   ssize_t - number of bytes read, zero once the device is gone
+           - negative errno on error
+===========================================================================*/
+static ssize_t CavGnssReadRecords(struct file *pFile, char __user *pBuf,
+				  size_t count)
+{
+	cav_gnss_reader *pReader = pFile->private_data;
+	cav_device_context *context = pReader->Context;
+	cav_gnss_ring *pRing = context->GnssRing;
+	struct cav_gnss_record record;
+	cav_gnss_stamp stamp;
+	unsigned int avail, offset, first, len;
+	unsigned long flags;
+	ssize_t nRetval = 0;
+	size_t size;
+
+	if (count < sizeof(record)) {
+		return -EINVAL;
+	}
+
+	while (count - nRetval >= sizeof(record)) {
+		spin_lock_irqsave(&pRing->Lock, flags);
+		avail = pRing->StampHead - pReader->StampCursor;
+		if (avail > CAV_GNSS_STAMPS) {
+			pReader->RecDropped += avail - CAV_GNSS_STAMPS;
+			pReader->StampCursor =
+				pRing->StampHead - CAV_GNSS_STAMPS;
+			avail = CAV_GNSS_STAMPS;
+		}
+		if (avail != 0) {
+			stamp = pRing->pStamps[pReader->StampCursor &
+					       (CAV_GNSS_STAMPS - 1)];
+		}
+		spin_unlock_irqrestore(&pRing->Lock, flags);
+
+		if (avail == 0) {
+			if ((nRetval != 0) || (context->bDevRemoved != 0)) {
+				break;
+			}
+			if ((pFile->f_flags & O_NONBLOCK) != 0) {
+				nRetval = -EAGAIN;
+				break;
+			}
+			if (wait_event_interruptible(
+				    pRing->Wait,
+				    (READ_ONCE(pRing->StampHead) !=
+				     READ_ONCE(pReader->StampCursor)) ||
+					    (context->bDevRemoved != 0)) != 0) {
+				nRetval = -ERESTARTSYS;
+				break;
+			}
+			continue;
+		}
+
+		memset(&record, 0, sizeof(record));
+		len = stamp.Len;
+		size = ALIGN(sizeof(record) + len, 8);
+		if (size > count - nRetval) {
+			if (nRetval != 0) {
+				break;
+			}
+			// The alignment padding alone may not fit, that does
+			// not truncate the data
+			len = min_t(unsigned int, stamp.Len,
+				    count - sizeof(record));
+			size = count;
+			if (len < stamp.Len) {
+				record.flags = CAV_GNSS_REC_TRUNCATED;
+			}
+		}
+		record.time_ns = ktime_to_ns(stamp.Time);
+		record.real_ns = ktime_to_ns(stamp.RealTime);
+		record.frame = stamp.Frame;
+		record.len = len;
+		record.dropped = pReader->RecDropped;
+
+		offset = stamp.Start & (pRing->Size - 1);
+		first = min_t(unsigned int, len, pRing->Size - offset);
+		if ((copy_to_user(pBuf + nRetval, &record, sizeof(record)) !=
+		     0) ||
+		    (copy_to_user(pBuf + nRetval + sizeof(record),
+				  pRing->pData + offset, first) != 0) ||
+		    (copy_to_user(pBuf + nRetval + sizeof(record) + first,
+				  pRing->pData, len - first) != 0)) {
+			if (nRetval == 0) {
+				nRetval = -EFAULT;
+			}
+			break;
+		}
+
+		// Same overwrite check as the byte stream
+		spin_lock_irqsave(&pRing->Lock, flags);
+		pReader->StampCursor++;
+		if (pRing->Head - stamp.Start <= pRing->Size) {
+			pReader->Cursor = stamp.Start + stamp.Len;
+			pReader->Bytes += len;
+			pReader->RecDropped = 0;
+			nRetval += size;
+		} else {
+			pReader->Dropped += stamp.Len;
+			pReader->RecDropped++;
+		}
+		spin_unlock_irqrestore(&pRing->Lock, flags);
+	}
+
+	return nRetval;
+} // CavGnssReadRecords
+
+/*===========================================================================
+METHOD:
+   CavGnssRead
+
+DESCRIPTION:
+   Return the data after the cursor of a fan-out reader. A reader that
+   fell behind by more than the ring size skips to the oldest byte still
+   in the ring and counts the rest as dropped. Data overwritten while it
+   was copied is dropped the same way.
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pBuf:  [ O ] - user buffer
+   count: [ I ] - size of pBuf
+   pPos:  [ I ] - unused, the device is not seekable
+
+RETURN VALUE:
+   ssize_t - number of bytes read, zero once the device is gone
+           - negative errno on error
+===========================================================================*/
+static ssize_t CavGnssRead(struct file *pFile, char __user *pBuf,
+			   size_t count, loff_t *pPos)
+{
+	cav_gnss_reader *pReader = pFile->private_data;
+	cav_device_context *context = pReader->Context;
+	cav_gnss_ring *pRing = context->GnssRing;
+	unsigned int head, cursor, avail, offset, first;
+	unsigned long flags;
+	ssize_t nRetval;
+
+	if (pRing->bFanout == 0) {
+		// The mapping has a single consumer, see gnss_fanout
+		return -EINVAL;
+	}
+	if (count == 0) {
+		return 0;
+	}
+	if (mutex_lock_interruptible(&pReader->ReadLock) != 0) {
+		return -ERESTARTSYS;
+	}
+	if (pReader->bRecords) {
+		nRetval = CavGnssReadRecords(pFile, pBuf, count);
+		mutex_unlock(&pReader->ReadLock);
+		return nRetval;
+	}
+
+	for (;;) {
+		spin_lock_irqsave(&pRing->Lock, flags);
+		head = pRing->Head;
+		avail = head - pReader->Cursor;
+		if (avail > pRing->Size) {
+			pReader->Dropped += avail - pRing->Size;
+			pReader->Cursor = head - pRing->Size;
+			avail = pRing->Size;
+		}
+		cursor = pReader->Cursor;
+		spin_unlock_irqrestore(&pRing->Lock, flags);
+
+		if (avail == 0) {
+			if (context->bDevRemoved != 0) {
+				nRetval = 0;
+				break;
+			}
+			if ((pFile->f_flags & O_NONBLOCK) != 0) {
+				nRetval = -EAGAIN;
+				break;
+			}
+			if (wait_event_interruptible(
+				    pRing->Wait,
+				    (smp_load_acquire(&pRing->Head) !=
+				     READ_ONCE(pReader->Cursor)) ||
+					    (context->bDevRemoved != 0)) != 0) {
+				nRetval = -ERESTARTSYS;
+				break;
+			}
+			continue;
+		}
+
+		avail = min_t(size_t, avail, count);
+		offset = cursor & (pRing->Size - 1);
+		first = min_t(unsigned int, avail, pRing->Size - offset);
+		if ((copy_to_user(pBuf, pRing->pData + offset, first) != 0) ||
+		    (copy_to_user(pBuf + first, pRing->pData,
+				  avail - first) != 0)) {
+			nRetval = -EFAULT;
+			break;
+		}
+
+		// The producer writes under the lock, a head within one ring
+		// of the cursor means the copied bytes were not overwritten
+		spin_lock_irqsave(&pRing->Lock, flags);
+		head = pRing->Head;
+		if (head - cursor <= pRing->Size) {
+			pReader->Cursor = cursor + avail;
+			pReader->Bytes += avail;
+			spin_unlock_irqrestore(&pRing->Lock, flags);
+			nRetval = avail;
+			break;
+		}
+		spin_unlock_irqrestore(&pRing->Lock, flags);
+	}
+
+	mutex_unlock(&pReader->ReadLock);
+	return nRetval;
+} // CavGnssRead
+
+/*===========================================================================
+METHOD:
+   CavGnssMmap
+
+DESCRIPTION:
+   Map the control page and the data area of the ring. In fan-out mode
+   the mapping is read-only, readers keep their cursor to themselves.
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pVma:  [ I ] - user mapping
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static int CavGnssMmap(struct file *pFile, struct vm_area_struct *pVma)
+{
+	cav_gnss_reader *pReader = pFile->private_data;
+	cav_gnss_ring *pRing = pReader->Context->GnssRing;
+
+	if ((pVma->vm_flags & VM_SHARED) == 0) {
+		return -EINVAL;
+	}
+	if (pRing->bFanout != 0) {
+		if ((pVma->vm_flags & VM_WRITE) != 0) {
+			return -EPERM;
+		}
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0))
+		vm_flags_clear(pVma, VM_MAYWRITE);
+#else
+		pVma->vm_flags &= ~VM_MAYWRITE;
+#endif
+	}
+	return remap_vmalloc_range(pVma, pRing->pCtrl, pVma->vm_pgoff);
+} // CavGnssMmap
+
+/*===========================================================================
+METHOD:
+   CavGnssPoll
+
+DESCRIPTION:
+   Report POLLIN while the ring holds data the application did not
+   consume, or in fan-out mode data after the cursor of the reader
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pWait: [ I ] - poll table
+
+RETURN VALUE:
+   poll mask
+===========================================================================*/
+static __poll_t CavGnssPoll(struct file *pFile, poll_table *pWait)
+{
+	cav_gnss_reader *pReader = pFile->private_data;
+	cav_device_context *context = pReader->Context;
+	cav_gnss_ring *pRing = context->GnssRing;
+	__poll_t mask = 0;
+	unsigned int tail;
+
+	poll_wait(pFile, &pRing->Wait, pWait);
+	if (pReader->bRecords) {
+		if (READ_ONCE(pRing->StampHead) !=
+		    READ_ONCE(pReader->StampCursor)) {
+			mask |= EPOLLIN | EPOLLRDNORM;
+		}
+	} else {
+		if (pRing->bFanout != 0) {
+			tail = READ_ONCE(pReader->Cursor);
+		} else {
+			tail = READ_ONCE(pRing->pCtrl->tail);
+		}
+		if (smp_load_acquire(&pRing->Head) != tail) {
+			mask |= EPOLLIN | EPOLLRDNORM;
+		}
+	}
+	if (context->bDevRemoved != 0) {
+		mask |= EPOLLHUP | EPOLLERR;
+	}
+	return mask;
+} // CavGnssPoll
+
+/*===========================================================================
+METHOD:
+   CavGnssIoctl
+
+DESCRIPTION:
+   Switch a fan-out reader between the byte stream and record mode, the
+   new mode starts with the next received data
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   cmd:   [ I ] - CAV_GNSS_IOC_*
+   arg:   [ I ] - user pointer
+
+RETURN VALUE:
+   long - zero for success
+        - negative errno on error
+===========================================================================*/
+static long CavGnssIoctl(struct file *pFile, unsigned int cmd,
+			 unsigned long arg)
+{
+	cav_gnss_reader *pReader = pFile->private_data;
+	cav_gnss_ring *pRing = pReader->Context->GnssRing;
+	unsigned long flags;
+	__u32 enable;
+
+	switch (cmd) {
+	case CAV_GNSS_IOC_SET_RECORDS:
+		if (get_user(enable, (__u32 __user *)arg) != 0) {
+			return -EFAULT;
+		}
+		if (pRing->bFanout == 0) {
+			return -EINVAL;
+		}
+		if (mutex_lock_interruptible(&pReader->ReadLock) != 0) {
+			return -ERESTARTSYS;
+		}
+		spin_lock_irqsave(&pRing->Lock, flags);
+		pReader->bRecords = (enable != 0);
+		pReader->Cursor = pRing->Head;
+		pReader->StampCursor = pRing->StampHead;
+		pReader->RecDropped = 0;
+		spin_unlock_irqrestore(&pRing->Lock, flags);
+		mutex_unlock(&pReader->ReadLock);
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+} // CavGnssIoctl
+
+static const struct file_operations CavGnssFops = {
+	.owner = THIS_MODULE,
+	.open = CavGnssOpen,
+	.release = CavGnssRelease,
+	.read = CavGnssRead,
+	.mmap = CavGnssMmap,
+	.poll = CavGnssPoll,
+	.unlocked_ioctl = CavGnssIoctl,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 5, 0))
+	.compat_ioctl = compat_ptr_ioctl,
+#endif
+};
+
+/*===========================================================================
+METHOD:
+   CavGnssAdd
+
+DESCRIPTION:
+   Allocate the ring and create /dev/cavgnssN for a GNSS port
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success or if the device is not wanted
+===========================================================================*/
+int CavGnssAdd(cav_device_context *context)
+{
+	cav_gnss_ring *pRing;
+	unsigned int size;
+	int nRetval;
+
+	if ((gnss_cdev == false) ||
+	    (context->pProfile->Role != CAV_ROLE_GNSS) ||
+	    (context->RxUrbCount == 0)) {
+		return 0;
+	}
+
+	pRing = kzalloc(sizeof(cav_gnss_ring), GFP_KERNEL);
+	if (pRing == NULL) {
+		return -ENOMEM;
+	}
+
+	size = rounddown_pow_of_two(clamp_t(uint, gnss_ring_size, PAGE_SIZE,
+					    CAV_GNSS_RING_SIZE_MAX));
+	pRing->pStamps =
+		kcalloc(CAV_GNSS_STAMPS, sizeof(cav_gnss_stamp), GFP_KERNEL);
+	pRing->pCtrl = vmalloc_user(PAGE_SIZE + size);
+	if ((pRing->pStamps == NULL) || (pRing->pCtrl == NULL)) {
+		vfree(pRing->pCtrl);
+		kfree(pRing->pStamps);
+		kfree(pRing);
+		return -ENOMEM;
+	}
+	pRing->pData = (unsigned char *)pRing->pCtrl + PAGE_SIZE;
+	pRing->Size = size;
+	pRing->bFanout = gnss_fanout;
+	spin_lock_init(&pRing->Lock);
+	init_waitqueue_head(&pRing->Wait);
+	INIT_LIST_HEAD(&pRing->Readers);
+
+	pRing->pCtrl->magic = CAV_GNSS_RING_MAGIC;
+	pRing->pCtrl->version = CAV_GNSS_RING_VERSION;
+	pRing->pCtrl->data_offset = PAGE_SIZE;
+	pRing->pCtrl->data_size = size;
+	if (pRing->bFanout != 0) {
+		pRing->pCtrl->flags = CAV_GNSS_RING_FANOUT;
+	}
+	context->GnssRing = pRing;
+
+	nRetval = CavCharAdd(&context->GnssChar, context, &CavGnssFops,
+			     "cavgnss");
+	if (nRetval != 0) {
+		context->GnssRing = NULL;
+		vfree(pRing->pCtrl);
+		kfree(pRing->pStamps);
+		kfree(pRing);
+	}
+	return nRetval;
+} // CavGnssAdd
+
+/*===========================================================================
+METHOD:
+   CavGnssRemove
+
+DESCRIPTION:
+   Remove /dev/cavgnssN and wake up its pollers, the ring stays until the
+   last file is closed
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavGnssRemove(cav_device_context *context)
+{
+	if (context->GnssRing == NULL) {
+		return;
+	}
+	CavCharRemove(&context->GnssChar);
+	wake_up_interruptible(&context->GnssRing->Wait);
+} // CavGnssRemove
+
+/*===========================================================================
+METHOD:
+   CavGnssFree
+
+DESCRIPTION:
+   Free the ring, called when the last context reference is dropped
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavGnssFree(cav_device_context *context)
+{
+	if (context->GnssRing == NULL) {
+		return;
+	}
+	vfree(context->GnssRing->pCtrl);
+	kfree(context->GnssRing->pStamps);
+	kfree(context->GnssRing);
+	context->GnssRing = NULL;
+} // CavGnssFree
+
+/*===========================================================================
+METHOD:
+   CavGnssReadersShow
+
+DESCRIPTION:
+   List the open files of /dev/cavgnssN, one line per reader with its
+   process, the bytes it has not read yet, the bytes it lost and the bytes
+   it read. The lag is capped at the ring size, the excess is reported as
+   dropped.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   buf:     [ O ] - PAGE_SIZE sysfs buffer
+
+RETURN VALUE:
+   number of bytes written to buf
+===========================================================================*/
+ssize_t CavGnssReadersShow(cav_device_context *context, char *buf)
+{
+	cav_gnss_ring *pRing = context->GnssRing;
+	cav_gnss_reader *pReader;
+	unsigned long flags;
+	unsigned int lag;
+	u64 dropped;
+	ssize_t len = 0;
+
+	if (pRing == NULL) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&pRing->Lock, flags);
+	list_for_each_entry(pReader, &pRing->Readers, List) {
+		lag = pRing->Head - pReader->Cursor;
+		dropped = pReader->Dropped;
+		if (lag > pRing->Size) {
+			dropped += lag - pRing->Size;
+			lag = pRing->Size;
+		}
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%d %s lag=%u dropped=%llu bytes=%llu\n",
+				 pReader->Pid, pReader->Comm, lag, dropped,
+				 pReader->Bytes);
+	}
+	spin_unlock_irqrestore(&pRing->Lock, flags);
+	return len;
+} // CavGnssReadersShow
+
+module_param(gnss_cdev, bool, S_IRUGO);
+MODULE_PARM_DESC(gnss_cdev, "Create /dev/cavgnssN mmap ring for GNSS ports");
+module_param(gnss_ring_size, uint, S_IRUGO);
+MODULE_PARM_DESC(gnss_ring_size, "GNSS ring size in bytes");
+module_param(gnss_fanout, bool, S_IRUGO);
+MODULE_PARM_DESC(gnss_fanout, "Give every /dev/cavgnssN reader its own cursor");
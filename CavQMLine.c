@@ -0,0 +1,180 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/usb/cdc.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include "CavQMSerial.h"
+
+// Input lines reported as state, the others are one-shot events
+#define CAV_LINE_STATE_MASK \
+	(USB_CDC_SERIAL_STATE_DCD | USB_CDC_SERIAL_STATE_DSR)
+
+/*===========================================================================
+METHOD:
+   CavLineNotify
+
+DESCRIPTION:
+   Decode a CDC SERIAL_STATE notification from the interrupt endpoint.
+   DCD and DSR are line states and are counted on change, ring, break,
+   framing, parity and overrun are counted each time they are reported.
+   Waiters of TIOCMIWAIT are woken on any change and a DCD drop hangs up
+   the TTY unless CLOCAL is set.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - notification
+   len:     [ I ] - notification length
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavLineNotify(cav_device_context *context, const unsigned char *pData,
+		   int len)
+{
+	const struct usb_cdc_notification *pNotify = (const void *)pData;
+	struct usb_serial_port *pPort = context->MyPort;
+	struct tty_struct *pTTY;
+	unsigned long flags;
+	u16 state, changed;
+
+	if ((len < (int)sizeof(*pNotify) + 2) ||
+	    (pNotify->bNotificationType != USB_CDC_NOTIFY_SERIAL_STATE) ||
+	    (le16_to_cpu(pNotify->wLength) < 2)) {
+		return;
+	}
+	state = get_unaligned_le16(pData + sizeof(*pNotify));
+
+	changed = (state ^ context->SerialState) & CAV_LINE_STATE_MASK;
+	WRITE_ONCE(context->SerialState, state);
+
+	CavDbg(context, CAV_DBG_INT,
+	       "<%s> serial state 0x%02x changed 0x%02x\n",
+	       CavPort(context, NULL), state, changed);
+	if (((changed & USB_CDC_SERIAL_STATE_DCD) != 0) &&
+	    ((state & USB_CDC_SERIAL_STATE_DCD) == 0)) {
+		CavUrcCarrierLost(context);
+	}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0))
+	if ((changed == 0) && ((state & ~CAV_LINE_STATE_MASK) == 0)) {
+		return;
+	}
+
+	spin_lock_irqsave(&pPort->lock, flags);
+	if ((changed & USB_CDC_SERIAL_STATE_DCD) != 0) {
+		pPort->icount.dcd++;
+	}
+	if ((changed & USB_CDC_SERIAL_STATE_DSR) != 0) {
+		pPort->icount.dsr++;
+	}
+	if ((state & USB_CDC_SERIAL_STATE_RING_SIGNAL) != 0) {
+		pPort->icount.rng++;
+	}
+	if ((state & USB_CDC_SERIAL_STATE_BREAK) != 0) {
+		pPort->icount.brk++;
+	}
+	if ((state & USB_CDC_SERIAL_STATE_FRAMING) != 0) {
+		pPort->icount.frame++;
+	}
+	if ((state & USB_CDC_SERIAL_STATE_PARITY) != 0) {
+		pPort->icount.parity++;
+	}
+	if ((state & USB_CDC_SERIAL_STATE_OVERRUN) != 0) {
+		pPort->icount.overrun++;
+	}
+	spin_unlock_irqrestore(&pPort->lock, flags);
+
+	if ((changed & USB_CDC_SERIAL_STATE_DCD) != 0) {
+		pTTY = tty_port_tty_get(&pPort->port);
+		usb_serial_handle_dcd_change(pPort, pTTY,
+					     state & USB_CDC_SERIAL_STATE_DCD);
+		tty_kref_put(pTTY);
+	}
+	wake_up_interruptible(&pPort->port.delta_msr_wait);
+#endif
+} // CavLineNotify
+
+/*===========================================================================
+METHOD:
+   CavTiocmGet (Free Method)
+
+DESCRIPTION:
+   Return the modem lines, DTR/RTS as last set and DCD/DSR/RI from the
+   last SERIAL_STATE notification
+
+PARAMETERS:
+   tty: [ I ] - TTY structure
+
+RETURN VALUE:
+   int - TIOCM_* bits
+===========================================================================*/
+int CavTiocmGet(struct tty_struct *tty)
+{
+	struct usb_serial_port *pPort = tty->driver_data;
+	cav_device_context *context =
+		(cav_device_context *)usb_get_serial_data(pPort->serial);
+	u16 state = READ_ONCE(context->SerialState);
+	u16 ctrl = READ_ONCE(context->LineCtrl);
+	int lines = 0;
+
+	if ((ctrl & CAV_SER_DTR) != 0) {
+		lines |= TIOCM_DTR;
+	}
+	if ((ctrl & CAV_SER_RTS) != 0) {
+		lines |= TIOCM_RTS;
+	}
+	if ((state & USB_CDC_SERIAL_STATE_DCD) != 0) {
+		lines |= TIOCM_CD;
+	}
+	if ((state & USB_CDC_SERIAL_STATE_DSR) != 0) {
+		lines |= TIOCM_DSR;
+	}
+	if ((state & USB_CDC_SERIAL_STATE_RING_SIGNAL) != 0) {
+		lines |= TIOCM_RI;
+	}
+	return lines;
+} // CavTiocmGet
+
+/*===========================================================================
+METHOD:
+   CavTiocmSet (Free Method)
+
+DESCRIPTION:
+   Set or clear DTR and RTS
+
+PARAMETERS:
+   tty:   [ I ] - TTY structure
+   set:   [ I ] - TIOCM_* bits to set
+   clear: [ I ] - TIOCM_* bits to clear
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+int CavTiocmSet(struct tty_struct *tty, unsigned int set, unsigned int clear)
+{
+	struct usb_serial_port *pPort = tty->driver_data;
+	cav_device_context *context =
+		(cav_device_context *)usb_get_serial_data(pPort->serial);
+	u16 ctrl = READ_ONCE(context->LineCtrl);
+
+	if ((set & TIOCM_DTR) != 0) {
+		ctrl |= CAV_SER_DTR;
+	}
+	if ((set & TIOCM_RTS) != 0) {
+		ctrl |= CAV_SER_RTS;
+	}
+	if ((clear & TIOCM_DTR) != 0) {
+		ctrl &= ~CAV_SER_DTR;
+	}
+	if ((clear & TIOCM_RTS) != 0) {
+		ctrl &= ~CAV_SER_RTS;
+	}
+	return CavSetDtrRts(context, ctrl);
+} // CavTiocmSet
@@ -0,0 +1,245 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/pm_runtime.h>
+#include "CavQMSerial.h"
+
+// Autosuspend delay applied to the modem, negative leaves the runtime PM
+// policy of the device to user space
+static int autosuspend_ms = -1;
+
+/*===========================================================================
+METHOD:
+   CavPmInit
+
+DESCRIPTION:
+   Apply the autosuspend_ms policy to the device
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavPmInit(cav_device_context *context)
+{
+	struct usb_device *pDev = context->MySerial->dev;
+
+	if (autosuspend_ms < 0) {
+		return;
+	}
+	pm_runtime_set_autosuspend_delay(&pDev->dev, autosuspend_ms);
+	usb_enable_autosuspend(pDev);
+} // CavPmInit
+
+/*===========================================================================
+METHOD:
+   CavPmWake
+
+DESCRIPTION:
+   Request an asynchronous resume for data queued while suspended. The
+   autopm reference taken here is dropped by the resume. Called with
+   TxLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavPmWake(cav_device_context *context)
+{
+	if (context->bResumeRequested != 0) {
+		return;
+	}
+	if (usb_autopm_get_interface_async(context->MySerial->interface) ==
+	    0) {
+		context->bResumeRequested = 1;
+		context->ResumeRequestedAt = ktime_get();
+	}
+} // CavPmWake
+
+/*===========================================================================
+METHOD:
+   CavPmSuspend (Free Method)
+
+DESCRIPTION:
+   Stop the URBs of the port before the device suspends. Autosuspend is
+   refused while the write engine holds data.
+
+PARAMETERS:
+   pSerial:    [ I ] - serial structure
+   powerEvent: [ I ] - suspend type
+
+RETURN VALUE:
+   int - zero for success
+       - -EBUSY to veto an autosuspend
+===========================================================================*/
+int CavPmSuspend(struct usb_serial *pSerial, pm_message_t powerEvent)
+{
+	cav_device_context *context =
+		(cav_device_context *)usb_get_serial_data(pSerial);
+	unsigned long flags;
+	int index;
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	if (PMSG_IS_AUTO(powerEvent) && (context->TxUrbCount > 0) &&
+	    ((context->TxInFlight != 0) ||
+	     !kfifo_is_empty(&context->TxFifo))) {
+		spin_unlock_irqrestore(&context->TxLock, flags);
+		usb_mark_last_busy(pSerial->dev);
+		return -EBUSY;
+	}
+	context->bSuspended = 1;
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	// Data still in flight on a system suspend is lost
+	for (index = 0; index < context->TxUrbCount; index++) {
+		usb_kill_urb(context->TxUrb[index]);
+	}
+	if (test_bit(CAV_RX_RUNNING, &context->RxFlags) != 0) {
+		CavRxStop(context);
+		set_bit(CAV_RX_SUSPENDED, &context->RxFlags);
+	}
+	if (context->pIntUrb != NULL) {
+		cancel_delayed_work_sync(&context->IntRetryWork);
+		usb_kill_urb(context->pIntUrb);
+	}
+
+	context->SuspendedAt = ktime_get();
+	CavStatInc(context, CAV_STAT_PM_SUSPENDS);
+	CavDbg(context, CAV_DBG_PROBE, "<%s> suspended, event 0x%x\n",
+	       CavPort(context, NULL), powerEvent.event);
+	return 0;
+} // CavPmSuspend
+
+/*===========================================================================
+METHOD:
+   CavPmRestart
+
+DESCRIPTION:
+   Restart the URBs stopped by CavPmSuspend, send data queued while
+   suspended and record the resume latency. Latency is measured from the
+   write that requested the resume, or from the start of the resume.
+
+PARAMETERS:
+   context:  [ I ] - private context for the serial device
+   bReset:   [ I ] - device was reset, restore DTR/RTS
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static int CavPmRestart(cav_device_context *context, bool bReset)
+{
+	struct usb_serial *pSerial = context->MySerial;
+	ktime_t start = ktime_get();
+	ktime_t from = start;
+	unsigned long flags;
+	unsigned int latency;
+	int nRetval = 0;
+	int bWake;
+
+	CavStatAdd(context, CAV_STAT_PM_SUSPENDED_MS,
+		   ktime_ms_delta(start, context->SuspendedAt));
+
+	if ((context->bDevClosed == 0) && (context->pIntUrb != NULL)) {
+		if (bReset) {
+			CavSetDtrRts(context, READ_ONCE(context->LineCtrl));
+		}
+		context->IntErrCnt = 0;
+		ResubmitIntURB(context->pIntUrb);
+	}
+	if (test_and_clear_bit(CAV_RX_SUSPENDED, &context->RxFlags) != 0) {
+		nRetval = CavRxStart(context, GFP_NOIO);
+	} else if ((context->RxUrbCount == 0) && (context->bDevClosed == 0)) {
+		nRetval = usb_serial_generic_resume(pSerial);
+	}
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	context->bSuspended = 0;
+	bWake = context->bResumeRequested;
+	context->bResumeRequested = 0;
+	if (bWake != 0) {
+		from = context->ResumeRequestedAt;
+	}
+	spin_unlock_irqrestore(&context->TxLock, flags);
+	if (bReset) {
+		// The device lost the settings of the attach script
+		CavScriptRun(context, CAV_SCRIPT_ATTACH);
+	}
+	CavTxKick(context);
+
+	if (bWake != 0) {
+		CavStatInc(context, CAV_STAT_PM_WAKE_WRITES);
+		usb_autopm_put_interface_async(pSerial->interface);
+	}
+	latency = ktime_us_delta(ktime_get(), from);
+	WRITE_ONCE(context->ResumeLatencyUs, latency);
+	if (latency > context->ResumeLatencyMaxUs) {
+		WRITE_ONCE(context->ResumeLatencyMaxUs, latency);
+	}
+	usb_mark_last_busy(pSerial->dev);
+
+	CavDbg(context, CAV_DBG_PROBE, "<%s> resumed in %u us, reset %d\n",
+	       CavPort(context, NULL), latency, bReset);
+	return nRetval;
+} // CavPmRestart
+
+/*===========================================================================
+METHOD:
+   CavPmResume (Free Method)
+
+DESCRIPTION:
+   Resume callback of the serial driver
+
+PARAMETERS:
+   pSerial: [ I ] - serial structure
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+int CavPmResume(struct usb_serial *pSerial)
+{
+	cav_device_context *context =
+		(cav_device_context *)usb_get_serial_data(pSerial);
+
+	CavStatInc(context, CAV_STAT_PM_RESUMES);
+	return CavPmRestart(context, false);
+} // CavPmResume
+
+/*===========================================================================
+METHOD:
+   CavPmResetResume (Free Method)
+
+DESCRIPTION:
+   Resume after the device lost its state, restores the port in place
+   instead of letting the USB core unbind and re-enumerate it
+
+PARAMETERS:
+   pSerial: [ I ] - serial structure
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+int CavPmResetResume(struct usb_serial *pSerial)
+{
+	cav_device_context *context =
+		(cav_device_context *)usb_get_serial_data(pSerial);
+
+	CavStatInc(context, CAV_STAT_PM_RESET_RESUMES);
+	return CavPmRestart(context, true);
+} // CavPmResetResume
+
+module_param(autosuspend_ms, int, S_IRUGO);
+MODULE_PARM_DESC(autosuspend_ms,
+		 "Autosuspend delay in ms, -1 leaves the policy to user space");
@@ -0,0 +1,102 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include "CavQMSerial.h"
+
+//---------------------------------------------------------------------------
+// SKU profiles, one entry per interface number the driver binds to. URB
+// depth and buffer size of zero use the module parameters.
+//---------------------------------------------------------------------------
+static const cav_sku CavSkuC10QM = {
+	.Name = "C10QM",
+	.Intf = {
+		[C10QM_AT_INTF_NUM] = { .Role = CAV_ROLE_AT },
+		[C10QM_GNSS_INTF_NUM] = { .Role = CAV_ROLE_GNSS },
+	},
+};
+
+// Match one interface of a SKU, driver_info points to the SKU profile
+#define CAV_SKU_INTF(_vid_, _pid_, _intf_, _sku_)             \
+	{ USB_DEVICE_INTERFACE_NUMBER(_vid_, _pid_, _intf_),  \
+	  .driver_info = (kernel_ulong_t)&(_sku_) }
+
+// Built from the profiles above. SKUs added at runtime through new_id
+// with the C10QM VID/PID as reference share its profile.
+const struct usb_device_id CavConfigVIDPIDTable[] = {
+	CAV_SKU_INTF(C10QM_VID, C10QM_PID, C10QM_AT_INTF_NUM, CavSkuC10QM),
+	CAV_SKU_INTF(C10QM_VID, C10QM_PID, C10QM_GNSS_INTF_NUM, CavSkuC10QM),
+	// Terminating entry
+	{}
+};
+MODULE_DEVICE_TABLE(usb, CavConfigVIDPIDTable);
+
+static const char *const CavRoleNames[CAV_ROLES] = {
+	[CAV_ROLE_NONE] = "none",
+	[CAV_ROLE_AT] = "at",
+	[CAV_ROLE_GNSS] = "gnss",
+	[CAV_ROLE_DIAG] = "diag",
+	[CAV_ROLE_MODEM] = "modem",
+};
+
+/*===========================================================================
+METHOD:
+   CavProfileLookup
+
+DESCRIPTION:
+   Find the profile of an interface from the matched device ID. Dynamic
+   IDs added without a reference device use the C10QM profile.
+
+PARAMETERS:
+   pIntf: [ I ] - interface being probed
+   pID:   [ I ] - matched device ID
+   ppSku: [ O ] - SKU profile of the device
+
+RETURN VALUE:
+   interface profile, NULL if the SKU does not drive this interface
+===========================================================================*/
+const cav_intf_profile *CavProfileLookup(struct usb_interface *pIntf,
+					 const struct usb_device_id *pID,
+					 const cav_sku **ppSku)
+{
+	const cav_sku *pSku = &CavSkuC10QM;
+	unsigned int intfNum = pIntf->cur_altsetting->desc.bInterfaceNumber;
+
+	if ((pID != NULL) && (pID->driver_info != 0)) {
+		pSku = (const cav_sku *)pID->driver_info;
+	}
+	*ppSku = pSku;
+	if ((intfNum >= CAV_SKU_MAX_INTF) ||
+	    (pSku->Intf[intfNum].Role == CAV_ROLE_NONE)) {
+		return NULL;
+	}
+	return &pSku->Intf[intfNum];
+} // CavProfileLookup
+CAV_KUNIT_EXPORT(CavProfileLookup);
+
+/*===========================================================================
+METHOD:
+   CavRoleName
+
+DESCRIPTION:
+   Name of an interface role
+
+PARAMETERS:
+   role: [ I ] - CAV_ROLE_*
+
+RETURN VALUE:
+   role name
+===========================================================================*/
+const char *CavRoleName(int role)
+{
+	if ((role < 0) || (role >= CAV_ROLES)) {
+		return "unknown";
+	}
+	return CavRoleNames[role];
+} // CavRoleName
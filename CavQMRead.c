@@ -0,0 +1,991 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/tty_flip.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include "CavQMSerial.h"
+#include "CavQMTrace.h"
+
+// Number of bulk-IN URBs kept in flight per port
+static uint rx_urbs = CAV_RX_URBS_DEFAULT;
+
+// Bulk-IN URB buffer size, in multiples of wMaxPacketSize
+static uint rx_buf_mps = CAV_RX_BUF_MPS_DEFAULT;
+
+// Initial TTY push policy of every port, see CAV_PUSH_*
+static uint push_mode = CAV_PUSH_IMMEDIATE;
+
+// Initial push latency bound of every port in microseconds
+static uint push_latency_us = CAV_PUSH_LATENCY_US_DEFAULT;
+
+// Initial RX overflow policy of every port, see CAV_RX_*
+static uint rx_overflow = CAV_RX_BACKPRESSURE;
+
+// Size of the drop-oldest backlog in bytes
+static uint rx_fifo_size = CAV_RX_FIFO_SIZE_DEFAULT;
+
+static const char *const CavPushModeNames[CAV_PUSH_MODES] = {
+	[CAV_PUSH_IMMEDIATE] = "immediate",
+	[CAV_PUSH_BATCHED] = "batched",
+	[CAV_PUSH_LINE] = "line",
+};
+
+static const char *const CavRxOverflowNames[CAV_RX_OVERFLOWS] = {
+	[CAV_RX_BACKPRESSURE] = "backpressure",
+	[CAV_RX_DROP_NEWEST] = "drop-newest",
+	[CAV_RX_DROP_OLDEST] = "drop-oldest",
+};
+
+static void CavRxCallback(struct urb *pURB);
+static enum hrtimer_restart CavRxPushTimer(struct hrtimer *pTimer);
+
+/*===========================================================================
+METHOD:
+   CavRxAlloc
+
+DESCRIPTION:
+   Allocate the bulk-IN URBs and buffers of the read engine
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pPort:   [ I ] - serial port owning the bulk-IN endpoint
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavRxAlloc(cav_device_context *context, struct usb_serial_port *pPort)
+{
+	struct usb_device *pDev = pPort->serial->dev;
+	struct usb_host_endpoint *pEndpoint;
+	unsigned int pipe, maxPacket, urbCount, bufMps;
+	int index;
+
+	context->RxUrbCount = 0;
+	context->RxUrbsFree = 0;
+	context->RxFlags = 0;
+
+	spin_lock_init(&context->PushLock);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0))
+	hrtimer_setup(&context->PushTimer, CavRxPushTimer, CLOCK_MONOTONIC,
+		      HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&context->PushTimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	context->PushTimer.function = CavRxPushTimer;
+#endif
+	context->PushMode = min_t(uint, push_mode, CAV_PUSH_MODES - 1);
+	context->PushLatencyUs =
+		clamp_t(uint, push_latency_us, 1, CAV_PUSH_LATENCY_US_MAX);
+	context->PushModeSince = ktime_get();
+	context->RxOverflow = CAV_RX_BACKPRESSURE;
+	if ((rx_overflow < CAV_RX_OVERFLOWS) &&
+	    (CavRxSetOverflow(context, rx_overflow) != 0)) {
+		CavDbg(context, CAV_DBG_RX, "no memory for the RX backlog\n");
+	}
+
+	if (pPort->bulk_in_size == 0) {
+		CavDbg(context, CAV_DBG_RX,
+		       "no bulk-IN endpoint, read engine disabled\n");
+		return 0;
+	}
+
+	pipe = usb_rcvbulkpipe(pDev, pPort->bulk_in_endpointAddress);
+	pEndpoint = usb_pipe_endpoint(pDev, pipe);
+	maxPacket = 0;
+	if (pEndpoint != NULL) {
+		maxPacket = usb_endpoint_maxp(&pEndpoint->desc);
+	}
+	if (maxPacket == 0) {
+		maxPacket = 64;
+	}
+
+	urbCount = context->pProfile->RxUrbs ?: rx_urbs;
+	urbCount = clamp_t(uint, urbCount, 1, CAV_MAX_RX_URBS);
+	bufMps = context->pProfile->RxBufMps ?: rx_buf_mps;
+	context->RxBufSize =
+		maxPacket * clamp_t(uint, bufMps, 1, CAV_RX_BUF_MPS_MAX);
+
+	for (index = 0; index < urbCount; index++) {
+		struct urb *pURB;
+		unsigned char *pBuffer;
+
+		pURB = usb_alloc_urb(0, GFP_KERNEL);
+		if (pURB == NULL) {
+			goto alloc_failed;
+		}
+		pBuffer = kmalloc(context->RxBufSize, GFP_KERNEL);
+		if (pBuffer == NULL) {
+			usb_free_urb(pURB);
+			goto alloc_failed;
+		}
+		usb_fill_bulk_urb(pURB, pDev, pipe, pBuffer, context->RxBufSize,
+				  CavRxCallback, context);
+		pURB->transfer_flags |= URB_FREE_BUFFER;
+
+		context->RxUrb[index] = pURB;
+		context->RxUrbCount++;
+		set_bit(index, &context->RxUrbsFree);
+	}
+
+	CavDbg(context, CAV_DBG_RX, "%d bulk-IN URBs of %d bytes\n",
+	       context->RxUrbCount, context->RxBufSize);
+	return 0;
+
+alloc_failed:
+	CavRxFree(context);
+	return -ENOMEM;
+} // CavRxAlloc
+
+/*===========================================================================
+METHOD:
+   CavRxFree
+
+DESCRIPTION:
+   Release the bulk-IN URBs, the engine must be stopped
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRxFree(cav_device_context *context)
+{
+	int index;
+
+	for (index = 0; index < context->RxUrbCount; index++) {
+		usb_free_urb(context->RxUrb[index]);
+		context->RxUrb[index] = NULL;
+	}
+	context->RxUrbCount = 0;
+	context->RxUrbsFree = 0;
+	context->RxOverflow = CAV_RX_BACKPRESSURE;
+	kfifo_free(&context->RxFifo);
+} // CavRxFree
+
+/*===========================================================================
+METHOD:
+   CavRxSubmit
+
+DESCRIPTION:
+   Submit one idle bulk-IN URB
+
+PARAMETERS:
+   context:  [ I ] - private context for the serial device
+   index:    [ I ] - URB index
+   memFlags: [ I ] - allocation flags for usb_submit_urb
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success or if the URB is already in flight
+===========================================================================*/
+static int CavRxSubmit(cav_device_context *context, int index,
+		       gfp_t memFlags)
+{
+	int status;
+
+	if (test_and_clear_bit(index, &context->RxUrbsFree) == 0) {
+		return 0;
+	}
+
+	context->RxSubmitAt[index] = ktime_get();
+	status = usb_submit_urb(context->RxUrb[index], memFlags);
+	trace_cav_urb_submit(context->MyPort->minor, context->RxUrb[index],
+			     status);
+	if (status != 0) {
+		set_bit(index, &context->RxUrbsFree);
+		if (status != -EPERM && status != -ENODEV) {
+			CavDbg(context, CAV_DBG_RX,
+			       "failed submitting read urb %d, error %d\n",
+			       index, status);
+		}
+	}
+	return status;
+} // CavRxSubmit
+
+/*===========================================================================
+METHOD:
+   CavRxStart
+
+DESCRIPTION:
+   Put every idle bulk-IN URB in flight
+
+PARAMETERS:
+   context:  [ I ] - private context for the serial device
+   memFlags: [ I ] - allocation flags for usb_submit_urb
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavRxStart(cav_device_context *context, gfp_t memFlags)
+{
+	int index;
+	int status;
+
+	set_bit(CAV_RX_RUNNING, &context->RxFlags);
+	for (index = 0; index < context->RxUrbCount; index++) {
+		status = CavRxSubmit(context, index, memFlags);
+		if (status != 0) {
+			CavRxStop(context);
+			return status;
+		}
+	}
+	return 0;
+} // CavRxStart
+
+/*===========================================================================
+METHOD:
+   CavRxStop
+
+DESCRIPTION:
+   Kill every bulk-IN URB and keep them idle until CavRxStart
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRxStop(cav_device_context *context)
+{
+	int index;
+
+	clear_bit(CAV_RX_RUNNING, &context->RxFlags);
+	for (index = 0; index < context->RxUrbCount; index++) {
+		usb_kill_urb(context->RxUrb[index]);
+		set_bit(index, &context->RxUrbsFree);
+	}
+	hrtimer_cancel(&context->PushTimer);
+} // CavRxStop
+
+/*===========================================================================
+METHOD:
+   CavRxGet
+
+DESCRIPTION:
+   Add a user of the read engine, the first one starts it. Users are the
+   open tty and the open companion character devices. While the engine
+   runs the device may only autosuspend with remote wakeup enabled.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavRxGet(cav_device_context *context)
+{
+	struct usb_interface *pIntf = context->MySerial->interface;
+	int nRetval = 0;
+
+	mutex_lock(&context->OpenLock);
+	if (context->bDevRemoved != 0) {
+		nRetval = -ENODEV;
+	} else if (context->RxUsers++ == 0) {
+		nRetval = usb_autopm_get_interface(pIntf);
+		if (nRetval == 0) {
+			clear_bit(CAV_RX_THROTTLED, &context->RxFlags);
+			clear_bit(CAV_RX_TTY_THROTTLED, &context->RxFlags);
+			nRetval = CavRxStart(context, GFP_KERNEL);
+			pIntf->needs_remote_wakeup = (nRetval == 0);
+			usb_autopm_put_interface(pIntf);
+		}
+		if (nRetval != 0) {
+			context->RxUsers--;
+		} else {
+			CavRxWatch(context);
+		}
+	}
+	mutex_unlock(&context->OpenLock);
+
+	return nRetval;
+} // CavRxGet
+
+/*===========================================================================
+METHOD:
+   CavRxPut
+
+DESCRIPTION:
+   Drop a user of the read engine, the last one stops it
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRxPut(cav_device_context *context)
+{
+	unsigned long flags;
+
+	mutex_lock(&context->OpenLock);
+	if ((context->RxUsers > 0) && (--context->RxUsers == 0) &&
+	    (context->bDevRemoved == 0)) {
+		CavRxStop(context);
+		spin_lock_irqsave(&context->PushLock, flags);
+		if (context->RxOverflow == CAV_RX_DROP_OLDEST) {
+			kfifo_reset(&context->RxFifo);
+		}
+		spin_unlock_irqrestore(&context->PushLock, flags);
+		clear_bit(CAV_RX_SUSPENDED, &context->RxFlags);
+		context->MySerial->interface->needs_remote_wakeup = 0;
+	}
+	mutex_unlock(&context->OpenLock);
+} // CavRxPut
+
+/*===========================================================================
+METHOD:
+   CavRxFlush
+
+DESCRIPTION:
+   Hand the flip buffer data inserted so far to the line discipline and
+   wake up the reader. Called with PushLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRxFlush(cav_device_context *context)
+{
+	cav_push_stats *pStats = &context->PushStats[context->PushMode];
+
+	if (context->PushPending == 0) {
+		return;
+	}
+	tty_flip_buffer_push(&context->MyPort->port);
+	CavHistAdd(context, CAV_HIST_RX_PUSH, context->PushPendingSince,
+		   ktime_get());
+	pStats->Wakeups++;
+	pStats->Bytes += context->PushPending;
+	context->PushPending = 0;
+} // CavRxFlush
+
+/*===========================================================================
+METHOD:
+   CavRxPushTimer
+
+DESCRIPTION:
+   Push latency bound expired, flush what the policy held back
+
+PARAMETERS:
+   pTimer: [ I ] - PushTimer of the context
+
+RETURN VALUE:
+   HRTIMER_NORESTART
+===========================================================================*/
+static enum hrtimer_restart CavRxPushTimer(struct hrtimer *pTimer)
+{
+	cav_device_context *context =
+		container_of(pTimer, cav_device_context, PushTimer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&context->PushLock, flags);
+	CavRxFlush(context);
+	spin_unlock_irqrestore(&context->PushLock, flags);
+
+	return HRTIMER_NORESTART;
+} // CavRxPushTimer
+
+/*===========================================================================
+METHOD:
+   CavRxDropped
+
+DESCRIPTION:
+   Count data lost to the overflow policy, lines are counted by their
+   '\n' since GNSS sentences and AT responses end with one
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - data dropped
+   len:     [ I ] - number of bytes dropped
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRxDropped(cav_device_context *context,
+			 const unsigned char *pData, int len)
+{
+	const unsigned char *pEnd = pData + len;
+	int lines = 0;
+
+	while ((pData = memchr(pData, '\n', pEnd - pData)) != NULL) {
+		lines++;
+		pData++;
+	}
+	CavStatAdd(context, CAV_STAT_RX_DROPPED, len);
+	CavStatAdd(context, CAV_STAT_RX_DROPPED_LINES, lines);
+} // CavRxDropped
+
+/*===========================================================================
+METHOD:
+   CavRxFifoIn
+
+DESCRIPTION:
+   Append data to the drop-oldest backlog. Room is made by dropping the
+   oldest data up to the end of a line, so the reader resumes at the
+   start of a sentence. Called with PushLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - received data
+   len:     [ I ] - number of bytes received
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRxFifoIn(cav_device_context *context,
+			const unsigned char *pData, int len)
+{
+	unsigned int size = kfifo_size(&context->RxFifo);
+	unsigned int need, dropped = 0, count;
+	unsigned char chunk[64];
+	unsigned char *pEol;
+
+	if (len > size) {
+		CavRxDropped(context, pData, len - size);
+		pData += len - size;
+		len = size;
+	}
+
+	need = len - min_t(unsigned int, len, kfifo_avail(&context->RxFifo));
+	while ((need != 0) && (kfifo_is_empty(&context->RxFifo) == false)) {
+		count = kfifo_out_peek(&context->RxFifo, chunk, sizeof(chunk));
+		pEol = NULL;
+		if (dropped >= need) {
+			pEol = memchr(chunk, '\n', count);
+			if (pEol != NULL) {
+				count = pEol - chunk + 1;
+			}
+		} else {
+			count = min(count, need - dropped);
+		}
+		count = kfifo_out(&context->RxFifo, chunk, count);
+		CavRxDropped(context, chunk, count);
+		dropped += count;
+		if (pEol != NULL) {
+			break;
+		}
+	}
+
+	kfifo_in(&context->RxFifo, pData, len);
+} // CavRxFifoIn
+
+/*===========================================================================
+METHOD:
+   CavRxFifoDrain
+
+DESCRIPTION:
+   Move the drop-oldest backlog into the flip buffer. What does not fit
+   stays queued for the next drain. Called with PushLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   number of bytes inserted
+===========================================================================*/
+static int CavRxFifoDrain(cav_device_context *context)
+{
+	struct tty_port *pTTYPort = &context->MyPort->port;
+	unsigned char chunk[256];
+	int count, nCopied, nTotal = 0;
+
+	while (kfifo_is_empty(&context->RxFifo) == false) {
+		count = kfifo_out_peek(&context->RxFifo, chunk, sizeof(chunk));
+		nCopied = tty_insert_flip_string(pTTYPort, chunk, count);
+		// Consume what was inserted, kfifo_skip_count is 6.10+
+		kfifo_out(&context->RxFifo, chunk, nCopied);
+		nTotal += nCopied;
+		if (nCopied < count) {
+			CavStatInc(context, CAV_STAT_TTY_OVERRUNS);
+			break;
+		}
+	}
+	return nTotal;
+} // CavRxFifoDrain
+
+/*===========================================================================
+METHOD:
+   CavRxInsert
+
+DESCRIPTION:
+   Insert received data into the flip buffer according to the overflow
+   policy of the port. Called with PushLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - received data
+   len:     [ I ] - number of bytes received
+
+RETURN VALUE:
+   number of bytes inserted
+===========================================================================*/
+static int CavRxInsert(cav_device_context *context,
+		       const unsigned char *pData, int len)
+{
+	bool bThrottled =
+		(test_bit(CAV_RX_TTY_THROTTLED, &context->RxFlags) != 0);
+	int nCopied;
+
+	switch (context->RxOverflow) {
+	case CAV_RX_DROP_NEWEST:
+		if (bThrottled) {
+			CavRxDropped(context, pData, len);
+			return 0;
+		}
+		break;
+	case CAV_RX_DROP_OLDEST:
+		CavRxFifoIn(context, pData, len);
+		return bThrottled ? 0 : CavRxFifoDrain(context);
+	default:
+		break;
+	}
+
+	nCopied = tty_insert_flip_string(&context->MyPort->port, pData, len);
+	if (nCopied < len) {
+		CavDbg(context, CAV_DBG_RX,
+		       "tty buffer full, dropped %d bytes\n", len - nCopied);
+		CavStatInc(context, CAV_STAT_TTY_OVERRUNS);
+		CavStatAdd(context, CAV_STAT_TTY_DROPPED, len - nCopied);
+	}
+	return nCopied;
+} // CavRxInsert
+
+/*===========================================================================
+METHOD:
+   CavRxPush
+
+DESCRIPTION:
+   Insert received data into the TTY flip buffer and push it according to
+   the push policy of the port:
+      immediate - push every completion
+      batched   - push when PushLatencyUs expires or a batch is full
+      line      - push on '\n', PushLatencyUs bounds partial lines
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - received data
+   len:     [ I ] - number of bytes received
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRxPush(cav_device_context *context, const unsigned char *pData,
+		      int len)
+{
+	unsigned long flags;
+	int nCopied;
+	bool bPush;
+
+	if ((len == 0) || (context->bDevClosed != 0)) {
+		return;
+	}
+
+	// The flip buffer has a single producer, PushLock also serializes
+	// against CavRxPushTimer
+	spin_lock_irqsave(&context->PushLock, flags);
+	nCopied = CavRxInsert(context, pData, len);
+	if ((context->PushPending == 0) && (nCopied != 0)) {
+		context->PushPendingSince = READ_ONCE(context->RxCompleteAt);
+	}
+	context->PushPending += nCopied;
+
+	switch (context->PushMode) {
+	case CAV_PUSH_BATCHED:
+		bPush = (context->PushPending >= CAV_PUSH_BATCH_MAX);
+		break;
+	case CAV_PUSH_LINE:
+		bPush = (memchr(pData, '\n', len) != NULL) ||
+			(context->PushPending >= CAV_PUSH_BATCH_MAX);
+		break;
+	default:
+		bPush = true;
+		break;
+	}
+
+	if (bPush) {
+		CavRxFlush(context);
+	} else if ((context->PushPending != 0) &&
+		   (hrtimer_is_queued(&context->PushTimer) == false)) {
+		hrtimer_start(&context->PushTimer,
+			      us_to_ktime(context->PushLatencyUs),
+			      HRTIMER_MODE_REL);
+	}
+	spin_unlock_irqrestore(&context->PushLock, flags);
+} // CavRxPush
+
+/*===========================================================================
+METHOD:
+   CavRxDeliver
+
+DESCRIPTION:
+   Hand received data that is not a URC to the AT broker, the rest goes
+   to the TTY
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - received data
+   len:     [ I ] - number of bytes received
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRxDeliver(cav_device_context *context, const unsigned char *pData,
+		  int len)
+{
+	int taken;
+
+	if (len == 0) {
+		return;
+	}
+	// Responses to broker commands do not reach the TTY
+	taken = CavAtRx(context, pData, len);
+	CavRxPush(context, pData + taken, len - taken);
+} // CavRxDeliver
+
+/*===========================================================================
+METHOD:
+   CavRxSetPushMode
+
+DESCRIPTION:
+   Change the TTY push policy of a port, data held back by the previous
+   policy is pushed right away
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   mode:    [ I ] - CAV_PUSH_* policy
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRxSetPushMode(cav_device_context *context, int mode)
+{
+	unsigned long flags;
+	ktime_t now = ktime_get();
+
+	spin_lock_irqsave(&context->PushLock, flags);
+	CavRxFlush(context);
+	context->PushStats[context->PushMode].ActiveNs +=
+		ktime_to_ns(ktime_sub(now, context->PushModeSince));
+	context->PushModeSince = now;
+	context->PushMode = mode;
+	spin_unlock_irqrestore(&context->PushLock, flags);
+} // CavRxSetPushMode
+
+/*===========================================================================
+METHOD:
+   CavRxPushModeName
+
+DESCRIPTION:
+   Returns the name of a push policy
+
+PARAMETERS:
+   mode: [ I ] - CAV_PUSH_* policy, -1 returns NULL
+
+RETURN VALUE:
+   NULL-terminated policy name
+===========================================================================*/
+const char *CavRxPushModeName(int mode)
+{
+	if ((mode < 0) || (mode >= CAV_PUSH_MODES)) {
+		return NULL;
+	}
+	return CavPushModeNames[mode];
+} // CavRxPushModeName
+
+/*===========================================================================
+METHOD:
+   CavRxCallback
+
+DESCRIPTION:
+   Bulk-IN completion, push data to TTY and put the URB back in flight
+
+PARAMETERS:
+   pURB: [ I ] - completed URB
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRxCallback(struct urb *pURB)
+{
+	cav_device_context *context = (cav_device_context *)pURB->context;
+	ktime_t rxTime = ktime_get();
+	int status = pURB->status;
+	int index;
+
+	for (index = 0; index < context->RxUrbCount; index++) {
+		if (context->RxUrb[index] == pURB) {
+			break;
+		}
+	}
+	if (index == context->RxUrbCount) {
+		return;
+	}
+	trace_cav_urb_complete(context->MyPort->minor, pURB, status);
+	CavCapture(context, pURB, 'C', status, pURB->transfer_buffer,
+		   pURB->actual_length);
+
+	switch (status) {
+	case 0:
+		CavStatInc(context, CAV_STAT_RX_URBS);
+		CavStatAdd(context, CAV_STAT_RX_BYTES, pURB->actual_length);
+		CavHistAdd(context, CAV_HIST_RX_URB,
+			   context->RxSubmitAt[index], rxTime);
+		// Pending data is dated by the completion that brought it,
+		// see CavRxPush
+		WRITE_ONCE(context->RxCompleteAt, rxTime);
+		if (pURB->actual_length != 0) {
+			WRITE_ONCE(context->LastRxJiffies, jiffies | 1);
+			usb_mark_last_busy(context->MySerial->dev);
+		}
+		CavGnssRx(context, pURB->transfer_buffer, pURB->actual_length,
+			  rxTime);
+		if (CavUrcRx(context, pURB->transfer_buffer,
+			     pURB->actual_length) == false) {
+			CavRxDeliver(context, pURB->transfer_buffer,
+				     pURB->actual_length);
+		}
+		break;
+	case -ENOENT:
+	case -ECONNRESET:
+	case -ESHUTDOWN:
+		// Killed or device gone, stay idle until CavRxStart
+		set_bit(index, &context->RxUrbsFree);
+		return;
+	case -EPIPE:
+		CavDbg(context, CAV_DBG_RX, "bulk-IN endpoint stalled\n");
+		CavStatUrbError(context, status);
+		set_bit(index, &context->RxUrbsFree);
+		CavRecoverRequest(context, CAV_RECOVER_RX_HALT);
+		return;
+	default:
+		CavDbg(context, CAV_DBG_RX,
+		       "nonzero read bulk status received: %d\n", status);
+		CavStatUrbError(context, status);
+		break;
+	}
+
+	// The URB is idle again; throttle/stop may race with us, so
+	// publish the free bit before checking them
+	set_bit(index, &context->RxUrbsFree);
+	smp_mb__after_atomic();
+	if ((test_bit(CAV_RX_RUNNING, &context->RxFlags) == 0) ||
+	    (test_bit(CAV_RX_THROTTLED, &context->RxFlags) != 0)) {
+		return;
+	}
+	CavRxSubmit(context, index, GFP_ATOMIC);
+} // CavRxCallback
+
+/*===========================================================================
+METHOD:
+   CavRxOverflowName
+
+DESCRIPTION:
+   Returns the name of an RX overflow policy
+
+PARAMETERS:
+   policy: [ I ] - CAV_RX_* policy
+
+RETURN VALUE:
+   NULL-terminated policy name, NULL for an unknown policy
+===========================================================================*/
+const char *CavRxOverflowName(int policy)
+{
+	if ((policy < 0) || (policy >= CAV_RX_OVERFLOWS)) {
+		return NULL;
+	}
+	return CavRxOverflowNames[policy];
+} // CavRxOverflowName
+
+/*===========================================================================
+METHOD:
+   CavRxThrottle
+
+DESCRIPTION:
+   Idle the bulk-IN URBs while the line discipline is throttled, unless
+   the overflow policy drops data instead or the GNSS ring is read
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRxThrottle(cav_device_context *context)
+{
+	// A stalled tty reader must not starve the GNSS ring
+	if ((context->GnssRing != NULL) &&
+	    (READ_ONCE(context->GnssRing->Users) != 0)) {
+		return;
+	}
+	if (READ_ONCE(context->RxOverflow) != CAV_RX_BACKPRESSURE) {
+		return;
+	}
+	set_bit(CAV_RX_THROTTLED, &context->RxFlags);
+} // CavRxThrottle
+
+/*===========================================================================
+METHOD:
+   CavRxResume
+
+DESCRIPTION:
+   Put the bulk-IN URBs idled by CavRxThrottle back in flight
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRxResume(cav_device_context *context)
+{
+	int index;
+
+	clear_bit(CAV_RX_THROTTLED, &context->RxFlags);
+	smp_mb__after_atomic();
+	if (test_bit(CAV_RX_RUNNING, &context->RxFlags) == 0) {
+		return;
+	}
+	for (index = 0; index < context->RxUrbCount; index++) {
+		CavRxSubmit(context, index, GFP_KERNEL);
+	}
+} // CavRxResume
+
+/*===========================================================================
+METHOD:
+   CavRxSetOverflow
+
+DESCRIPTION:
+   Change the RX overflow policy of a port. The drop-oldest backlog is
+   allocated the first time the policy is selected, data it holds when
+   another policy is selected goes to the TTY.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   policy:  [ I ] - CAV_RX_* policy
+
+RETURN VALUE:
+   int - zero for success
+       - -ENOMEM if the backlog could not be allocated
+===========================================================================*/
+int CavRxSetOverflow(cav_device_context *context, int policy)
+{
+	unsigned long flags;
+	int nRetval = 0;
+
+	mutex_lock(&context->OpenLock);
+	if ((policy == CAV_RX_DROP_OLDEST) &&
+	    (kfifo_initialized(&context->RxFifo) == false)) {
+		nRetval = kfifo_alloc(&context->RxFifo,
+				      clamp_t(uint, rx_fifo_size, PAGE_SIZE,
+					      CAV_RX_FIFO_SIZE_MAX),
+				      GFP_KERNEL);
+	}
+	if (nRetval != 0) {
+		mutex_unlock(&context->OpenLock);
+		return nRetval;
+	}
+
+	spin_lock_irqsave(&context->PushLock, flags);
+	if (context->RxOverflow == CAV_RX_DROP_OLDEST) {
+		context->PushPending += CavRxFifoDrain(context);
+		CavRxFlush(context);
+		// No later drain takes what did not fit
+		CavStatAdd(context, CAV_STAT_TTY_DROPPED,
+			   kfifo_len(&context->RxFifo));
+		kfifo_reset(&context->RxFifo);
+	}
+	WRITE_ONCE(context->RxOverflow, policy);
+	spin_unlock_irqrestore(&context->PushLock, flags);
+
+	if (policy != CAV_RX_BACKPRESSURE) {
+		if (test_bit(CAV_RX_THROTTLED, &context->RxFlags) != 0) {
+			CavRxResume(context);
+		}
+	} else if (test_bit(CAV_RX_TTY_THROTTLED, &context->RxFlags) != 0) {
+		CavRxThrottle(context);
+	}
+	mutex_unlock(&context->OpenLock);
+	return 0;
+} // CavRxSetOverflow
+
+/*===========================================================================
+METHOD:
+   CavThrottle
+
+DESCRIPTION:
+   The line discipline is full, apply the overflow policy until
+   CavUnthrottle
+
+PARAMETERS:
+   tty: [ I ] - TTY structure associated with the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavThrottle(struct tty_struct *tty)
+{
+	struct usb_serial_port *pPort = tty->driver_data;
+	cav_device_context *context = usb_get_serial_data(pPort->serial);
+
+	set_bit(CAV_RX_TTY_THROTTLED, &context->RxFlags);
+	CavRxThrottle(context);
+} // CavThrottle
+
+/*===========================================================================
+METHOD:
+   CavUnthrottle
+
+DESCRIPTION:
+   The line discipline has room again, hand it the drop-oldest backlog
+   and put idled bulk-IN URBs back in flight
+
+PARAMETERS:
+   tty: [ I ] - TTY structure associated with the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavUnthrottle(struct tty_struct *tty)
+{
+	struct usb_serial_port *pPort = tty->driver_data;
+	cav_device_context *context = usb_get_serial_data(pPort->serial);
+	unsigned long flags;
+
+	spin_lock_irqsave(&context->PushLock, flags);
+	clear_bit(CAV_RX_TTY_THROTTLED, &context->RxFlags);
+	if (context->RxOverflow == CAV_RX_DROP_OLDEST) {
+		context->PushPending += CavRxFifoDrain(context);
+		CavRxFlush(context);
+	}
+	spin_unlock_irqrestore(&context->PushLock, flags);
+
+	CavRxResume(context);
+} // CavUnthrottle
+
+module_param(rx_urbs, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_urbs, "Bulk-IN URBs kept in flight per port");
+module_param(rx_buf_mps, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_buf_mps,
+		 "Bulk-IN URB buffer size in multiples of wMaxPacketSize");
+module_param(push_mode, uint, S_IRUGO);
+MODULE_PARM_DESC(push_mode,
+		 "Initial TTY push policy: 0 immediate, 1 batched, 2 line");
+module_param(push_latency_us, uint, S_IRUGO);
+MODULE_PARM_DESC(push_latency_us,
+		 "Initial push latency bound in microseconds");
+module_param(rx_overflow, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_overflow, "Initial RX overflow policy: "
+			      "0 backpressure, 1 drop-newest, 2 drop-oldest");
+module_param(rx_fifo_size, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_fifo_size, "Drop-oldest backlog size in bytes");
@@ -0,0 +1,322 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/workqueue.h>
+#include "CavQMSerial.h"
+
+// RX watchdog of new ports in ms, 0 disables it
+static uint rx_watchdog_ms;
+
+/*===========================================================================
+METHOD:
+   CavRecoverRequest
+
+DESCRIPTION:
+   Ask the recovery worker of a port to handle a fault, safe from any
+   context. Requests made while the worker is pending are merged.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   request: [ I ] - CAV_RECOVER_* bit
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRecoverRequest(cav_device_context *context, int request)
+{
+	if (context->bDevRemoved != 0) {
+		return;
+	}
+	if (test_and_set_bit(request, &context->RecoverFlags) != 0) {
+		return;
+	}
+	// The oldest pending fault starts the recovery, racing requests only
+	// skew its duration
+	if (context->RecoverSince == 0) {
+		context->RecoverSince = ktime_get();
+	}
+	schedule_work(&context->RecoverWork);
+} // CavRecoverRequest
+
+/*===========================================================================
+METHOD:
+   CavRecoverRx
+
+DESCRIPTION:
+   Kill the bulk-IN URBs, clear the endpoint halt and put the URBs back in
+   flight while the read engine has users. A throttled engine is left to
+   CavRxResume. Called with OpenLock held and the device resumed.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+static int CavRecoverRx(cav_device_context *context)
+{
+	int nRetval;
+
+	if (context->RxUrbCount == 0) {
+		return 0;
+	}
+	CavRxStop(context);
+	nRetval = usb_clear_halt(context->MySerial->dev,
+				 context->RxUrb[0]->pipe);
+	CavDbg(context, CAV_DBG_RX, "<%s> usb_clear_halt IN returned %d\n",
+	       CavPort(context, NULL), nRetval);
+	if ((nRetval != 0) || (context->RxUsers == 0)) {
+		return nRetval;
+	}
+
+	// CavRxResume may run meanwhile, submitting twice is harmless
+	set_bit(CAV_RX_RUNNING, &context->RxFlags);
+	smp_mb__after_atomic();
+	if (test_bit(CAV_RX_THROTTLED, &context->RxFlags) != 0) {
+		return 0;
+	}
+	return CavRxStart(context, GFP_KERNEL);
+} // CavRecoverRx
+
+/*===========================================================================
+METHOD:
+   CavRecoverWork
+
+DESCRIPTION:
+   Recovery worker of a port. Stalled bulk endpoints get their halt
+   cleared and their engine restarted, an expired RX watchdog restarts the
+   read engine or, when that did not help, queues a USB reset of the
+   device. The reset unbinds and probes every interface again, so the
+   port starts over with new statistics.
+
+PARAMETERS:
+   pWork: [ I ] - RecoverWork of the context
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRecoverWork(struct work_struct *pWork)
+{
+	cav_device_context *context =
+		container_of(pWork, cav_device_context, RecoverWork);
+	struct usb_interface *pIntf = context->MySerial->interface;
+	ktime_t since = context->RecoverSince;
+	unsigned long requests;
+	unsigned int latency;
+	int nRetval, status;
+
+	context->RecoverSince = 0;
+	requests = xchg(&context->RecoverFlags, 0);
+	if (requests == 0) {
+		return;
+	}
+	if ((requests & BIT(CAV_RECOVER_RESET)) != 0) {
+		dev_warn(&context->MyPort->dev,
+			 "no data for %u ms after a restart, resetting device\n",
+			 READ_ONCE(context->RxWatchdogMs));
+		CavStatInc(context, CAV_STAT_RECOVER_RESETS);
+		usb_queue_reset_device(pIntf);
+		return;
+	}
+
+	mutex_lock(&context->OpenLock);
+	if (context->bDevRemoved != 0) {
+		mutex_unlock(&context->OpenLock);
+		return;
+	}
+	nRetval = usb_autopm_get_interface(pIntf);
+	if (nRetval == 0) {
+		if ((requests & (BIT(CAV_RECOVER_RX_HALT) |
+				 BIT(CAV_RECOVER_RX_RESTART))) != 0) {
+			nRetval = CavRecoverRx(context);
+		}
+		if ((requests & BIT(CAV_RECOVER_TX_HALT)) != 0) {
+			status = usb_clear_halt(context->MySerial->dev,
+						context->TxUrb[0]->pipe);
+			CavDbg(context, CAV_DBG_TX,
+			       "<%s> usb_clear_halt OUT returned %d\n",
+			       CavPort(context, NULL), status);
+			if (status == 0) {
+				CavTxKick(context);
+			} else if (nRetval == 0) {
+				nRetval = status;
+			}
+		}
+		usb_autopm_put_interface(pIntf);
+	}
+	mutex_unlock(&context->OpenLock);
+
+	if ((requests & (BIT(CAV_RECOVER_RX_HALT) |
+			 BIT(CAV_RECOVER_TX_HALT))) != 0) {
+		CavStatInc(context, CAV_STAT_RECOVER_HALTS);
+	}
+	if ((nRetval != 0) && (nRetval != -ENODEV)) {
+		CavStatInc(context, CAV_STAT_RECOVER_FAILED);
+		dev_warn(&context->MyPort->dev, "recovery failed, error %d\n",
+			 nRetval);
+	}
+
+	latency = ktime_us_delta(ktime_get(), since);
+	CavStatAdd(context, CAV_STAT_RECOVER_US, latency);
+	WRITE_ONCE(context->RecoverLatencyUs, latency);
+	if (latency > context->RecoverLatencyMaxUs) {
+		WRITE_ONCE(context->RecoverLatencyMaxUs, latency);
+	}
+	CavDbg(context, CAV_DBG_PROBE,
+	       "<%s> recovered 0x%lx in %u us, error %d\n",
+	       CavPort(context, NULL), requests, latency, nRetval);
+} // CavRecoverWork
+
+/*===========================================================================
+METHOD:
+   CavRxWatchdogWork
+
+DESCRIPTION:
+   RX watchdog, runs when the read engine may have been silent for
+   RxWatchdogMs. The first expiry restarts the read engine, a second one
+   without data in between resets the device. Silence while the device
+   is suspended does not count.
+
+PARAMETERS:
+   pWork: [ I ] - RxWatchdogWork of the context
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavRxWatchdogWork(struct work_struct *pWork)
+{
+	cav_device_context *context = container_of(
+		to_delayed_work(pWork), cav_device_context, RxWatchdogWork);
+	unsigned int limitMs = READ_ONCE(context->RxWatchdogMs);
+	unsigned long last = READ_ONCE(context->LastRxJiffies);
+	unsigned int silentMs;
+
+	if ((limitMs == 0) || (READ_ONCE(context->RxUsers) == 0) ||
+	    (context->bDevRemoved != 0)) {
+		return;
+	}
+	if ((last != 0) && time_after(last, context->RxWatchSince)) {
+		context->RxWatchSince = last;
+		context->bRxRestarted = false;
+	}
+	if (READ_ONCE(context->bSuspended) != 0) {
+		context->RxWatchSince = jiffies;
+	}
+
+	silentMs = jiffies_to_msecs(jiffies - context->RxWatchSince);
+	if (silentMs >= limitMs) {
+		CavStatInc(context, CAV_STAT_RECOVER_WATCHDOG);
+		CavRecoverRequest(context, context->bRxRestarted ?
+						   CAV_RECOVER_RESET :
+						   CAV_RECOVER_RX_RESTART);
+		context->bRxRestarted = true;
+		context->RxWatchSince = jiffies;
+		silentMs = 0;
+	}
+	schedule_delayed_work(&context->RxWatchdogWork,
+			      msecs_to_jiffies(limitMs - silentMs));
+} // CavRxWatchdogWork
+
+/*===========================================================================
+METHOD:
+   CavRecoverInit
+
+DESCRIPTION:
+   Set up the recovery worker and RX watchdog of a new context
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRecoverInit(cav_device_context *context)
+{
+	INIT_WORK(&context->RecoverWork, CavRecoverWork);
+	INIT_DELAYED_WORK(&context->RxWatchdogWork, CavRxWatchdogWork);
+	context->RxWatchdogMs = min_t(uint, rx_watchdog_ms,
+				      CAV_RX_WATCHDOG_MS_MAX);
+} // CavRecoverInit
+CAV_KUNIT_EXPORT(CavRecoverInit);
+
+/*===========================================================================
+METHOD:
+   CavRxWatch
+
+DESCRIPTION:
+   Start watching the read engine, silence is counted from now. Called
+   with OpenLock held when the engine gets its first user or the
+   watchdog period changes.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRxWatch(cav_device_context *context)
+{
+	unsigned int limitMs = READ_ONCE(context->RxWatchdogMs);
+
+	context->RxWatchSince = jiffies;
+	context->bRxRestarted = false;
+	if ((limitMs != 0) && (context->RxUsers != 0) &&
+	    (context->bDevRemoved == 0)) {
+		mod_delayed_work(system_wq, &context->RxWatchdogWork,
+				 msecs_to_jiffies(limitMs));
+	}
+} // CavRxWatch
+
+/*===========================================================================
+METHOD:
+   CavRxSetWatchdog
+
+DESCRIPTION:
+   Change the RX watchdog period of a port
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   ms:      [ I ] - silence tolerated in ms, 0 disables the watchdog
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRxSetWatchdog(cav_device_context *context, unsigned int ms)
+{
+	mutex_lock(&context->OpenLock);
+	WRITE_ONCE(context->RxWatchdogMs, ms);
+	CavRxWatch(context);
+	mutex_unlock(&context->OpenLock);
+} // CavRxSetWatchdog
+
+/*===========================================================================
+METHOD:
+   CavRecoverStop
+
+DESCRIPTION:
+   Stop the RX watchdog and wait for the recovery worker, called after
+   bDevRemoved is set and the URBs are killed
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavRecoverStop(cav_device_context *context)
+{
+	cancel_delayed_work_sync(&context->RxWatchdogWork);
+	cancel_work_sync(&context->RecoverWork);
+} // CavRecoverStop
+
+module_param(rx_watchdog_ms, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_watchdog_ms,
+		 "RX watchdog of new ports in ms, 0 disables");
@@ -0,0 +1,169 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/string_helpers.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include "CavQMSerial.h"
+
+// Initial scripts of new ports by role and event, C escapes allowed
+static char *CavScriptParam[CAV_ROLES][CAV_SCRIPT_EVENTS] = {
+#ifdef GPS_AUTO_START
+	[CAV_ROLE_GNSS] = {
+		[CAV_SCRIPT_OPEN] = "$GPS_START",
+		[CAV_SCRIPT_CLOSE] = "$GPS_STOP",
+	},
+#endif
+};
+
+static const char *const CavScriptNames[CAV_SCRIPT_EVENTS] = {
+	[CAV_SCRIPT_ATTACH] = "attach",
+	[CAV_SCRIPT_OPEN] = "open",
+	[CAV_SCRIPT_CLOSE] = "close",
+};
+
+/*===========================================================================
+METHOD:
+   CavScriptInit
+
+DESCRIPTION:
+   Load the scripts of the port from the module parameters of its role
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavScriptInit(cav_device_context *context)
+{
+	int role = context->pProfile->Role;
+	int event;
+
+	mutex_init(&context->ScriptLock);
+	for (event = 0; event < CAV_SCRIPT_EVENTS; event++) {
+		if (CavScriptParam[role][event] != NULL) {
+			strscpy(context->Script[event],
+				CavScriptParam[role][event], CAV_SCRIPT_MAX);
+		}
+	}
+} // CavScriptInit
+CAV_KUNIT_EXPORT(CavScriptInit);
+
+/*===========================================================================
+METHOD:
+   CavScriptSet
+
+DESCRIPTION:
+   Replace the script run on an event, a trailing newline is dropped so
+   echo can be used. An empty script disables the event.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   event:   [ I ] - CAV_SCRIPT_*
+   buf:     [ I ] - script text, C escapes are decoded when it runs
+   count:   [ I ] - length of buf
+
+RETURN VALUE:
+   int - zero for success
+       - -EINVAL if the script is too long
+===========================================================================*/
+int CavScriptSet(cav_device_context *context, int event, const char *buf,
+		 size_t count)
+{
+	if ((count > 0) && (buf[count - 1] == '\n')) {
+		count--;
+	}
+	if (count >= CAV_SCRIPT_MAX) {
+		return -EINVAL;
+	}
+
+	mutex_lock(&context->ScriptLock);
+	memcpy(context->Script[event], buf, count);
+	context->Script[event][count] = 0;
+	mutex_unlock(&context->ScriptLock);
+	return 0;
+} // CavScriptSet
+
+/*===========================================================================
+METHOD:
+   CavScriptShow
+
+DESCRIPTION:
+   Copy the script run on an event, as written
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   event:   [ I ] - CAV_SCRIPT_*
+   buf:     [ O ] - PAGE_SIZE sysfs buffer
+
+RETURN VALUE:
+   number of bytes written to buf
+===========================================================================*/
+ssize_t CavScriptShow(cav_device_context *context, int event, char *buf)
+{
+	ssize_t len;
+
+	mutex_lock(&context->ScriptLock);
+	len = sprintf(buf, "%s\n", context->Script[event]);
+	mutex_unlock(&context->ScriptLock);
+	return len;
+} // CavScriptShow
+
+/*===========================================================================
+METHOD:
+   CavScriptRun
+
+DESCRIPTION:
+   Queue the script of an event on the write engine. The caller does not
+   wait for the device, the data goes out with the next idle bulk-OUT
+   URB. Not called from atomic context.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   event:   [ I ] - CAV_SCRIPT_*
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavScriptRun(cav_device_context *context, int event)
+{
+	char script[CAV_SCRIPT_MAX];
+	int len, queued;
+
+	mutex_lock(&context->ScriptLock);
+	len = string_unescape_any(context->Script[event], script,
+				  CAV_SCRIPT_MAX);
+	mutex_unlock(&context->ScriptLock);
+
+	if (len == 0) {
+		return;
+	}
+	if (context->TxUrbCount == 0) {
+		CavDbg(context, CAV_DBG_TX, "<%s> %s script needs tx_urbs\n",
+		       CavPort(context, NULL), CavScriptNames[event]);
+		return;
+	}
+
+	queued = CavTxQueue(context, (const unsigned char *)script, len);
+	CavDbg(context, CAV_DBG_TX, "<%s> %s script queued %d of %d bytes\n",
+	       CavPort(context, NULL), CavScriptNames[event], queued, len);
+	CavTxKick(context);
+} // CavScriptRun
+
+#define CAV_SCRIPT_PARAM(_name_, _role_, _event_)                      \
+	module_param_named(_name_, CavScriptParam[_role_][_event_], charp, \
+			   S_IRUGO);                                          \
+	MODULE_PARM_DESC(_name_, "Initial " #_name_ " of new ports")
+
+CAV_SCRIPT_PARAM(at_attach_script, CAV_ROLE_AT, CAV_SCRIPT_ATTACH);
+CAV_SCRIPT_PARAM(at_open_script, CAV_ROLE_AT, CAV_SCRIPT_OPEN);
+CAV_SCRIPT_PARAM(at_close_script, CAV_ROLE_AT, CAV_SCRIPT_CLOSE);
+CAV_SCRIPT_PARAM(gnss_attach_script, CAV_ROLE_GNSS, CAV_SCRIPT_ATTACH);
+CAV_SCRIPT_PARAM(gnss_open_script, CAV_ROLE_GNSS, CAV_SCRIPT_OPEN);
+CAV_SCRIPT_PARAM(gnss_close_script, CAV_ROLE_GNSS, CAV_SCRIPT_CLOSE);
@@ -6,27 +6,34 @@
 #include <linux/tty_flip.h>
 #include <linux/usb.h>
 #include <linux/usb/serial.h>
+#include <linux/kfifo.h>
 #include <linux/version.h>
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 2, 0))
 #include <linux/module.h>
 #endif
 #include "version.h"
 #include "CavQMSerial.h"
+#include "CavQMTrace.h"
 
-#define C10QM_VID 0x05C6
-#define C10QM_PID 0x9025
-#define C10QM_AT_INTF_NUM 2
-#define C10QM_GNSS_INTF_NUM 3
+// Interrupt endpoint polling interval while notifications arrive, and
+// the ceiling it backs off to while they are rare
+static uint int_interval_ms = CAV_INT_INTERVAL_MS_DEFAULT;
+static uint int_idle_interval_ms = CAV_INT_IDLE_INTERVAL_MS_DEFAULT;
 
-// Debug flag
-static ulong debug;
+// Defer the endpoint handshake of probe to a work item
+static bool async_probe;
 
-static const struct usb_device_id CavConfigVIDPIDTable[] = {
-	{ .driver_info = 0xffff },
-	// Terminating entry
-	{}
-};
-MODULE_DEVICE_TABLE(usb, CavConfigVIDPIDTable);
+static void CavIntRetryWork(struct work_struct *pWork);
+static void CavInitWork(struct work_struct *pWork);
+
+// Attach to correct interfaces
+static int CavProbe(struct usb_serial *pSerial,
+		     const struct usb_device_id *pID);
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 25))
+// Read data from USB, push to TTY and user space
+static void CavReadBulkCallback(struct urb *pURB);
+#endif
 
 /*=========================================================================*/
 // Struct usb_serial_driver
@@ -64,9 +71,28 @@ static struct usb_serial_driver gCavDevice = {
 	.num_ports = 1,
 	.probe = CavProbe,
 	.open = CavOpen,
+	.close = CavClose,
+	.write = CavWrite,
 	.attach = CavAttach,
 	.disconnect = CavDisconnect,
 	.release = CavRelease,
+	.port_probe = CavPortProbe,
+	.port_remove = CavPortRemove,
+	.write_room = CavWriteRoom,
+	.chars_in_buffer = CavCharsInBuffer,
+	.throttle = CavThrottle,
+	.unthrottle = CavUnthrottle,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 5, 0))
+	.suspend = CavPmSuspend,
+	.resume = CavPmResume,
+	.reset_resume = CavPmResetResume,
+#endif
+	.tiocmget = CavTiocmGet,
+	.tiocmset = CavTiocmSet,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0))
+	.tiocmiwait = usb_serial_generic_tiocmiwait,
+	.get_icount = usb_serial_generic_get_icount,
+#endif
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 25))
 	.num_interrupt_in = NUM_DONT_CARE,
 	.num_bulk_in = 1,
@@ -113,9 +139,10 @@ char *CavPort(cav_device_context *context, struct usb_serial_port *pPort)
 
 	return id;
 } // CavPort
+CAV_KUNIT_EXPORT(CavPort);
 
-void PrintHex(void *Context, const unsigned char *pBuffer, int BufferSize,
-	      char *Tag)
+int PrintHex(void *Context, const unsigned char *pBuffer, int BufferSize,
+	     char *Tag)
 {
 	char pPrintBuf[896];
 	int pos, bufSize;
@@ -125,27 +152,39 @@ void PrintHex(void *Context, const unsigned char *pBuffer, int BufferSize,
 	if (Context != NULL) {
 		context = (cav_device_context *)Context;
 	}
+	if (!CavDbgOn(context, CAV_DBG_DATA)) {
+		return 0;
+	}
 
-	memset(pPrintBuf, 0, 896);
+	memset(pPrintBuf, 0, sizeof(pPrintBuf));
 
-	if (BufferSize < 896) {
+	// Three characters per byte and the terminating NUL
+	if (BufferSize < 0) {
+		bufSize = 0;
+	} else if (BufferSize <= (int)(sizeof(pPrintBuf) - 1) / 3) {
 		bufSize = BufferSize;
 	} else {
-		bufSize = 890;
+		bufSize = (sizeof(pPrintBuf) - 1) / 3;
 	}
-	CavDBG(context, "=== %s data %d/%d Bytes ===\n", Tag, bufSize,
-		BufferSize);
+	CavDbg(context, CAV_DBG_DATA, "=== %s data %d/%d Bytes ===\n", Tag,
+	       bufSize, BufferSize);
 	for (pos = 0; pos < bufSize; pos++) {
 		status = snprintf((pPrintBuf + (pos * 3)), 4, "%02X ",
 				  *(u8 *)(pBuffer + pos));
 		if (status != 3) {
-			CavDBG(context, "snprintf error %d\n", status);
-			return;
+			CavDbg(context, CAV_DBG_DATA, "snprintf error %d\n",
+			       status);
+			return 0;
 		}
 	}
-	CavDBG(context, "   : %s\n", pPrintBuf);
-	return;
+	CavDbg(context, CAV_DBG_DATA, "   : %s\n", pPrintBuf);
+	// The dump is a NUL-terminated "XX " per byte
+	if ((int)strlen(pPrintBuf) != bufSize * 3) {
+		return 0;
+	}
+	return bufSize;
 }
+CAV_KUNIT_EXPORT(PrintHex);
 
 /*===========================================================================
 METHOD:
@@ -159,54 +198,177 @@ PARAMETERS:
    DtrRts:  [ I ] - DTR/RTS bits
 
 RETURN VALUE:
-   none
+   int - zero for success
+       - negative errno on error
 ===========================================================================*/
-void CavSetDtrRts(cav_device_context *context, __u16 DtrRts)
+int CavSetDtrRts(cav_device_context *context, __u16 DtrRts)
 {
 	int dtrResult;
 
-	if (context->bInterruptPresent == 0) {
-		return;
+	WRITE_ONCE(context->LineCtrl, DtrRts);
+	if ((context->bInterruptPresent == 0) ||
+	    ((context->pProfile->Quirks & CAV_QUIRK_NO_CTRL_LINES) != 0)) {
+		return 0;
 	}
 
-	CavDBG(context, "--> 0x%x\n", DtrRts);
 	dtrResult = usb_control_msg(context->MySerial->dev,
 				    usb_sndctrlpipe(context->MySerial->dev, 0),
 				    0x22, 0x21, DtrRts,
 				    context->InterfaceNumber, NULL, 0, 100);
-	CAV_DBG(context, ("<%s> <-- Set DTR/RTS 0x%x\n",
-			   CavPort(context, NULL), DtrRts));
+	trace_cav_dtr_rts(context->MyPort->minor, DtrRts, dtrResult);
+	return (dtrResult < 0) ? dtrResult : 0;
 } // CavSetDtrRts
 
-//---------------------------------------------------------------------------
-// USB serial core overridding Methods
-//---------------------------------------------------------------------------
+/*===========================================================================
+METHOD:
+   CavEpInit
+
+DESCRIPTION:
+   Select the interface and clear the halt of every endpoint. Clearing
+   endpoint halt is a magic handshake that brings the device out of low
+   power (airplane) mode.
+
+PARAMETERS:
+   pSerial: [ I ] - serial structure
 
-static int CavCheckIntf(struct usb_interface *pIface)
+RETURN VALUE:
+   int - zero for success
+       - negative errno of the last failed request
+===========================================================================*/
+static int CavEpInit(struct usb_serial *pSerial)
 {
-	struct usb_device *dev;
-	unsigned int intfNum = 0;
+	struct usb_host_interface *pAlt = pSerial->interface->cur_altsetting;
+	struct usb_host_endpoint *pEndpoint;
+	int endpointIndex;
+	int nRetval;
+	int pipe;
+
+	nRetval = usb_set_interface(pSerial->dev,
+				    pAlt->desc.bInterfaceNumber, 0);
+	if (nRetval < 0) {
+		CavDbg(NULL, CAV_DBG_PROBE,
+		       "Could not set interface, error %d\n", nRetval);
+		return nRetval;
+	}
 
-	dev = interface_to_usbdev(pIface);
-	if (!pIface || !dev) {
-		DBG("Invalid usb device data\n");
-		return -EINVAL;
+	// NOTE: FCC verification should be done before this, if required
+	pAlt = pSerial->interface->cur_altsetting;
+	for (endpointIndex = 0; endpointIndex < pAlt->desc.bNumEndpoints;
+	     endpointIndex++) {
+		pEndpoint = pAlt->endpoint + endpointIndex;
+
+		CavDbg(NULL, CAV_DBG_PROBE, "Examining EP 0x%x\n",
+		       pEndpoint->desc.bEndpointAddress);
+		if (usb_endpoint_dir_out(&pEndpoint->desc) == true) {
+			pipe = usb_sndbulkpipe(
+				pSerial->dev,
+				pEndpoint->desc.bEndpointAddress);
+			nRetval = usb_clear_halt(pSerial->dev, pipe);
+			CavDbg(NULL, CAV_DBG_PROBE,
+			       "usb_clear_halt OUT returned %d\n", nRetval);
+		} else if (usb_endpoint_xfer_int(&pEndpoint->desc) == true) {
+			pipe = usb_rcvintpipe(
+				pSerial->dev,
+				pEndpoint->desc.bEndpointAddress &
+					USB_ENDPOINT_NUMBER_MASK);
+			nRetval = usb_clear_halt(pSerial->dev, pipe);
+			CavDbg(NULL, CAV_DBG_PROBE,
+			       "usb_clear_halt INT returned %d\n", nRetval);
+		} else {
+			pipe = usb_rcvbulkpipe(
+				pSerial->dev,
+				pEndpoint->desc.bEndpointAddress &
+					USB_ENDPOINT_NUMBER_MASK);
+			nRetval = usb_clear_halt(pSerial->dev, pipe);
+			CavDbg(NULL, CAV_DBG_PROBE,
+			       "usb_clear_halt IN returned %d\n", nRetval);
+		}
 	}
+	return nRetval;
+} // CavEpInit
 
-	DBG("VID: %X,  PID: %X, InterfaceNumber: %X\n", dev->descriptor.idVendor,
-		dev->descriptor.idProduct,
-		pIface->cur_altsetting->desc.bInterfaceNumber);
+/*===========================================================================
+METHOD:
+   CavInitComplete
 
-	intfNum = pIface->cur_altsetting->desc.bInterfaceNumber;
-	if ((dev->descriptor.idVendor != C10QM_VID)
-			|| (dev->descriptor.idProduct != C10QM_PID)
-			|| ((intfNum != C10QM_AT_INTF_NUM) && (intfNum != C10QM_GNSS_INTF_NUM))
-		) {
-		DBG("Not C10QM AT/GNSS serial interface\n");
-		return -EINVAL;
+DESCRIPTION:
+   Record the outcome of the endpoint handshake and the probe-to-ready
+   time, and release the opens waiting in CavWaitReady
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   status:  [ I ] - result of CavEpInit
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavInitComplete(cav_device_context *context, int status)
+{
+	context->InitStatus = status;
+	context->ReadyUs = ktime_us_delta(ktime_get(), context->ProbeAt);
+	complete_all(&context->InitDone);
+	CavDbg(context, CAV_DBG_PROBE, "intf %d ready in %u us, status %d\n",
+	       context->InterfaceNumber, context->ReadyUs, status);
+} // CavInitComplete
+
+/*===========================================================================
+METHOD:
+   CavInitWork
+
+DESCRIPTION:
+   Run the endpoint handshake of an asynchronous probe. The interface is
+   kept resumed for the control requests.
+
+PARAMETERS:
+   pWork: [ I ] - InitWork of the context
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavInitWork(struct work_struct *pWork)
+{
+	cav_device_context *context =
+		container_of(pWork, cav_device_context, InitWork);
+	struct usb_interface *pIntf = context->MySerial->interface;
+	int nRetval;
+
+	nRetval = usb_autopm_get_interface(pIntf);
+	if (nRetval == 0) {
+		nRetval = CavEpInit(context->MySerial);
+		usb_autopm_put_interface(pIntf);
 	}
-	return 0;
-}
+	CavInitComplete(context, nRetval);
+	if (nRetval == 0) {
+		CavScriptRun(context, CAV_SCRIPT_ATTACH);
+	}
+} // CavInitWork
+
+/*===========================================================================
+METHOD:
+   CavWaitReady
+
+DESCRIPTION:
+   Wait for the endpoint handshake of an asynchronous probe to finish
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   int - zero for success
+       - -ERESTARTSYS if interrupted
+       - negative errno of the handshake
+===========================================================================*/
+int CavWaitReady(cav_device_context *context)
+{
+	if (wait_for_completion_interruptible(&context->InitDone) != 0) {
+		return -ERESTARTSYS;
+	}
+	return context->InitStatus;
+} // CavWaitReady
+
+//---------------------------------------------------------------------------
+// USB serial core overridding Methods
+//---------------------------------------------------------------------------
 
 /*===========================================================================
 METHOD:
@@ -231,112 +393,70 @@ static int CavProbe(struct usb_serial *pSerial,
 	int nNumInterfaces;
 	int nInterfaceNum;
 	void *context = usb_get_serial_data(pSerial);
-	int interruptOk = 0, pipe = 0, intPipe = 0;
-
-	if (CavCheckIntf(pSerial->interface) != 0) {
-		DBG("CavCheckIntf failed\n");
-		return -EINVAL;
+	int interruptOk = 0, intPipe = 0;
+	const cav_intf_profile *pProfile;
+	const cav_sku *pSku;
+	struct usb_host_endpoint *pEndpoint;
+	int endpointIndex, numEndpoints;
+	ktime_t probeAt = ktime_get();
+
+	// Dynamic IDs match every interface, keep the ones with a role
+	pProfile = CavProfileLookup(pSerial->interface, pID, &pSku);
+	if (pProfile == NULL) {
+		CavDbg(NULL, CAV_DBG_PROBE, "No role in the %s profile\n",
+		       pSku->Name);
+		return -ENODEV;
 	}
 
-	DBG("-->CavProbe\n");
+	CavDbg(NULL, CAV_DBG_PROBE, "-->CavProbe\n");
 
 	// Test parameters
 	if ((pSerial == NULL) || (pSerial->dev == NULL) ||
 	    (pSerial->dev->actconfig == NULL) || (pSerial->interface == NULL) ||
 	    (pSerial->interface->cur_altsetting == NULL) ||
 	    (pSerial->type == NULL)) {
-		DBG("<--CavProbe: invalid parameter\n");
+		CavDbg(NULL, CAV_DBG_PROBE, "<--CavProbe: invalid parameter\n");
 		return -EINVAL;
 	}
 
 	nNumInterfaces = pSerial->dev->actconfig->desc.bNumInterfaces;
 	nInterfaceNum =
 		pSerial->interface->cur_altsetting->desc.bInterfaceNumber;
-	DBG("Obj / Ctxt = 0x%p / 0x%p\n", pSerial, context);
-	DBG("Num Interfaces = %d\n", nNumInterfaces);
-	DBG("This Interface = %d\n", nInterfaceNum);
-	DBG("Serial private = 0x%p\n", pSerial->private);
+	CavDbg(NULL, CAV_DBG_PROBE, "Obj / Ctxt = 0x%p / 0x%p\n", pSerial,
+	       context);
+	CavDbg(NULL, CAV_DBG_PROBE, "Num Interfaces = %d\n", nNumInterfaces);
+	CavDbg(NULL, CAV_DBG_PROBE, "This Interface = %d\n", nInterfaceNum);
+	CavDbg(NULL, CAV_DBG_PROBE, "Serial private = 0x%p\n",
+	       pSerial->private);
 
 	if (nNumInterfaces == 1) {
-		DBG("SIngle function device detected\n");
+		CavDbg(NULL, CAV_DBG_PROBE,
+		       "SIngle function device detected\n");
 	} else {
-		DBG("Composite device detected\n");
-	}
-
-	nRetval = usb_set_interface(pSerial->dev, nInterfaceNum, 0);
-	if (nRetval < 0) {
-		DBG("Could not set interface, error %d\n", nRetval);
-	}
-	// Check for recursion
-	if (pSerial->type->close != CavClose) {
-		// Store usb_serial_generic_close in gpClose
-		gpClose = pSerial->type->close;
-		pSerial->type->close = CavClose;
-		DBG("Installed CavClose function: 0x%p/0x%p\n", CavClose,
-		    gpClose);
+		CavDbg(NULL, CAV_DBG_PROBE, "Composite device detected\n");
 	}
-
-	if (pSerial->type->write != CavWrite) {
-		gpWrite = pSerial->type->write;
-		pSerial->type->write = CavWrite;
+	numEndpoints = pSerial->interface->cur_altsetting->desc.bNumEndpoints;
+	CavDbg(NULL, CAV_DBG_PROBE, "numEPs=%d\n", numEndpoints);
+
+	// Find the interrupt endpoint, the halts are cleared by CavEpInit
+	for (endpointIndex = 0; endpointIndex < numEndpoints;
+	     endpointIndex++) {
+		pEndpoint = pSerial->interface->cur_altsetting->endpoint +
+			    endpointIndex;
+		if ((usb_endpoint_dir_in(&pEndpoint->desc) == true) &&
+		    (usb_endpoint_xfer_int(&pEndpoint->desc) == true)) {
+			intPipe = usb_rcvintpipe(
+				pSerial->dev,
+				pEndpoint->desc.bEndpointAddress &
+					USB_ENDPOINT_NUMBER_MASK);
+			interruptOk = 1;
+		}
 	}
 
-	if (nRetval == 0) {
-		// Clearing endpoint halt is a magic handshake that brings
-		// the device out of low power (airplane) mode
-		// NOTE: FCC verification should be done before this, if required
-		struct usb_host_endpoint *pEndpoint;
-		int endpointIndex;
-		int numEndpoints =
-			pSerial->interface->cur_altsetting->desc.bNumEndpoints;
-
-		DBG("numEPs=%d\n", numEndpoints);
-		for (endpointIndex = 0; endpointIndex < numEndpoints;
-		     endpointIndex++) {
-			pipe = 0;
-			pEndpoint =
-				pSerial->interface->cur_altsetting->endpoint +
-				endpointIndex;
-
-			DBG("Examining EP 0x%x\n",
-			    pEndpoint->desc.bEndpointAddress);
-			if (pEndpoint != NULL) {
-				if (usb_endpoint_dir_out(&pEndpoint->desc) ==
-				    true) {
-					pipe = usb_sndbulkpipe(
-						pSerial->dev,
-						pEndpoint->desc
-							.bEndpointAddress);
-					nRetval = usb_clear_halt(pSerial->dev,
-								 pipe);
-					DBG("usb_clear_halt OUT returned %d\n",
-					    nRetval);
-				} else if (usb_endpoint_dir_in(
-						   &pEndpoint->desc) == true) {
-					if (usb_endpoint_xfer_int(
-						    &pEndpoint->desc) == true) {
-						intPipe = usb_rcvintpipe(
-							pSerial->dev,
-							pEndpoint->desc.bEndpointAddress &
-								USB_ENDPOINT_NUMBER_MASK);
-						nRetval = usb_clear_halt(
-							pSerial->dev, intPipe);
-						DBG("usb_clear_halt INT returned %d\n",
-						    nRetval);
-						interruptOk = 1;
-					} else {
-						pipe = usb_rcvbulkpipe(
-							pSerial->dev,
-							pEndpoint->desc.bEndpointAddress &
-								USB_ENDPOINT_NUMBER_MASK);
-						nRetval = usb_clear_halt(
-							pSerial->dev, pipe);
-						DBG("usb_clear_halt IN returned %d\n",
-						    nRetval);
-					}
-				}
-			}
-		}
+	if (async_probe == false) {
+		nRetval = CavEpInit(pSerial);
+	} else {
+		nRetval = 0;
 	}
 
 	if ((nRetval == 0) && (context == NULL)) {
@@ -344,24 +464,39 @@ static int CavProbe(struct usb_serial *pSerial,
 
 		context = kzalloc(sizeof(cav_device_context), GFP_KERNEL);
 		if (context != NULL) {
-			DBG("CavProbe: Created context 0x%p\n", context);
+			CavDbg(NULL, CAV_DBG_PROBE,
+			       "CavProbe: Created context 0x%p\n", context);
 			myContext = (cav_device_context *)context;
 			myContext->InterfaceNumber = nInterfaceNum;
+			myContext->pSku = pSku;
+			myContext->pProfile = pProfile;
 			myContext->bInterruptPresent = interruptOk;
 			myContext->IntPipe = intPipe;
 			myContext->pIntUrb = NULL;
-			myContext->bDevClosed = myContext->bDevRemoved = 0;
+			myContext->bDevClosed = 1;
+			myContext->bDevRemoved = 0;
 			myContext->MySerial = pSerial;
 			myContext->MyPort = NULL;
 			myContext->IntErrCnt = 0;
 			myContext->OpenRefCount = 0;
-			myContext->DebugMask = debug = 0;
+			myContext->ProbeAt = probeAt;
+			kref_init(&myContext->Ref);
+			mutex_init(&myContext->OpenLock);
 			spin_lock_init(&myContext->AccessLock);
+			INIT_DELAYED_WORK(&myContext->IntRetryWork,
+					  CavIntRetryWork);
+			INIT_WORK(&myContext->InitWork, CavInitWork);
+			CavRecoverInit(myContext);
+			init_completion(&myContext->InitDone);
+			if (async_probe == false) {
+				CavInitComplete(myContext, 0);
+			}
 			memset(myContext->PortName, 0, CAV_PORT_NAME_LEN);
+			CavDbgSetMask(myContext, debug);
 			usb_set_serial_data(pSerial, context);
 		}
 	}
-	DBG("<--CavProbe\n");
+	CavDbg(NULL, CAV_DBG_PROBE, "<--CavProbe\n");
 	return nRetval;
 } // CavProbe
 
@@ -382,21 +517,63 @@ RETURN VALUE:
 int CavAttach(struct usb_serial *serial)
 {
 	cav_device_context *context;
+	int nRetval;
 
-	DBG("-->CavAttach\n");
 	context = (cav_device_context *)usb_get_serial_data(serial);
-	if (context->bInterruptPresent == 0) {
-		DBG("<--CavAttach: no action\n");
-		return 0;
+	CavDbg(context, CAV_DBG_PROBE, "-->CavAttach\n");
+	context->MyPort = serial->port[0];
+	CavScriptInit(context);
+
+	nRetval = CavStatsAlloc(context);
+	if (nRetval != 0) {
+		CavDbg(context, CAV_DBG_PROBE,
+		       "<--CavAttach: Error allocating statistics\n");
+		return nRetval;
 	}
 
-	context->pIntUrb = usb_alloc_urb(0, GFP_KERNEL);
-	if (context->pIntUrb == NULL) {
-		DBG("<--CavAttach: Error allocating int urb\n");
-		return -ENOMEM;
+	// Allocate the bulk-IN read engine, started in CavOpen
+	nRetval = CavRxAlloc(context, context->MyPort);
+	if (nRetval != 0) {
+		CavDbg(context, CAV_DBG_PROBE,
+		       "<--CavAttach: Error allocating read URBs\n");
+		CavStatsFree(context);
+		return nRetval;
+	}
+
+	// Allocate the bulk-OUT write engine behind CavWrite
+	nRetval = CavTxAlloc(context, context->MyPort);
+	if (nRetval != 0) {
+		CavDbg(context, CAV_DBG_PROBE,
+		       "<--CavAttach: Error allocating write URBs\n");
+		CavRxFree(context);
+		CavStatsFree(context);
+		return nRetval;
+	}
+
+	// Ports without an interrupt EP (f_serial gadgets) still need the
+	// PM policy, the handshake and the attach script below
+	if (context->bInterruptPresent != 0) {
+		context->pIntUrb = usb_alloc_urb(0, GFP_KERNEL);
+		if (context->pIntUrb == NULL) {
+			CavDbg(context, CAV_DBG_PROBE,
+			       "<--CavAttach: Error allocating int urb\n");
+			CavTxFree(context);
+			CavRxFree(context);
+			CavStatsFree(context);
+			return -ENOMEM;
+		}
+	} else {
+		CavDbg(context, CAV_DBG_PROBE, "CavAttach: no interrupt EP\n");
 	}
 
-	DBG("<--CavAttach\n");
+	CavPmInit(context);
+	if (completion_done(&context->InitDone) == false) {
+		// Port registers now, opens wait for the handshake
+		schedule_work(&context->InitWork);
+	} else {
+		CavScriptRun(context, CAV_SCRIPT_ATTACH);
+	}
+	CavDbg(context, CAV_DBG_PROBE, "<--CavAttach\n");
 	return 0;
 } // CavAttach
 
@@ -418,19 +595,33 @@ void CavDisconnect(struct usb_serial *serial)
 	cav_device_context *context =
 		(cav_device_context *)usb_get_serial_data(serial);
 
-	CAV_DBG(context, ("<%s> -->\n", CavPort(context, NULL)));
+	CavDbg(context, CAV_DBG_PROBE, "<%s> -->\n", CavPort(context, NULL));
 	if (context != NULL) {
+		flush_work(&context->InitWork);
+		mutex_lock(&context->OpenLock);
 		context->bDevRemoved = 1;
+		mutex_unlock(&context->OpenLock);
+		if (context->GnssRing != NULL) {
+			// Readers blocked in CavGnssRead see the removal
+			wake_up_interruptible(&context->GnssRing->Wait);
+		}
+		CavAtDisconnect(context);
+		CavUrcDisconnect(context);
+		CavRxStop(context);
+		CavTxStop(context);
+		CavRecoverStop(context);
 		if (context->pIntUrb != NULL) {
+			cancel_delayed_work_sync(&context->IntRetryWork);
 			usb_kill_urb(context->pIntUrb);
 			usb_free_urb(context->pIntUrb);
 			context->pIntUrb = NULL;
 		} else {
-			CAV_DBG(context, ("<%s> Interrupt URB cleared\n",
-					   CavPort(context, NULL)));
+			CavDbg(context, CAV_DBG_PROBE,
+			       "<%s> Interrupt URB cleared\n",
+			       CavPort(context, NULL));
 		}
 	}
-	CAV_DBG(context, ("<%s> <--\n", CavPort(context, NULL)));
+	CavDbg(context, CAV_DBG_PROBE, "<%s> <--\n", CavPort(context, NULL));
 } // CavDisconnect
 
 /*===========================================================================
@@ -451,30 +642,316 @@ void CavRelease(struct usb_serial *serial)
 	cav_device_context *context =
 		(cav_device_context *)usb_get_serial_data(serial);
 
-	CAV_DBG(context, ("<%s> -->\n", CavPort(context, NULL)));
+	CavDbg(context, CAV_DBG_PROBE, "<%s> -->\n", CavPort(context, NULL));
 	if (context != NULL) {
+		flush_work(&context->InitWork);
 		context->bDevRemoved = 1;
 		if (context->pIntUrb != NULL) {
+			cancel_delayed_work_sync(&context->IntRetryWork);
 			usb_kill_urb(context->pIntUrb);
 			usb_free_urb(context->pIntUrb);
 			context->pIntUrb = NULL;
 		} else {
-			CAV_DBG(context, ("<%s> Interrupt URB cleared\n",
-					   CavPort(context, NULL)));
+			CavDbg(context, CAV_DBG_PROBE,
+			       "<%s> Interrupt URB cleared\n",
+			       CavPort(context, NULL));
 		}
-		kfree(context);
+		CavRxStop(context);
+		CavTxStop(context);
+		CavRecoverStop(context);
+		CavRxFree(context);
+		CavTxFree(context);
+		CavContextPut(context);
 		context = NULL;
 		usb_set_serial_data(serial, NULL);
 	}
-	CAV_DBG(context, ("<%s> <--\n", CavPort(context, NULL)));
+	CavDbg(context, CAV_DBG_PROBE, "<%s> <--\n", CavPort(context, NULL));
 } // CavRelease
 
+/*===========================================================================
+METHOD:
+   CavPortProbe
+
+DESCRIPTION:
+   Add the per-port sysfs attributes and companion character devices
+
+PARAMETERS:
+   pPort: [ I ] - serial port structure
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavPortProbe(struct usb_serial_port *pPort)
+{
+	cav_device_context *context =
+		(cav_device_context *)usb_get_serial_data(pPort->serial);
+	int nRetval;
+
+	nRetval = CavSysfsAdd(pPort);
+	if (nRetval != 0) {
+		return nRetval;
+	}
+
+	CavDebugfsAdd(context);
+	nRetval = CavGnssAdd(context);
+	if (nRetval != 0) {
+		CavDbg(context, CAV_DBG_PROBE,
+		       "CavPortProbe: GNSS device failed %d\n", nRetval);
+		CavDebugfsRemove(context);
+		CavSysfsRemove(pPort);
+		return nRetval;
+	}
+	nRetval = CavAtAdd(context);
+	if (nRetval != 0) {
+		CavDbg(context, CAV_DBG_PROBE,
+		       "CavPortProbe: AT broker failed %d\n", nRetval);
+		CavGnssRemove(context);
+		CavDebugfsRemove(context);
+		CavSysfsRemove(pPort);
+		return nRetval;
+	}
+	nRetval = CavUrcAdd(context);
+	if (nRetval != 0) {
+		CavDbg(context, CAV_DBG_PROBE,
+		       "CavPortProbe: URC device failed %d\n", nRetval);
+		CavAtRemove(context);
+		CavGnssRemove(context);
+		CavDebugfsRemove(context);
+		CavSysfsRemove(pPort);
+	}
+	return nRetval;
+} // CavPortProbe
+
+/*===========================================================================
+METHOD:
+   CavPortRemove
+
+DESCRIPTION:
+   Remove the per-port sysfs attributes and companion character devices
+
+PARAMETERS:
+   pPort: [ I ] - serial port structure
+
+RETURN VALUE:
+   none
+===========================================================================*/
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 12, 0))
+void CavPortRemove(struct usb_serial_port *pPort)
+#else
+int CavPortRemove(struct usb_serial_port *pPort)
+#endif
+{
+	cav_device_context *context =
+		(cav_device_context *)usb_get_serial_data(pPort->serial);
+
+	CavUrcRemove(context);
+	CavAtRemove(context);
+	CavGnssRemove(context);
+	CavDebugfsRemove(context);
+	CavSysfsRemove(pPort);
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5, 12, 0))
+	return 0;
+#endif
+} // CavPortRemove
+
+/*===========================================================================
+METHOD:
+   CavContextGet
+
+DESCRIPTION:
+   Take a reference on the private context, held by open companion
+   character devices so the context outlives the usb_serial structure
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavContextGet(cav_device_context *context)
+{
+	kref_get(&context->Ref);
+} // CavContextGet
+
+static void CavContextFree(struct kref *pRef)
+{
+	cav_device_context *context =
+		container_of(pRef, cav_device_context, Ref);
+
+	CavUrcFree(context);
+	CavAtFree(context);
+	CavGnssFree(context);
+	CavStatsFree(context);
+	CavCaptureFree(context);
+	CavDbgSetMask(context, 0);
+	kfree(context);
+}
+
+/*===========================================================================
+METHOD:
+   CavContextPut
+
+DESCRIPTION:
+   Drop a reference on the private context, the last one frees it
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavContextPut(cav_device_context *context)
+{
+	kref_put(&context->Ref, CavContextFree);
+} // CavContextPut
+
+/*===========================================================================
+METHOD:
+   CavIntInterval
+
+DESCRIPTION:
+   Convert a polling interval to the usb_fill_int_urb encoding of the
+   device speed, 2^(n-1) microframes on high speed and above, frames
+   otherwise. Host controllers that schedule from the endpoint descriptor
+   (xHCI) keep bInterval.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   ms:      [ I ] - interval in milliseconds
+
+RETURN VALUE:
+   int - interval argument of usb_fill_int_urb
+===========================================================================*/
+static int CavIntInterval(cav_device_context *context, unsigned int ms)
+{
+	ms = clamp_t(unsigned int, ms, 1, CAV_INT_INTERVAL_MS_MAX);
+	if (context->MySerial->dev->speed >= USB_SPEED_HIGH) {
+		return min(ilog2(ms * 8) + 1, 16);
+	}
+	return min(ms, 255U);
+} // CavIntInterval
+
+/*===========================================================================
+METHOD:
+   CavIntAdapt
+
+DESCRIPTION:
+   Pick the polling interval after a notification. Back-to-back
+   notifications poll at int_interval_ms, each one arriving after
+   CAV_INT_IDLE_MS of silence doubles the interval up to
+   int_idle_interval_ms.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavIntAdapt(cav_device_context *context)
+{
+	unsigned int base = READ_ONCE(int_interval_ms);
+	unsigned int idle = max(READ_ONCE(int_idle_interval_ms), base);
+	unsigned int interval = base;
+
+	if ((context->IntLastJiffies != 0) &&
+	    time_after(jiffies, context->IntLastJiffies +
+					msecs_to_jiffies(CAV_INT_IDLE_MS))) {
+		interval = min(max(context->IntIntervalMs * 2, base), idle);
+	}
+	context->IntLastJiffies = jiffies | 1;
+	WRITE_ONCE(context->IntIntervalMs, interval);
+} // CavIntAdapt
+
+/*===========================================================================
+METHOD:
+   CavIntRetryMs
+
+DESCRIPTION:
+   Delay of the resubmission after an interrupt URB error. The delay
+   starts at CAV_INT_RETRY_MS_MIN and doubles with every failure past
+   CAV_ERR_CNT_LIMIT, up to CAV_INT_RETRY_MS_MAX.
+
+PARAMETERS:
+   errCnt: [ I ] - consecutive errors, IntErrCnt
+
+RETURN VALUE:
+   unsigned int - delay in milliseconds
+===========================================================================*/
+unsigned int CavIntRetryMs(int errCnt)
+{
+	int shift = clamp(errCnt - CAV_ERR_CNT_LIMIT - 1, 0, 12);
+
+	return min(CAV_INT_RETRY_MS_MIN << shift, CAV_INT_RETRY_MS_MAX);
+} // CavIntRetryMs
+CAV_KUNIT_EXPORT(CavIntRetryMs);
+
+/*===========================================================================
+METHOD:
+   CavIntRetry
+
+DESCRIPTION:
+   Schedule a delayed resubmission of the interrupt URB, see CavIntRetryMs
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavIntRetry(cav_device_context *context)
+{
+	unsigned int delay = CavIntRetryMs(context->IntErrCnt);
+
+	CavDbg(context, CAV_DBG_INT, "<%s> error %d count %d, retry in %u ms\n",
+	       CavPort(context, NULL), context->IntLastStatus,
+	       context->IntErrCnt, delay);
+	schedule_delayed_work(&context->IntRetryWork, msecs_to_jiffies(delay));
+} // CavIntRetry
+
+/*===========================================================================
+METHOD:
+   CavIntRetryWork
+
+DESCRIPTION:
+   Resubmit the interrupt URB after errors, clearing a stalled endpoint
+   first
+
+PARAMETERS:
+   pWork: [ I ] - IntRetryWork of the context
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavIntRetryWork(struct work_struct *pWork)
+{
+	cav_device_context *context = container_of(
+		to_delayed_work(pWork), cav_device_context, IntRetryWork);
+	int status;
+
+	if ((context->bDevClosed != 0) || (context->bDevRemoved != 0)) {
+		return;
+	}
+	if (context->IntLastStatus == -EPIPE) {
+		usb_clear_halt(context->MySerial->dev, context->IntPipe);
+	}
+	WRITE_ONCE(context->IntRecoveries, context->IntRecoveries + 1);
+	status = ResubmitIntURB(context->pIntUrb);
+	if ((status != 0) && (status != -ENODEV) && (status != -EPERM)) {
+		context->IntLastStatus = status;
+		context->IntErrCnt++;
+		CavIntRetry(context);
+	}
+} // CavIntRetryWork
+
 /*===========================================================================
 METHOD:
    IntCallback
 
 DESCRIPTION:
-   Callback function for interrupt URB
+   Callback function for interrupt URB. Failed URBs are resubmitted at
+   once up to CAV_ERR_CNT_LIMIT consecutive errors, then with
+   exponential backoff from CavIntRetryWork.
 
 PARAMETERS:
    pIntUrb    [ I ] - URB
@@ -485,28 +962,55 @@ RETURN VALUE:
 void IntCallback(struct urb *pIntUrb)
 {
 	cav_device_context *context = (cav_device_context *)pIntUrb->context;
+	int status = pIntUrb->status;
 
-	CavDBG(context, "--> status = %d\n", pIntUrb->status);
-	if (pIntUrb->status != 0) {
-		// Ignore EOVERFLOW errors
-		if (pIntUrb->status != -EOVERFLOW) {
-			CavDBG(context, "<-- status = %d\n", pIntUrb->status);
-			context->IntErrCnt++;
-			return;
-		}
-	} else {
+	context->IntCompleteAt = ktime_get();
+	if ((status == 0) && CavFailIntUrb()) {
+		// Injected through debugfs fail_int
+		status = -EPROTO;
+	}
+	trace_cav_int_notify(context->MyPort->minor, pIntUrb);
+	CavCapture(context, pIntUrb, 'C', status, pIntUrb->transfer_buffer,
+		   pIntUrb->actual_length);
+	switch (status) {
+	case 0:
 		context->IntErrCnt = 0;
-		DBG("IntCallback: %d bytes\n", pIntUrb->actual_length);
+		usb_mark_last_busy(context->MySerial->dev);
+		CavStatInc(context, CAV_STAT_INT_NOTIFY);
 		PrintHex(context, pIntUrb->transfer_buffer,
 			 pIntUrb->actual_length, "INT");
+		CavLineNotify(context, pIntUrb->transfer_buffer,
+			      pIntUrb->actual_length);
+		CavIntAdapt(context);
+		break;
+	case -EOVERFLOW:
+		// Ignore EOVERFLOW errors
+		CavStatInc(context, CAV_STAT_INT_EOVERFLOW);
+		break;
+	case -ENOENT:
+	case -ECONNRESET:
+	case -ESHUTDOWN:
+		// Unlinked by close or disconnect
+		return;
+	default:
+		CavStatUrbError(context, status);
+		context->IntLastStatus = status;
+		context->IntErrCnt++;
+		if (context->IntErrCnt > CAV_ERR_CNT_LIMIT) {
+			if ((context->bDevClosed == 0) &&
+			    (context->bDevRemoved == 0)) {
+				CavIntRetry(context);
+			}
+			return;
+		}
+		break;
 	}
 
 	if ((context->bDevClosed == 0) && (context->bDevRemoved == 0)) {
-		CavDBG(context, "re-activate interrupt pipe 0x%p\n", pIntUrb);
 		ResubmitIntURB(pIntUrb);
 	}
-	CavDBG(context, "<-- status = %d\n", pIntUrb->status);
 } // IntCallback
+CAV_KUNIT_EXPORT(IntCallback);
 
 /*===========================================================================
 METHOD:
@@ -530,26 +1034,20 @@ int ResubmitIntURB(struct urb *pIntUrb)
 
 	// Sanity test
 	if ((pIntUrb == NULL) || (pIntUrb->dev == NULL)) {
-		CAV_DBG(context, ("<%s> <-- NULL URB or dev\n",
-				   CavPort(context, NULL)));
+		CavDbg(context, CAV_DBG_INT, "<%s> <-- NULL URB or dev\n",
+		       CavPort(context, NULL));
 		return -EINVAL;
 	}
 	context = (cav_device_context *)pIntUrb->context;
-	CAV_DBG(context, ("<%s> -->\n", CavPort(context, NULL)));
+	CavDbg(context, CAV_DBG_INT, "<%s> -->\n", CavPort(context, NULL));
 	if ((context->bDevClosed != 0) || (context->bDevRemoved != 0)) {
-		CAV_DBG(context,
-			 ("<%s> <-- No action\n", CavPort(context, NULL)));
-		return 0;
-	}
-	if (context->IntErrCnt > CAV_ERR_CNT_LIMIT) {
-		CAV_DBG(context,
-			 ("<%s> <-- stop due to errors %d\n",
-			  CavPort(context, NULL), context->IntErrCnt));
+		CavDbg(context, CAV_DBG_INT, "<%s> <-- No action\n",
+		       CavPort(context, NULL));
 		return 0;
 	}
 
 	// Interval needs reset after every URB completion
-	interval = 9;
+	interval = CavIntInterval(context, READ_ONCE(context->IntIntervalMs));
 
 	// Reschedule interrupt URB
 	usb_fill_int_urb(pIntUrb, pIntUrb->dev, pIntUrb->pipe,
@@ -557,8 +1055,15 @@ int ResubmitIntURB(struct urb *pIntUrb)
 			 pIntUrb->transfer_buffer_length, pIntUrb->complete,
 			 pIntUrb->context, interval);
 	status = usb_submit_urb(pIntUrb, GFP_ATOMIC);
-	CAV_DBG(context,
-		 ("<%s> <-- status %d\n", CavPort(context, NULL), status));
+	trace_cav_urb_submit(context->MyPort->minor, pIntUrb, status);
+	if ((status == 0) && (context->IntCompleteAt != 0)) {
+		// Turnaround includes the backoff of CavIntRetryWork
+		CavHistAdd(context, CAV_HIST_INT, context->IntCompleteAt,
+			   ktime_get());
+		context->IntCompleteAt = 0;
+	}
+	CavDbg(context, CAV_DBG_INT, "<%s> <-- status %d\n",
+	       CavPort(context, NULL), status);
 
 	return status;
 } // ResubmitIntURB
@@ -568,7 +1073,8 @@ METHOD:
    CavOpen (Free Method)
 
 DESCRIPTION:
-   Start GPS if GPS port, run usb_serial_generic_open
+   Start the read engine or run usb_serial_generic_open, then queue the
+   open script of the port
 
 PARAMETERS:
    pTTY    [ I ] - TTY structure (only on kernels <= 2.6.26)
@@ -591,116 +1097,118 @@ int CavOpen(struct tty_struct *pTTY, struct usb_serial_port *pPort)
 	cav_device_context *context = NULL;
 	int genericOpenStatus;
 	unsigned long flags;
-#ifdef GPS_AUTO_START
-	const char startMessage[] = "$GPS_START";
-	int bytesWrote;
-	int nResult;
-#endif
 
-	CAV_DBG(NULL, ("<%s> -->\n", CavPort(NULL, pPort)));
+	CavDbg(NULL, CAV_DBG_OPEN, "<%s> -->\n", CavPort(NULL, pPort));
 
 	// Test parameters
 	if ((pPort == NULL) || (pPort->serial == NULL) ||
 	    (pPort->serial->dev == NULL) ||
 	    (pPort->serial->interface == NULL) ||
 	    (pPort->serial->interface->cur_altsetting == NULL)) {
-		CAV_DBG(NULL, ("<%s> <-- invalid parameter\n",
-				CavPort(NULL, pPort)));
+		CavDbg(NULL, CAV_DBG_OPEN, "<%s> <-- invalid parameter\n",
+		       CavPort(NULL, pPort));
 		return -EINVAL;
 	}
 
 	context = (cav_device_context *)usb_get_serial_data(pPort->serial);
+	genericOpenStatus = CavWaitReady(context);
+	if (genericOpenStatus != 0) {
+		CavDbg(context, CAV_DBG_OPEN, "<%s> <-- not ready %d\n",
+		       CavPort(NULL, pPort), genericOpenStatus);
+		return genericOpenStatus;
+	}
 	if (context->MyPort == NULL) {
 		context->MyPort = pPort;
-		if (pPort->port.tty != NULL) {
-			strncpy(context->PortName, pPort->port.tty->name,
-				(CAV_PORT_NAME_LEN - 1));
-		}
+	}
+	if ((context->PortName[0] == 0) && (pPort->port.tty != NULL)) {
+		strncpy(context->PortName, pPort->port.tty->name,
+			(CAV_PORT_NAME_LEN - 1));
 	}
 
 	spin_lock_irqsave(&context->AccessLock, flags);
 	if (context->OpenRefCount > 0) {
-		CavDBG(context, "<--device busy, open denied. RefCnt=%d\n",
-			context->OpenRefCount);
+		CavDbg(context, CAV_DBG_OPEN,
+		       "<--device busy, open denied. RefCnt=%d\n",
+		       context->OpenRefCount);
 		spin_unlock_irqrestore(&context->AccessLock, flags);
 		return -EIO;
 	} else {
 		context->OpenRefCount++;
 		spin_unlock_irqrestore(&context->AccessLock, flags);
 	}
-#ifdef GPS_AUTO_START
-	// Is this the GPS port?
-	if (pPort->serial->interface->cur_altsetting->desc.bInterfaceNumber ==
-	    3) {
-		// Send startMessage, 1s timeout
-		nResult = usb_bulk_msg(
-			pPort->serial->dev,
-			usb_sndbulkpipe(pPort->serial->dev,
-					pPort->bulk_out_endpointAddress),
-			(void *)&startMessage[0], sizeof(startMessage),
-			&bytesWrote, 1000);
-		if (nResult != 0) {
-			CAV_DBG(NULL,
-				 ("<%s> <-- error %d sending startMessage\n",
-				  CavPort(NULL, pPort), nResult));
-			return nResult;
-		}
-		if (bytesWrote != sizeof(startMessage)) {
-			CAV_DBG(NULL, ("<%s> <-- invalid write size %d, %lu\n",
-					CavPort(NULL, pPort), bytesWrote,
-					sizeof(startMessage)));
-			return -EIO;
-		}
-	}
-#endif // GPS_AUTO_START
-
 	context->bDevClosed = 0;
 	if ((context->pIntUrb != NULL) && (context->bDevRemoved == 0)) {
 		if (context->bInterruptPresent != 0) {
-			int interval = 9;
+			int interval;
+			int status;
 
-			CAV_DBG(NULL, ("<%s> start interrupt EP\n",
-					CavPort(NULL, pPort)));
+			CavDbg(context, CAV_DBG_OPEN,
+			       "<%s> start interrupt EP\n",
+			       CavPort(NULL, pPort));
 			context->IntErrCnt = 0;
+			context->IntLastJiffies = 0;
+			context->IntIntervalMs = READ_ONCE(int_interval_ms);
+			interval = CavIntInterval(context,
+						  context->IntIntervalMs);
 			usb_fill_int_urb(context->pIntUrb,
 					 context->MySerial->dev,
 					 context->IntPipe, context->IntBuffer,
 					 CAV_INT_BUF_SIZE, IntCallback,
 					 context, interval);
 
-			usb_submit_urb(context->pIntUrb, GFP_KERNEL);
+			status = usb_submit_urb(context->pIntUrb, GFP_KERNEL);
+			trace_cav_urb_submit(pPort->minor, context->pIntUrb,
+					     status);
 
 			// set DTR/RTS
 			CavSetDtrRts(context, (CAV_SER_DTR | CAV_SER_RTS));
 		}
 	}
 
-	// Pass to usb_serial_generic_open
+	if (context->RxUrbCount > 0) {
+		// Keep the driver-owned bulk-IN URBs in flight
+		genericOpenStatus = CavRxGet(context);
+	} else {
+		// Pass to usb_serial_generic_open
 #if (LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 26))
-	genericOpenStatus = usb_serial_generic_open(pPort, pFilp);
+		genericOpenStatus = usb_serial_generic_open(pPort, pFilp);
 #elif (LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 31))
-	genericOpenStatus = usb_serial_generic_open(pTTY, pPort, pFilp);
+		genericOpenStatus = usb_serial_generic_open(pTTY, pPort, pFilp);
 #else // > 2.6.31
-	genericOpenStatus = usb_serial_generic_open(pTTY, pPort);
+		genericOpenStatus = usb_serial_generic_open(pTTY, pPort);
 #endif
+	}
 
 	if (genericOpenStatus != 0) {
+		context->bDevClosed = 1;
 		spin_lock_irqsave(&context->AccessLock, flags);
 		context->OpenRefCount--;
 		spin_unlock_irqrestore(&context->AccessLock, flags);
+	} else {
+		CavScriptRun(context, CAV_SCRIPT_OPEN);
 	}
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 5, 0))
+	if (genericOpenStatus == 0) {
+		// Drop the reference usb-serial holds while the port is open,
+		// the port autosuspends when idle and wakes on write
+		usb_autopm_put_interface(pPort->serial->interface);
+	}
+#endif
 
-	CavDBG(context, "<-- ST %d RefCnt %d\n", genericOpenStatus,
-		context->OpenRefCount);
+	trace_cav_open(pPort->minor, genericOpenStatus);
+	CavDbg(context, CAV_DBG_OPEN, "<-- ST %d RefCnt %d\n",
+	       genericOpenStatus, context->OpenRefCount);
 	return genericOpenStatus;
 } // CavOpen
+CAV_KUNIT_EXPORT(CavOpen);
 
 /*===========================================================================
 METHOD:
    CavClose (Free Method)
 
 DESCRIPTION:
-   Stop GPS if GPS port, run usb_serial_generic_close
+   Stop the engines, queue the close script of the port and run
+   usb_serial_generic_close
 
 PARAMETERS:
    pTTY    [ I ] - TTY structure (only if kernel > 2.6.26 and <= 2.6.30)
@@ -716,31 +1224,42 @@ void CavClose(struct tty_struct *pTTY, struct usb_serial_port *pPort,
 void CavClose(struct usb_serial_port *pPort)
 #endif
 {
-#ifdef GPS_AUTO_START
-	const char stopMessage[] = "$GPS_STOP";
-	int nResult;
-	int bytesWrote;
-#endif
 	cav_device_context *context;
 	unsigned long flags;
 
-	CAV_DBG(NULL, ("<%s> -->\n", CavPort(NULL, pPort)));
+	CavDbg(NULL, CAV_DBG_OPEN, "<%s> -->\n", CavPort(NULL, pPort));
 
 	// Test parameters
 	if ((pPort == NULL) || (pPort->serial == NULL) ||
 	    (pPort->serial->dev == NULL) ||
 	    (pPort->serial->interface == NULL) ||
 	    (pPort->serial->interface->cur_altsetting == NULL)) {
-		CAV_DBG(NULL, ("<%s> <-- invalid parameter\n",
-				CavPort(NULL, pPort)));
+		CavDbg(NULL, CAV_DBG_OPEN, "<%s> <-- invalid parameter\n",
+		       CavPort(NULL, pPort));
 		return;
 	}
 
 	context = (cav_device_context *)usb_get_serial_data(pPort->serial);
+	trace_cav_close(pPort->minor);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 5, 0))
+	// Retake the reference dropped by CavOpen, usb-serial releases it
+	// after close
+	if (usb_autopm_get_interface(pPort->serial->interface) != 0) {
+		usb_autopm_get_interface_no_resume(pPort->serial->interface);
+	}
+#endif
 	context->bDevClosed = 1;
+	if (context->RxUrbCount > 0) {
+		CavRxPut(context);
+	}
+	CavTxStop(context);
+	// Sent after the port is closed, opening again discards what is left
+	CavScriptRun(context, CAV_SCRIPT_CLOSE);
 	if (context->pIntUrb != NULL) {
-		CAV_DBG(NULL, ("<%s> cancel interrupt URB 0x%p\n",
-				CavPort(NULL, pPort), context->pIntUrb));
+		CavDbg(context, CAV_DBG_OPEN,
+		       "<%s> cancel interrupt URB 0x%p\n",
+		       CavPort(NULL, pPort), context->pIntUrb);
+		cancel_delayed_work_sync(&context->IntRetryWork);
 		usb_kill_urb(context->pIntUrb);
 		// clear DTR/RTS
 		CavSetDtrRts(context, 0);
@@ -750,81 +1269,18 @@ void CavClose(struct usb_serial_port *pPort)
 	context->OpenRefCount--;
 	spin_unlock_irqrestore(&context->AccessLock, flags);
 
-#ifdef GPS_AUTO_START
-	// Is this the GPS port?
-	if (pPort->serial->interface->cur_altsetting->desc.bInterfaceNumber ==
-	    3) {
-		// Send stopMessage, 1s timeout
-		nResult = usb_bulk_msg(
-			pPort->serial->dev,
-			usb_sndbulkpipe(pPort->serial->dev,
-					pPort->bulk_out_endpointAddress),
-			(void *)&stopMessage[0], sizeof(stopMessage),
-			&bytesWrote, 1000);
-		if (nResult != 0) {
-			CAV_DBG(NULL, ("<%s> error %d sending stopMessage\n",
-					CavPort(NULL, pPort), nResult));
-		}
-		if (bytesWrote != sizeof(stopMessage)) {
-			CAV_DBG(NULL, ("<%s> invalid write size %d, %lu\n",
-					CavPort(NULL, pPort), bytesWrote,
-					sizeof(stopMessage)));
-		}
-	}
-#endif // GPS_AUTO_START
-
 	// Pass to usb_serial_generic_close
-	if (gpClose == NULL) {
-		CAV_DBG(NULL,
-			 ("<%s> <-- NULL gpClose\n", CavPort(NULL, pPort)));
-		return;
-	}
-
 #if (LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 26))
-	gpClose(pPort, pFilp);
+	usb_serial_generic_close(pPort, pFilp);
 #elif (LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 30))
-	gpClose(pTTY, pPort, pFilp);
+	usb_serial_generic_close(pTTY, pPort, pFilp);
 #else // > 2.6.30
-	gpClose(pPort);
+	usb_serial_generic_close(pPort);
 #endif
-	CavDBG(context, "<-- with gpClose RefCnt %d\n", context->OpenRefCount);
+	CavDbg(context, CAV_DBG_OPEN, "<-- RefCnt %d\n",
+	       context->OpenRefCount);
 } // CavClose
-
-/*===========================================================================
-METHOD:
-   CavWrite
-
-DESCRIPTION:
-   Write data over the USB BULK pipe
-
-PARAMETERS:
-   tty:    [ I ] - TTY structure associated with the serial device
-   pPort:  [ I ] - the serial port structure
-   buf:    [ I ] - buffer containing the USB bulk OUT data
-   count:  [ I ] - number of bytes of the USB bulk OUT data
-
-RETURN VALUE:
-===========================================================================*/
-int CavWrite(struct tty_struct *tty, struct usb_serial_port *pPort,
-	      const unsigned char *buf, int count)
-{
-	void *context = usb_get_serial_data(pPort->serial);
-
-	/***
-  if (context != NULL)
-  {
-     CAV_DBG(NULL, ("<%s> serial ctxt 0x%p / 0x%p\n", CavPort(NULL, pPort),
-  pPort->serial, context));
-  }
-  else
-  {
-     CAV_DBG(NULL, ("<%s> serial ctxt 0x%p / NULL\n", CavPort(NULL, pPort),
-  pPort->serial));
-  }
-  ***/
-	PrintHex(context, buf, count, "SEND");
-	return gpWrite(tty, pPort, buf, count);
-} // CavWrite
+CAV_KUNIT_EXPORT(CavClose);
 
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 25))
 
@@ -848,10 +1304,11 @@ static void CavReadBulkCallback(struct urb *pURB)
 	int nRoom = 0;
 	unsigned int pipeEP;
 
-	DBG("port %d\n", pPort->number);
+	CavDbg(NULL, CAV_DBG_RX, "port %d\n", pPort->number);
 
 	if (pURB->status != 0) {
-		DBG("nonzero read bulk status received: %d\n", pURB->status);
+		CavDbg(NULL, CAV_DBG_RX,
+		       "nonzero read bulk status received: %d\n", pURB->status);
 
 		return;
 	}
@@ -864,7 +1321,7 @@ static void CavReadBulkCallback(struct urb *pURB)
 	// Push data to tty layer and user space read function
 	if (pTTY != 0 && pURB->actual_length) {
 		nRoom = tty_buffer_request_room(pTTY, pURB->actual_length);
-		DBG("room size %d %d\n", nRoom, 512);
+		CavDbg(NULL, CAV_DBG_RX, "room size %d %d\n", nRoom, 512);
 		if (nRoom != 0) {
 			tty_insert_flip_string(pTTY, pURB->transfer_buffer,
 					       nRoom);
@@ -883,7 +1340,8 @@ static void CavReadBulkCallback(struct urb *pURB)
 
 	nResult = usb_submit_urb(pPort->read_urb, GFP_ATOMIC);
 	if (nResult != 0) {
-		DBG("failed resubmitting read urb, error %d\n", nResult);
+		CavDbg(NULL, CAV_DBG_RX,
+		       "failed resubmitting read urb, error %d\n", nResult);
 	}
 }
 
@@ -894,7 +1352,8 @@ METHOD:
    CavSuspend (Public Method)
 
 DESCRIPTION:
-   Set reset_resume flag
+   Suspend callback of CavDriver on kernels registering it directly,
+   usb_serial_suspend stops the port through CavPmSuspend
 
 PARAMETERS
    pIntf          [ I ] - Pointer to interface
@@ -917,11 +1376,6 @@ int CavSuspend(struct usb_interface *pIntf, pm_message_t powerEvent)
 		return -ENXIO;
 	}
 
-	// Unless this is PM_EVENT_SUSPEND, make sure device gets rescanned
-	if ((powerEvent.event & PM_EVENT_SUSPEND) == 0) {
-		pDev->dev->reset_resume = 1;
-	}
-
 	// Run usb_serial's suspend function
 	return usb_serial_suspend(pIntf, powerEvent);
 } // CavSuspend
@@ -953,11 +1407,11 @@ int CavResume(struct usb_interface *pIntf)
 	int portIndex, errors, nResult;
 
 	if (pSerial == NULL) {
-		DBG("no pSerial\n");
+		CavDbg(NULL, CAV_DBG_PROBE, "no pSerial\n");
 		return -ENOMEM;
 	}
 	if (pSerial->type == NULL) {
-		DBG("no pSerial->type\n");
+		CavDbg(NULL, CAV_DBG_PROBE, "no pSerial->type\n");
 		return ENOMEM;
 	}
 	if (pSerial->type->resume == NULL) {
@@ -972,7 +1426,8 @@ int CavResume(struct usb_interface *pIntf)
 							 GFP_NOIO);
 				if (nResult < 0) {
 					// Return first error we see
-					DBG("error %d\n", nResult);
+					CavDbg(NULL, CAV_DBG_PROBE,
+					       "error %d\n", nResult);
 					return nResult;
 				}
 			}
@@ -1005,7 +1460,12 @@ RETURN VALUE:
 static int __init CavInit(void)
 {
 	int nRetval = 0;
-	gpClose = NULL;
+
+	nRetval = CavCharInit();
+	if (nRetval != 0) {
+		return nRetval;
+	}
+	CavDebugfsInit();
 
 	gCavDevice.num_ports = NUM_BULK_EPS;
 
@@ -1022,6 +1482,8 @@ static int __init CavInit(void)
 #endif
 
 	if (nRetval != 0) {
+		CavDebugfsExit();
+		CavCharExit();
 		return nRetval;
 	}
 
@@ -1030,6 +1492,8 @@ static int __init CavInit(void)
 	nRetval = usb_register(&CavDriver);
 	if (nRetval != 0) {
 		usb_serial_deregister(&gCavDevice);
+		CavDebugfsExit();
+		CavCharExit();
 		return nRetval;
 	}
 #endif
@@ -1053,7 +1517,6 @@ RETURN VALUE:
 ===========================================================================*/
 static void __exit CavExit(void)
 {
-	gpClose = NULL;
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(3, 4, 0))
 	usb_deregister(&CavDriver);
 	usb_serial_deregister(&gCavDevice);
@@ -1062,8 +1525,20 @@ static void __exit CavExit(void)
 #else
 	usb_serial_deregister_drivers(&CavDriver, gCavDevices);
 #endif
+	CavDebugfsExit();
+	CavCharExit();
 } // CavExit
 
+module_param(async_probe, bool, S_IRUGO);
+MODULE_PARM_DESC(async_probe,
+		 "Clear endpoint halts after the port registers");
+module_param(int_interval_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(int_interval_ms,
+		 "Interrupt endpoint polling interval in milliseconds");
+module_param(int_idle_interval_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(int_idle_interval_ms,
+		 "Interrupt endpoint polling interval ceiling while idle");
+
 // Calling kernel module to init our driver
 module_init(CavInit);
 module_exit(CavExit);
@@ -1073,5 +1548,3 @@ MODULE_AUTHOR(DRIVER_AUTHOR);
 MODULE_DESCRIPTION(DRIVER_DESC);
 MODULE_LICENSE("Dual BSD/GPL");
 
-module_param(debug, ulong, S_IRUGO | S_IWUSR);
-MODULE_PARM_DESC(debug, "Debug enabled or not");
@@ -16,41 +16,290 @@
 #define CAV_SER_DTR 0x01
 #define CAV_SER_RTS 0x02
 
-// Global pointer to usb_serial_generic_close function
-// This function is not exported, which is why we have to use a pointer
-// instead of just calling it.
-#if (LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 26))
-void (*gpClose)(struct usb_serial_port *, struct file *);
-#elif (LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 30))
-void (*gpClose)(struct tty_struct *, struct usb_serial_port *, struct file *);
-#else // > 2.6.30
-void (*gpClose)(struct usb_serial_port *);
-int (*gpWrite)(struct tty_struct *, struct usb_serial_port *,
-	       const unsigned char *, int);
-#endif
+#define C10QM_VID 0x05C6
+#define C10QM_PID 0x9025
+#define C10QM_AT_INTF_NUM 2
+#define C10QM_GNSS_INTF_NUM 3
 
-// DBG macro
-#define DBG(format, arg...)                                              \
-	if (debug == 1) {                                                \
-		printk(KERN_INFO "CavSerial::%s " format, __FUNCTION__, \
-		       ##arg);                                           \
-	}
+// Interface roles of a SKU profile
+#define CAV_ROLE_NONE 0
+#define CAV_ROLE_AT 1
+#define CAV_ROLE_GNSS 2
+#define CAV_ROLE_DIAG 3
+#define CAV_ROLE_MODEM 4
+#define CAV_ROLES 5
+#define CAV_SKU_MAX_INTF 8
 
-#define CAV_DBG(_context_, _dbg_str_) \
-	{                              \
-		DBG _dbg_str_;         \
-	}
+// Interface profile quirks
+#define CAV_QUIRK_NO_CTRL_LINES BIT(0) // no SET_CONTROL_LINE_STATE
+#define CAV_QUIRK_TX_ZLP BIT(1) // end bulk-OUT transfers with a ZLP
 
-#define CavDBG(_context_, _format_, _arg_...)                                               \
-	{                                                                                    \
-		/*printk( KERN_INFO "CavQMSerial::%s <%s> " _format_,                       \
-    __FUNCTION__, CavPort(_context_,NULL), ## _arg_ );*/ \
-	}
+// Companion character devices
+#define CAV_CHAR_MINORS 256
+#define CAV_GNSS_RING_SIZE_DEFAULT (64 * 1024)
+#define CAV_GNSS_RING_SIZE_MAX (4 * 1024 * 1024)
+#define CAV_GNSS_STAMPS 256 // completion records kept, power of two
+
+// Bulk-IN read engine
+#define CAV_MAX_RX_URBS 16
+#define CAV_RX_URBS_DEFAULT 4
+#define CAV_RX_BUF_MPS_DEFAULT 8
+#define CAV_RX_BUF_MPS_MAX 64
+
+// RX overflow policies, what happens while the tty reader is behind
+#define CAV_RX_BACKPRESSURE 0 // stop reading from the device
+#define CAV_RX_DROP_NEWEST 1 // discard data received meanwhile
+#define CAV_RX_DROP_OLDEST 2 // keep the newest data in RxFifo
+#define CAV_RX_OVERFLOWS 3
+#define CAV_RX_FIFO_SIZE_DEFAULT 16384
+#define CAV_RX_FIFO_SIZE_MAX (1024 * 1024)
+
+// Bulk-OUT write engine
+#define CAV_MAX_TX_URBS 16
+#define CAV_TX_URBS_DEFAULT 4
+#define CAV_TX_BUF_SIZE 4096
+#define CAV_TX_FIFO_SIZE_DEFAULT 16384
+#define CAV_TX_COALESCE_US_MAX 100000
+#define CAV_TX_STAMPS 64 // write times kept, power of two
+
+// RecoverFlags bits, faults handled by CavRecoverWork
+#define CAV_RECOVER_RX_HALT 0 // bulk-IN endpoint stalled
+#define CAV_RECOVER_TX_HALT 1 // bulk-OUT endpoint stalled
+#define CAV_RECOVER_RX_RESTART 2 // RX watchdog expired
+#define CAV_RECOVER_RESET 3 // RX watchdog expired again after a restart
+#define CAV_RX_WATCHDOG_MS_MAX 3600000
+
+// TTY push policies
+#define CAV_PUSH_IMMEDIATE 0
+#define CAV_PUSH_BATCHED 1
+#define CAV_PUSH_LINE 2
+#define CAV_PUSH_MODES 3
+#define CAV_PUSH_LATENCY_US_DEFAULT 2000
+#define CAV_PUSH_LATENCY_US_MAX 1000000
+#define CAV_PUSH_BATCH_MAX 4096
+
+// Interrupt endpoint polling and error recovery
+#define CAV_INT_INTERVAL_MS_DEFAULT 32
+#define CAV_INT_IDLE_INTERVAL_MS_DEFAULT 256
+#define CAV_INT_INTERVAL_MS_MAX 4096
+#define CAV_INT_IDLE_MS 1000
+#define CAV_INT_RETRY_MS_MIN 10
+#define CAV_INT_RETRY_MS_MAX 30000
+
+// AT command broker
+#define CAV_AT_TIMEOUT_MS_DEFAULT 5000
+#define CAV_AT_TIMEOUT_MS_MAX 600000
+#define CAV_AT_DRAIN_MS 500 // quiet time ending the wait for a late result
+#define CAV_AT_CMD_MAX 512
+#define CAV_AT_RESP_MAX 4096
+#define CAV_AT_LINE_MAX 32 // enough to match the final result codes
+
+// URC router, /dev/cavurcN
+#define CAV_URC_PREFIXES 16
+#define CAV_URC_PREFIX_MAX 16
+#define CAV_URC_WATCH_MAX 16 // line start kept to spot result codes
+#define CAV_URC_PREFIXES_DEFAULT                                          \
+	"+CREG:,+CEREG:,+CGREG:,+C5GREG:,RING,+CRING:,+CMTI:,+CLIP:,+QIND:," \
+	"+CGEV:"
+
+// Per-port command scripts
+#define CAV_SCRIPT_ATTACH 0
+#define CAV_SCRIPT_OPEN 1
+#define CAV_SCRIPT_CLOSE 2
+#define CAV_SCRIPT_EVENTS 3
+#define CAV_SCRIPT_MAX 256
+
+// Traffic capture ring
+#define CAV_CAPTURE_RECORDS_DEFAULT 1024
+#define CAV_CAPTURE_RECORDS_MAX 65536
+#define CAV_CAPTURE_SNAPLEN_DEFAULT 256
+#define CAV_CAPTURE_SNAPLEN_MAX 4096
+#define CAV_CAPTURE_BYTES_MAX (16 * 1024 * 1024) // ring size limit
+
+// Per-port statistics counters, sysfs statistics/ group
+enum {
+	CAV_STAT_RX_BYTES,
+	CAV_STAT_RX_URBS,
+	CAV_STAT_TX_BYTES,
+	CAV_STAT_TX_URBS,
+	CAV_STAT_TX_DROPPED,
+	CAV_STAT_URB_EPROTO,
+	CAV_STAT_URB_EILSEQ,
+	CAV_STAT_URB_ETIME,
+	CAV_STAT_URB_EOVERFLOW,
+	CAV_STAT_URB_EPIPE,
+	CAV_STAT_URB_OTHER,
+	CAV_STAT_INT_EOVERFLOW,
+	CAV_STAT_INT_NOTIFY,
+	CAV_STAT_TTY_OVERRUNS,
+	CAV_STAT_TTY_DROPPED,
+	CAV_STAT_RX_DROPPED,
+	CAV_STAT_RX_DROPPED_LINES,
+	CAV_STAT_PM_SUSPENDS,
+	CAV_STAT_PM_RESUMES,
+	CAV_STAT_PM_RESET_RESUMES,
+	CAV_STAT_PM_WAKE_WRITES,
+	CAV_STAT_PM_SUSPENDED_MS,
+	CAV_STAT_RECOVER_HALTS,
+	CAV_STAT_RECOVER_WATCHDOG,
+	CAV_STAT_RECOVER_RESETS,
+	CAV_STAT_RECOVER_FAILED,
+	CAV_STAT_RECOVER_US,
+	CAV_STATS
+};
+
+// Per-port latency histograms, debugfs latency file. Bucket n counts
+// latencies of [2^n, 2^(n+1)) ns, the last one also everything longer.
+enum {
+	CAV_HIST_RX_URB, // bulk-IN submit to completion
+	CAV_HIST_RX_PUSH, // bulk-IN completion to TTY push
+	CAV_HIST_TX, // CavWrite to bulk-OUT completion
+	CAV_HIST_INT, // interrupt completion to resubmission
+	CAV_HISTS
+};
+#define CAV_HIST_BUCKETS 32
+
+// RxFlags bits
+#define CAV_RX_RUNNING 0
+#define CAV_RX_THROTTLED 1
+#define CAV_RX_SUSPENDED 2 // stopped by suspend, restarted by resume
+#define CAV_RX_TTY_THROTTLED 3 // line discipline wants no more data
+
+// Debug mask of new devices, shared by all driver source files
+extern ulong debug;
+
+// Per-CPU statistics update, safe from any context
+#define CavStatAdd(_context_, _stat_, _val_) \
+	this_cpu_add((_context_)->pStats->Counter[_stat_], (_val_))
+#define CavStatInc(_context_, _stat_) CavStatAdd(_context_, _stat_, 1)
+
+// Debug categories, bits of debug and DebugMask
+#define CAV_DBG_PROBE 0
+#define CAV_DBG_OPEN 1
+#define CAV_DBG_RX 2
+#define CAV_DBG_TX 3
+#define CAV_DBG_INT 4
+#define CAV_DBG_DATA 5
+#define CAV_DBG_CATEGORIES 6
+#define CAV_DBG_ALL (BIT(CAV_DBG_CATEGORIES) - 1)
+
+extern struct static_key_false CavDbgKeys[CAV_DBG_CATEGORIES];
+
+// True if debug output of a category is enabled for a device, a NULL
+// context uses the debug module parameter. Costs one patched branch while
+// no device has the category enabled.
+#define CavDbgOn(_context_, _cat_)                         \
+	(static_branch_unlikely(&CavDbgKeys[_cat_]) && \
+	 ((CavDbgMask(_context_) & BIT(_cat_)) != 0))
+
+extern struct static_key_false CavCaptureKey;
+
+// Record a URB event in the capture ring, free while no port captures
+#define CavCapture(_context_, _urb_, _event_, _status_, _data_, _len_)     \
+	do {                                                               \
+		if (static_branch_unlikely(&CavCaptureKey)) {              \
+			CavCaptureAdd(_context_, _urb_, _event_, _status_, \
+				      _data_, _len_);                      \
+		}                                                          \
+	} while (0)
+
+// Debug output, arguments are only evaluated when enabled
+#define CavDbg(_context_, _cat_, _format_, _arg_...)                   \
+	do {                                                           \
+		if (CavDbgOn(_context_, _cat_)) {                      \
+			printk(KERN_INFO "CavSerial::%s " _format_,    \
+			       __func__, ##_arg_);                     \
+		}                                                      \
+	} while (0)
+
+struct _cav_device_context;
+struct _cav_capture;
+struct _cav_at_broker;
+struct _cav_urc;
+
+typedef struct _cav_char_dev {
+	struct cdev *pCdev;
+	struct device *pDevice;
+	int Minor;
+	struct _cav_device_context *Context;
+} cav_char_dev;
+
+// Arrival of the data of one bulk-IN transfer in the GNSS ring
+typedef struct _cav_gnss_stamp {
+	u32 Start; // ring byte counter of the first byte
+	u32 Len;
+	ktime_t Time; // CLOCK_MONOTONIC at URB completion
+	ktime_t RealTime; // CLOCK_REALTIME at URB completion
+	u32 Frame; // USB frame number at URB completion
+} cav_gnss_stamp;
+
+typedef struct _cav_gnss_ring {
+	struct cav_gnss_ring_ctrl *pCtrl; // vmalloc_user, mapped by mmap
+	u32 Head; // authoritative head, published to pCtrl->head
+	unsigned char *pData;
+	unsigned int Size;
+	int Users;
+	int bFanout; // readers keep their own cursor, tail is ignored
+	spinlock_t Lock; // also the reader cursors and counters
+	wait_queue_head_t Wait;
+	struct list_head Readers;
+	cav_gnss_stamp *pStamps; // CAV_GNSS_STAMPS entries
+	u32 StampHead; // sequence number of the next stamp
+} cav_gnss_ring;
+
+// Open file of /dev/cavgnssN
+typedef struct _cav_gnss_reader {
+	struct list_head List;
+	struct _cav_device_context *Context;
+	struct mutex ReadLock;
+	u32 Cursor; // next byte returned by read()
+	u64 Bytes;
+	u64 Dropped; // bytes overwritten before this reader got them
+	bool bRecords; // read() returns struct cav_gnss_record
+	u32 StampCursor; // next stamp returned in record mode
+	u32 RecDropped; // records lost since the last one returned
+	pid_t Pid;
+	char Comm[TASK_COMM_LEN];
+} cav_gnss_reader;
+
+// Per-interface settings of a SKU, zero URB depth and buffer size use the
+// module parameters
+typedef struct _cav_intf_profile {
+	u8 Role; // CAV_ROLE_*
+	u8 RxUrbs;
+	u8 RxBufMps;
+	u8 TxUrbs;
+	u32 Quirks; // CAV_QUIRK_*
+} cav_intf_profile;
+
+typedef struct _cav_sku {
+	const char *Name;
+	cav_intf_profile Intf[CAV_SKU_MAX_INTF]; // by bInterfaceNumber
+} cav_sku;
+
+typedef struct _cav_push_stats {
+	unsigned long Wakeups;
+	u64 Bytes;
+	u64 ActiveNs; // time spent in this policy, current period excluded
+} cav_push_stats;
+
+typedef struct _cav_port_stats {
+	u64 Counter[CAV_STATS];
+	u64 Hist[CAV_HISTS][CAV_HIST_BUCKETS];
+} cav_port_stats;
+
+// Time of a write, the data ends before byte End of the write queue
+typedef struct _cav_tx_stamp {
+	u32 End;
+	ktime_t Time;
+} cav_tx_stamp;
 
 typedef struct _cav_device_context {
 	struct usb_serial *MySerial;
 	struct usb_serial_port *MyPort;
 	int InterfaceNumber;
+	const cav_sku *pSku;
+	const cav_intf_profile *pProfile;
 	int bInterruptPresent;
 	struct urb *pIntUrb; // usb_alloc_urb( 0, GFP_KERNEL );
 	int IntPipe;
@@ -58,19 +307,128 @@ typedef struct _cav_device_context {
 	int bDevRemoved;
 	char IntBuffer[CAV_INT_BUF_SIZE];
 	int IntErrCnt;
+	int IntLastStatus; // status of the last failed interrupt URB
+	unsigned int IntIntervalMs; // current polling interval
+	unsigned long IntLastJiffies; // last notification, 0 if none
+	unsigned long IntRecoveries; // delayed resubmissions after errors
+	struct delayed_work IntRetryWork;
+	ktime_t IntCompleteAt; // 0 once the URB is resubmitted
+	struct work_struct InitWork; // endpoint handshake of async_probe
+	struct completion InitDone;
+	int InitStatus; // result of the handshake, valid after InitDone
+	ktime_t ProbeAt;
+	unsigned int ReadyUs; // probe to end of the handshake
 	int OpenRefCount;
 	spinlock_t AccessLock;
+	struct urb *RxUrb[CAV_MAX_RX_URBS];
+	int RxUrbCount;
+	int RxBufSize;
+	unsigned long RxUrbsFree;
+	unsigned long RxFlags;
+	ktime_t RxSubmitAt[CAV_MAX_RX_URBS];
+	ktime_t RxCompleteAt; // last bulk-IN completion
+	spinlock_t PushLock; // flip buffer producer, Push* fields
+	struct hrtimer PushTimer;
+	int PushMode;
+	unsigned int PushLatencyUs;
+	unsigned int PushPending;
+	ktime_t PushPendingSince; // completion of the oldest pending data
+	ktime_t PushModeSince;
+	cav_push_stats PushStats[CAV_PUSH_MODES];
+	int RxOverflow; // CAV_RX_*, under PushLock
+	struct kfifo RxFifo; // drop-oldest backlog, under PushLock
+	struct kfifo TxFifo;
+	struct urb *TxUrb[CAV_MAX_TX_URBS];
+	int TxUrbCount;
+	int TxBufSize;
+	unsigned long TxUrbsFree;
+	unsigned int TxInFlight;
+	unsigned long TxFullCount;
+	cav_tx_stamp TxStamps[CAV_TX_STAMPS]; // under TxLock
+	u32 TxStampHead;
+	u32 TxStampTail;
+	u32 TxQueuedBytes; // byte counters of TxFifo, under TxLock
+	u32 TxTakenBytes;
+	ktime_t TxUrbStamp[CAV_MAX_TX_URBS]; // oldest write sent by each URB
+	spinlock_t TxLock; // also bSuspended, bResumeRequested
+	struct hrtimer TxTimer; // end of the coalescing window
+	unsigned int TxCoalesceUs; // zero sends every write right away
+	bool bTxHeld; // queued data waits for more writes
+	bool bTxFlush; // send held data now
+	ktime_t TxHeldSince;
+	unsigned long TxSaved; // writes merged into a held transfer
+	unsigned long TxHeldUrbs; // transfers sent after being held
+	u64 TxHeldNs; // latency added to them
+	u64 TxHeldMaxNs;
+	unsigned long TxCmdAt; // jiffies | 1 of the last command, 0 answered
+	int bSuspended;
+	int bResumeRequested; // holds an async autopm reference
+	ktime_t ResumeRequestedAt;
+	ktime_t SuspendedAt;
+	unsigned int ResumeLatencyUs;
+	unsigned int ResumeLatencyMaxUs;
+	struct kref Ref;
+	struct mutex OpenLock; // RxUsers, bDevRemoved
+	int RxUsers;
+	cav_char_dev GnssChar;
+	cav_gnss_ring *GnssRing;
+	cav_port_stats __percpu *pStats;
+	unsigned long LastRxJiffies; // 0 until the first bulk-IN data
+	struct work_struct RecoverWork;
+	unsigned long RecoverFlags; // CAV_RECOVER_* requests pending
+	ktime_t RecoverSince; // oldest pending request
+	unsigned int RecoverLatencyUs;
+	unsigned int RecoverLatencyMaxUs;
+	struct delayed_work RxWatchdogWork;
+	unsigned int RxWatchdogMs; // 0 disables the RX watchdog
+	unsigned long RxWatchSince; // jiffies, start of the silence
+	bool bRxRestarted; // watchdog restarted RX, no data since
+	struct dentry *pDebugfsDir;
+	struct _cav_capture *pCapture;
+	struct _cav_at_broker *pAtBroker;
+	struct _cav_urc *pUrc;
+	u16 SerialState; // last CDC SERIAL_STATE bitmap, IntCallback only
+	u16 LineCtrl; // CAV_SER_DTR/CAV_SER_RTS as last set
+	struct mutex ScriptLock;
+	char Script[CAV_SCRIPT_EVENTS][CAV_SCRIPT_MAX];
 	ulong DebugMask;
 	char PortName[CAV_PORT_NAME_LEN];
 } cav_device_context;
 
+static inline ulong CavDbgMask(const cav_device_context *context)
+{
+	return (context != NULL) ? READ_ONCE(context->DebugMask) :
+				   READ_ONCE(debug);
+}
+
+// Count a latency in a per-CPU histogram, safe from any context
+static inline void CavHistAdd(cav_device_context *context, int hist,
+			      ktime_t start, ktime_t end)
+{
+	s64 ns = ktime_to_ns(ktime_sub(end, start));
+	int bucket = 0;
+
+	if (ns > 1) {
+		bucket = min_t(int, ilog2(ns), CAV_HIST_BUCKETS - 1);
+	}
+	this_cpu_inc(context->pStats->Hist[hist][bucket]);
+}
+
 /*=========================================================================*/
 // Function Prototypes
 /*=========================================================================*/
 
-// Attach to correct interfaces
-static int CavProbe(struct usb_serial *pSerial,
-		     const struct usb_device_id *pID);
+// Exports the functions the KUnit suite (CavQMTest.c) calls, only in the
+// CAV_KUNIT=y build
+#ifdef CAV_KUNIT
+#include <kunit/visibility.h>
+#define CAV_KUNIT_EXPORT(_sym_) EXPORT_SYMBOL_IF_KUNIT(_sym_)
+
+// Replaces usb_submit_urb of the write engine while set (CavQMWrite.c)
+extern int (*CavTxSubmitHook)(struct urb *pURB);
+#else
+#define CAV_KUNIT_EXPORT(_sym_)
+#endif
 
 // Start GPS if GPS port, run usb_serial_generic_open
 #if (LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 26))
@@ -98,11 +456,6 @@ void IntCallback(struct urb *pIntUrb);
 int ResubmitIntURB(struct urb *pIntUrb);
 #endif
 
-#if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 25))
-// Read data from USB, push to TTY and user space
-static void CavReadBulkCallback(struct urb *pURB);
-#endif
-
 // Set reset_resume flag
 int CavSuspend(struct usb_interface *pIntf, pm_message_t powerEvent);
 #if (LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 23))
@@ -111,8 +464,161 @@ int CavResume(struct usb_interface *pIntf);
 #endif
 
 char *CavPort(cav_device_context *context, struct usb_serial_port *pPort);
-void CavSetDtrRts(cav_device_context *context, __u16 DtrRts);
-void PrintHex(void *Context, const unsigned char *pBuffer, int BufferSize,
-	      char *Tag);
+int CavSetDtrRts(cav_device_context *context, __u16 DtrRts);
+void CavContextGet(cav_device_context *context);
+void CavContextPut(cav_device_context *context);
+int CavWaitReady(cav_device_context *context);
+unsigned int CavIntRetryMs(int errCnt);
+// Debug dump of data, returns the number of bytes dumped
+int PrintHex(void *Context, const unsigned char *pBuffer, int BufferSize,
+	     char *Tag);
+
+// Bulk-IN read engine (CavQMRead.c)
+int CavRxAlloc(cav_device_context *context, struct usb_serial_port *pPort);
+void CavRxFree(cav_device_context *context);
+int CavRxStart(cav_device_context *context, gfp_t memFlags);
+void CavRxStop(cav_device_context *context);
+int CavRxGet(cav_device_context *context);
+void CavRxPut(cav_device_context *context);
+void CavRxSetPushMode(cav_device_context *context, int mode);
+const char *CavRxPushModeName(int mode);
+int CavRxSetOverflow(cav_device_context *context, int policy);
+const char *CavRxOverflowName(int policy);
+void CavThrottle(struct tty_struct *tty);
+void CavUnthrottle(struct tty_struct *tty);
+
+// Bulk-OUT write engine (CavQMWrite.c)
+int CavTxAlloc(cav_device_context *context, struct usb_serial_port *pPort);
+void CavTxFree(cav_device_context *context);
+void CavTxStop(cav_device_context *context);
+void CavTxKick(cav_device_context *context);
+void CavTxFlush(cav_device_context *context);
+int CavTxQueue(cav_device_context *context, const unsigned char *buf,
+	       int count);
+bool CavTxQueueAll(cav_device_context *context, const unsigned char *buf,
+		   int count);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 14, 0))
+unsigned int CavWriteRoom(struct tty_struct *tty);
+unsigned int CavCharsInBuffer(struct tty_struct *tty);
+#else
+int CavWriteRoom(struct tty_struct *tty);
+int CavCharsInBuffer(struct tty_struct *tty);
+#endif
+
+int CavPortProbe(struct usb_serial_port *pPort);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 12, 0))
+void CavPortRemove(struct usb_serial_port *pPort);
+#else
+int CavPortRemove(struct usb_serial_port *pPort);
+#endif
+
+// CDC serial state and modem lines (CavQMLine.c)
+void CavLineNotify(cav_device_context *context, const unsigned char *pData,
+		   int len);
+int CavTiocmGet(struct tty_struct *tty);
+int CavTiocmSet(struct tty_struct *tty, unsigned int set, unsigned int clear);
+
+// Runtime power management (CavQMPm.c)
+void CavPmInit(cav_device_context *context);
+void CavPmWake(cav_device_context *context);
+int CavPmSuspend(struct usb_serial *pSerial, pm_message_t powerEvent);
+int CavPmResume(struct usb_serial *pSerial);
+int CavPmResetResume(struct usb_serial *pSerial);
+
+// Per-port command scripts (CavQMScript.c)
+void CavScriptInit(cav_device_context *context);
+int CavScriptSet(cav_device_context *context, int event, const char *buf,
+		 size_t count);
+ssize_t CavScriptShow(cav_device_context *context, int event, char *buf);
+void CavScriptRun(cav_device_context *context, int event);
+
+// SKU profiles and USB ID table (CavQMProfile.c)
+extern const struct usb_device_id CavConfigVIDPIDTable[];
+const cav_intf_profile *CavProfileLookup(struct usb_interface *pIntf,
+					 const struct usb_device_id *pID,
+					 const cav_sku **ppSku);
+const char *CavRoleName(int role);
+
+// Per-port sysfs attributes (CavQMSysfs.c)
+int CavSysfsAdd(struct usb_serial_port *pPort);
+void CavSysfsRemove(struct usb_serial_port *pPort);
+
+// Debug masks and debugfs directories (CavQMDebug.c)
+void CavDbgSetMask(cav_device_context *context, ulong mask);
+void CavDebugfsInit(void);
+void CavDebugfsExit(void);
+void CavDebugfsAdd(cav_device_context *context);
+void CavDebugfsRemove(cav_device_context *context);
+#ifdef CONFIG_FAULT_INJECTION_DEBUG_FS
+bool CavFailIntUrb(void);
+#else
+static inline bool CavFailIntUrb(void)
+{
+	return false;
+}
+#endif
+
+// Traffic capture ring (CavQMCapture.c)
+void CavCaptureAdd(cav_device_context *context, struct urb *pURB, u8 event,
+		   int status, const void *pData, unsigned int len);
+void CavCaptureFree(cav_device_context *context);
+void CavCaptureDebugfsAdd(cav_device_context *context);
+
+// Per-port statistics (CavQMStats.c)
+int CavStatsAlloc(cav_device_context *context);
+void CavStatsFree(cav_device_context *context);
+void CavStatUrbError(cav_device_context *context, int status);
+u64 CavStatRead(cav_device_context *context, int stat);
+void CavStatsReset(cav_device_context *context);
+void CavHistDebugfsAdd(cav_device_context *context);
+
+// Stall and silent stream recovery (CavQMRecover.c)
+void CavRecoverInit(cav_device_context *context);
+void CavRecoverRequest(cav_device_context *context, int request);
+void CavRxWatch(cav_device_context *context);
+void CavRxSetWatchdog(cav_device_context *context, unsigned int ms);
+void CavRecoverStop(cav_device_context *context);
+
+// Companion character devices (CavQMChar.c)
+int CavCharInit(void);
+void CavCharExit(void);
+int CavCharAdd(cav_char_dev *pChar, cav_device_context *context,
+	       const struct file_operations *fops, const char *name);
+void CavCharRemove(cav_char_dev *pChar);
+cav_char_dev *CavCharOpen(struct inode *pInode);
+
+// GNSS mmap ring, /dev/cavgnssN (CavQMGnss.c)
+int CavGnssAdd(cav_device_context *context);
+void CavGnssRemove(cav_device_context *context);
+void CavGnssFree(cav_device_context *context);
+ssize_t CavGnssReadersShow(cav_device_context *context, char *buf);
+
+// AT command broker, /dev/cavatN (CavQMAt.c)
+int CavAtAdd(cav_device_context *context);
+void CavAtRemove(cav_device_context *context);
+void CavAtDisconnect(cav_device_context *context);
+void CavAtFree(cav_device_context *context);
+int CavAtRx(cav_device_context *context, const unsigned char *pData,
+	    int len);
+int CavAtFinal(const char *pLine, unsigned int len);
+bool CavAtBusy(cav_device_context *context);
+void CavAtTxRoom(cav_device_context *context);
+ssize_t CavAtStatsShow(cav_device_context *context, char *buf);
+
+// URC router, /dev/cavurcN (CavQMUrc.c)
+int CavUrcAdd(cav_device_context *context);
+void CavUrcRemove(cav_device_context *context);
+void CavUrcDisconnect(cav_device_context *context);
+void CavUrcFree(cav_device_context *context);
+bool CavUrcRx(cav_device_context *context, const unsigned char *pData,
+	      int len);
+void CavUrcCarrierLost(cav_device_context *context);
+ssize_t CavUrcPrefixesShow(cav_device_context *context, char *buf);
+int CavUrcPrefixesStore(cav_device_context *context, const char *buf);
+ssize_t CavUrcStatsShow(cav_device_context *context, char *buf);
+void CavRxDeliver(cav_device_context *context, const unsigned char *pData,
+		  int len);
+void CavGnssRx(cav_device_context *context, const unsigned char *pData,
+	       int len, ktime_t rxTime);
 
 #endif /* _CAV_QM_SER_H_ */
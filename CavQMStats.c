@@ -0,0 +1,293 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include "CavQMSerial.h"
+
+// Column names of the latency file, by CAV_HIST_*
+static const char * const CavHistNames[CAV_HISTS] = {
+	"rx_urb",
+	"rx_push",
+	"tx",
+	"int",
+};
+
+/*===========================================================================
+METHOD:
+   CavStatsAlloc
+
+DESCRIPTION:
+   Allocate the per-CPU statistics of a port
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavStatsAlloc(cav_device_context *context)
+{
+	context->pStats = alloc_percpu(cav_port_stats);
+	if (context->pStats == NULL) {
+		return -ENOMEM;
+	}
+	context->LastRxJiffies = 0;
+	return 0;
+} // CavStatsAlloc
+CAV_KUNIT_EXPORT(CavStatsAlloc);
+
+/*===========================================================================
+METHOD:
+   CavStatsFree
+
+DESCRIPTION:
+   Free the per-CPU statistics, called when the last context reference
+   is dropped
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavStatsFree(cav_device_context *context)
+{
+	free_percpu(context->pStats);
+	context->pStats = NULL;
+} // CavStatsFree
+CAV_KUNIT_EXPORT(CavStatsFree);
+
+/*===========================================================================
+METHOD:
+   CavStatUrbError
+
+DESCRIPTION:
+   Count a failed URB completion by status code. Unlinks (-ENOENT,
+   -ECONNRESET) and device removal (-ESHUTDOWN) are not errors.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   status:  [ I ] - URB status
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavStatUrbError(cav_device_context *context, int status)
+{
+	switch (status) {
+	case 0:
+	case -ENOENT:
+	case -ECONNRESET:
+	case -ESHUTDOWN:
+		break;
+	case -EPROTO:
+		CavStatInc(context, CAV_STAT_URB_EPROTO);
+		break;
+	case -EILSEQ:
+		CavStatInc(context, CAV_STAT_URB_EILSEQ);
+		break;
+	case -ETIME:
+		CavStatInc(context, CAV_STAT_URB_ETIME);
+		break;
+	case -EOVERFLOW:
+		CavStatInc(context, CAV_STAT_URB_EOVERFLOW);
+		break;
+	case -EPIPE:
+		CavStatInc(context, CAV_STAT_URB_EPIPE);
+		break;
+	default:
+		CavStatInc(context, CAV_STAT_URB_OTHER);
+		break;
+	}
+} // CavStatUrbError
+
+/*===========================================================================
+METHOD:
+   CavStatRead
+
+DESCRIPTION:
+   Sum a counter over all CPUs
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   stat:    [ I ] - CAV_STAT_* counter
+
+RETURN VALUE:
+   counter value
+===========================================================================*/
+u64 CavStatRead(cav_device_context *context, int stat)
+{
+	u64 sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		cav_port_stats *pStats = per_cpu_ptr(context->pStats, cpu);
+
+		sum += READ_ONCE(pStats->Counter[stat]);
+	}
+	return sum;
+} // CavStatRead
+CAV_KUNIT_EXPORT(CavStatRead);
+
+/*===========================================================================
+METHOD:
+   CavStatsReset
+
+DESCRIPTION:
+   Clear every counter. Updates racing with the reset on other CPUs may
+   survive it.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavStatsReset(cav_device_context *context)
+{
+	int cpu, stat;
+
+	for_each_possible_cpu(cpu) {
+		cav_port_stats *pStats = per_cpu_ptr(context->pStats, cpu);
+
+		for (stat = 0; stat < CAV_STATS; stat++) {
+			WRITE_ONCE(pStats->Counter[stat], 0);
+		}
+	}
+} // CavStatsReset
+
+/*===========================================================================
+METHOD:
+   CavHistShow
+
+DESCRIPTION:
+   Print the latency histograms of a port summed over all CPUs, one row
+   per bucket that is not empty in every histogram
+
+PARAMETERS:
+   pSeq:    [ I ] - seq_file of the latency file
+   pUnused: [ I ] - unused
+
+RETURN VALUE:
+   int - zero
+===========================================================================*/
+static int CavHistShow(struct seq_file *pSeq, void *pUnused)
+{
+	cav_device_context *context = pSeq->private;
+	u64 sum[CAV_HISTS];
+	int bucket, hist, cpu;
+	bool bEmpty;
+
+	seq_printf(pSeq, "%12s", "ns_from");
+	for (hist = 0; hist < CAV_HISTS; hist++) {
+		seq_printf(pSeq, " %10s", CavHistNames[hist]);
+	}
+	seq_putc(pSeq, '\n');
+
+	for (bucket = 0; bucket < CAV_HIST_BUCKETS; bucket++) {
+		bEmpty = true;
+		for (hist = 0; hist < CAV_HISTS; hist++) {
+			sum[hist] = 0;
+			for_each_possible_cpu(cpu) {
+				cav_port_stats *pStats =
+					per_cpu_ptr(context->pStats, cpu);
+
+				sum[hist] +=
+					READ_ONCE(pStats->Hist[hist][bucket]);
+			}
+			if (sum[hist] != 0) {
+				bEmpty = false;
+			}
+		}
+		if (bEmpty) {
+			continue;
+		}
+		// Bucket 0 also counts latencies below 1 ns
+		seq_printf(pSeq, "%12llu",
+			   (bucket == 0) ? 0ULL : BIT_ULL(bucket));
+		for (hist = 0; hist < CAV_HISTS; hist++) {
+			seq_printf(pSeq, " %10llu", sum[hist]);
+		}
+		seq_putc(pSeq, '\n');
+	}
+	return 0;
+} // CavHistShow
+
+static int CavHistOpen(struct inode *pInode, struct file *pFile)
+{
+	return single_open(pFile, CavHistShow, pInode->i_private);
+}
+
+/*===========================================================================
+METHOD:
+   CavHistWrite
+
+DESCRIPTION:
+   Writing anything to the latency file clears the histograms. Updates
+   racing with the reset on other CPUs may survive it.
+
+PARAMETERS:
+   pFile: [ I ] - latency file
+   pBuf:  [ I ] - ignored
+   count: [ I ] - number of bytes written
+   pPos:  [ I ] - ignored
+
+RETURN VALUE:
+   ssize_t - count
+===========================================================================*/
+static ssize_t CavHistWrite(struct file *pFile, const char __user *pBuf,
+			    size_t count, loff_t *pPos)
+{
+	struct seq_file *pSeq = pFile->private_data;
+	cav_device_context *context = pSeq->private;
+	int bucket, hist, cpu;
+
+	for_each_possible_cpu(cpu) {
+		cav_port_stats *pStats = per_cpu_ptr(context->pStats, cpu);
+
+		for (hist = 0; hist < CAV_HISTS; hist++) {
+			for (bucket = 0; bucket < CAV_HIST_BUCKETS; bucket++) {
+				WRITE_ONCE(pStats->Hist[hist][bucket], 0);
+			}
+		}
+	}
+	return count;
+} // CavHistWrite
+
+static const struct file_operations CavHistFops = {
+	.owner = THIS_MODULE,
+	.open = CavHistOpen,
+	.read = seq_read,
+	.write = CavHistWrite,
+	.release = single_release,
+	.llseek = seq_lseek,
+};
+
+/*===========================================================================
+METHOD:
+   CavHistDebugfsAdd
+
+DESCRIPTION:
+   Create the latency file in the debugfs directory of a port
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavHistDebugfsAdd(cav_device_context *context)
+{
+	debugfs_create_file("latency", S_IRUSR | S_IWUSR, context->pDebugfsDir,
+			    context, &CavHistFops);
+} // CavHistDebugfsAdd
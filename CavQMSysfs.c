@@ -0,0 +1,601 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include "CavQMSerial.h"
+
+/*===========================================================================
+METHOD:
+   CavDevContext
+
+DESCRIPTION:
+   Returns the private context of the serial port behind a sysfs device
+
+PARAMETERS:
+   dev: [ I ] - usb-serial port device
+
+RETURN VALUE:
+   private context for the serial device
+===========================================================================*/
+static cav_device_context *CavDevContext(struct device *dev)
+{
+	struct usb_serial_port *pPort = to_usb_serial_port(dev);
+
+	return (cav_device_context *)usb_get_serial_data(pPort->serial);
+} // CavDevContext
+
+static ssize_t tx_queue_full_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%lu\n", READ_ONCE(context->TxFullCount));
+}
+static DEVICE_ATTR_RO(tx_queue_full);
+
+static ssize_t tx_coalesce_us_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(context->TxCoalesceUs));
+}
+
+static ssize_t tx_coalesce_us_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	cav_device_context *context = CavDevContext(dev);
+	unsigned int window;
+
+	if ((kstrtouint(buf, 0, &window) != 0) ||
+	    (window > CAV_TX_COALESCE_US_MAX)) {
+		return -EINVAL;
+	}
+	WRITE_ONCE(context->TxCoalesceUs, window);
+	if (window == 0) {
+		CavTxFlush(context);
+	}
+	return count;
+}
+static DEVICE_ATTR_RW(tx_coalesce_us);
+
+// Writes merged into a held transfer and the latency the holding added
+static ssize_t tx_coalesce_stats_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+	unsigned long flags, saved, urbs;
+	u64 heldNs, maxNs, avgNs = 0;
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	saved = context->TxSaved;
+	urbs = context->TxHeldUrbs;
+	heldNs = context->TxHeldNs;
+	maxNs = context->TxHeldMaxNs;
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	if (urbs != 0) {
+		avgNs = div64_u64(heldNs, urbs);
+	}
+	return sprintf(buf,
+		       "saved=%lu held=%lu delay_us=%llu delay_max_us=%llu delay_avg_us=%llu\n",
+		       saved, urbs, div_u64(heldNs, NSEC_PER_USEC),
+		       div_u64(maxNs, NSEC_PER_USEC),
+		       div_u64(avgNs, NSEC_PER_USEC));
+}
+static DEVICE_ATTR_RO(tx_coalesce_stats);
+
+static ssize_t push_mode_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%s\n",
+		       CavRxPushModeName(READ_ONCE(context->PushMode)));
+}
+
+static ssize_t push_mode_store(struct device *dev,
+			       struct device_attribute *attr, const char *buf,
+			       size_t count)
+{
+	cav_device_context *context = CavDevContext(dev);
+	int mode;
+
+	for (mode = 0; mode < CAV_PUSH_MODES; mode++) {
+		if (sysfs_streq(buf, CavRxPushModeName(mode))) {
+			CavRxSetPushMode(context, mode);
+			return count;
+		}
+	}
+	return -EINVAL;
+}
+static DEVICE_ATTR_RW(push_mode);
+
+static ssize_t push_latency_us_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(context->PushLatencyUs));
+}
+
+static ssize_t push_latency_us_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	cav_device_context *context = CavDevContext(dev);
+	unsigned int latency;
+
+	if ((kstrtouint(buf, 0, &latency) != 0) || (latency == 0) ||
+	    (latency > CAV_PUSH_LATENCY_US_MAX)) {
+		return -EINVAL;
+	}
+	WRITE_ONCE(context->PushLatencyUs, latency);
+	return count;
+}
+static DEVICE_ATTR_RW(push_latency_us);
+
+static ssize_t rx_overflow_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%s\n",
+		       CavRxOverflowName(READ_ONCE(context->RxOverflow)));
+}
+
+static ssize_t rx_overflow_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	cav_device_context *context = CavDevContext(dev);
+	int policy, nRetval;
+
+	for (policy = 0; policy < CAV_RX_OVERFLOWS; policy++) {
+		if (sysfs_streq(buf, CavRxOverflowName(policy))) {
+			nRetval = CavRxSetOverflow(context, policy);
+			return (nRetval != 0) ? nRetval : count;
+		}
+	}
+	return -EINVAL;
+}
+static DEVICE_ATTR_RW(rx_overflow);
+
+// One line per policy: wakeups, bytes, time spent in the policy,
+// wakeups per second and average bytes per wakeup
+static ssize_t push_stats_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+	cav_push_stats stats[CAV_PUSH_MODES];
+	unsigned long flags;
+	ssize_t len = 0;
+	int mode;
+
+	spin_lock_irqsave(&context->PushLock, flags);
+	memcpy(stats, context->PushStats, sizeof(stats));
+	stats[context->PushMode].ActiveNs += ktime_to_ns(
+		ktime_sub(ktime_get(), context->PushModeSince));
+	spin_unlock_irqrestore(&context->PushLock, flags);
+
+	for (mode = 0; mode < CAV_PUSH_MODES; mode++) {
+		u64 activeMs = div_u64(stats[mode].ActiveNs, NSEC_PER_MSEC);
+		u64 perSec = 0, perWakeup = 0;
+
+		if (activeMs != 0) {
+			perSec = div64_u64((u64)stats[mode].Wakeups * 1000,
+					   activeMs);
+		}
+		if (stats[mode].Wakeups != 0) {
+			perWakeup = div64_u64(stats[mode].Bytes,
+					      stats[mode].Wakeups);
+		}
+		len += sprintf(buf + len,
+			       "%s wakeups=%lu bytes=%llu ms=%llu wakeups_per_sec=%llu bytes_per_wakeup=%llu\n",
+			       CavRxPushModeName(mode), stats[mode].Wakeups,
+			       stats[mode].Bytes, activeMs, perSec, perWakeup);
+	}
+	return len;
+}
+static DEVICE_ATTR_RO(push_stats);
+
+static ssize_t debug_mask_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "0x%lx\n", READ_ONCE(context->DebugMask));
+}
+
+static ssize_t debug_mask_store(struct device *dev,
+				struct device_attribute *attr, const char *buf,
+				size_t count)
+{
+	cav_device_context *context = CavDevContext(dev);
+	unsigned long mask;
+
+	if ((kstrtoul(buf, 0, &mask) != 0) || ((mask & ~CAV_DBG_ALL) != 0)) {
+		return -EINVAL;
+	}
+	CavDbgSetMask(context, mask);
+	return count;
+}
+static DEVICE_ATTR_RW(debug_mask);
+
+// Interrupt endpoint polling interval currently in use
+static ssize_t int_interval_ms_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(context->IntIntervalMs));
+}
+static DEVICE_ATTR_RO(int_interval_ms);
+
+// Delayed interrupt URB resubmissions after errors
+static ssize_t int_recoveries_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%lu\n", READ_ONCE(context->IntRecoveries));
+}
+static DEVICE_ATTR_RO(int_recoveries);
+
+// Silence in ms after which the read engine is restarted, and the device
+// reset if that did not help, 0 disables the watchdog
+static ssize_t rx_watchdog_ms_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(context->RxWatchdogMs));
+}
+
+static ssize_t rx_watchdog_ms_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned int ms;
+
+	if ((kstrtouint(buf, 0, &ms) != 0) || (ms > CAV_RX_WATCHDOG_MS_MAX)) {
+		return -EINVAL;
+	}
+	CavRxSetWatchdog(CavDevContext(dev), ms);
+	return count;
+}
+static DEVICE_ATTR_RW(rx_watchdog_ms);
+
+// SKU and role of the interface, e.g. "C10QM gnss"
+static ssize_t profile_show(struct device *dev, struct device_attribute *attr,
+			    char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%s %s\n", context->pSku->Name,
+		       CavRoleName(context->pProfile->Role));
+}
+static DEVICE_ATTR_RO(profile);
+
+// Microseconds from probe until the endpoints were ready, -1 while the
+// handshake of an asynchronous probe is pending
+static ssize_t ready_us_show(struct device *dev, struct device_attribute *attr,
+			     char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	if (completion_done(&context->InitDone) == false) {
+		return sprintf(buf, "-1\n");
+	}
+	return sprintf(buf, "%u\n", context->ReadyUs);
+}
+static DEVICE_ATTR_RO(ready_us);
+
+static ssize_t CavScriptAttrShow(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct dev_ext_attribute *pAttr =
+		container_of(attr, struct dev_ext_attribute, attr);
+
+	return CavScriptShow(CavDevContext(dev), (long)pAttr->var, buf);
+}
+
+static ssize_t CavScriptAttrStore(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct dev_ext_attribute *pAttr =
+		container_of(attr, struct dev_ext_attribute, attr);
+	int nRetval;
+
+	nRetval = CavScriptSet(CavDevContext(dev), (long)pAttr->var, buf,
+			       count);
+	return (nRetval != 0) ? nRetval : count;
+}
+
+// Commands queued on the bulk-OUT pipe on attach, open and close
+#define CAV_SCRIPT_ATTR(_name_, _event_)                                   \
+	static struct dev_ext_attribute dev_attr_##_name_ = {              \
+		__ATTR(_name_, S_IRUGO | S_IWUSR, CavScriptAttrShow,       \
+		       CavScriptAttrStore),                                \
+		(void *)(_event_)                                          \
+	}
+
+CAV_SCRIPT_ATTR(script_attach, CAV_SCRIPT_ATTACH);
+CAV_SCRIPT_ATTR(script_open, CAV_SCRIPT_OPEN);
+CAV_SCRIPT_ATTR(script_close, CAV_SCRIPT_CLOSE);
+
+// Readers of /dev/cavgnssN with their lag and drop counters
+static ssize_t gnss_readers_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	return CavGnssReadersShow(CavDevContext(dev), buf);
+}
+static DEVICE_ATTR_RO(gnss_readers);
+
+// Queue depth and round-trip times of the AT command broker
+static ssize_t at_broker_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	return CavAtStatsShow(CavDevContext(dev), buf);
+}
+static DEVICE_ATTR_RO(at_broker);
+
+// Prefix table of the URC router, comma separated
+static ssize_t urc_prefixes_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	return CavUrcPrefixesShow(CavDevContext(dev), buf);
+}
+
+static ssize_t urc_prefixes_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int nRetval = CavUrcPrefixesStore(CavDevContext(dev), buf);
+
+	return (nRetval != 0) ? nRetval : count;
+}
+static DEVICE_ATTR_RW(urc_prefixes);
+
+// URCs diverted and the listeners of /dev/cavurcN
+static ssize_t urc_stats_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	return CavUrcStatsShow(CavDevContext(dev), buf);
+}
+static DEVICE_ATTR_RO(urc_stats);
+
+static struct attribute *CavPortAttrs[] = {
+	&dev_attr_profile.attr,
+	&dev_attr_ready_us.attr,
+	&dev_attr_script_attach.attr.attr,
+	&dev_attr_script_open.attr.attr,
+	&dev_attr_script_close.attr.attr,
+	&dev_attr_gnss_readers.attr,
+	&dev_attr_at_broker.attr,
+	&dev_attr_urc_prefixes.attr,
+	&dev_attr_urc_stats.attr,
+	&dev_attr_tx_queue_full.attr,
+	&dev_attr_tx_coalesce_us.attr,
+	&dev_attr_tx_coalesce_stats.attr,
+	&dev_attr_push_mode.attr,
+	&dev_attr_push_latency_us.attr,
+	&dev_attr_push_stats.attr,
+	&dev_attr_rx_overflow.attr,
+	&dev_attr_debug_mask.attr,
+	&dev_attr_int_interval_ms.attr,
+	&dev_attr_int_recoveries.attr,
+	&dev_attr_rx_watchdog_ms.attr,
+	NULL
+};
+
+static const struct attribute_group CavPortAttrGroup = {
+	.attrs = CavPortAttrs,
+};
+
+static ssize_t CavStatShow(struct device *dev, struct device_attribute *attr,
+			   char *buf)
+{
+	struct dev_ext_attribute *pAttr =
+		container_of(attr, struct dev_ext_attribute, attr);
+
+	return sprintf(buf, "%llu\n",
+		       CavStatRead(CavDevContext(dev), (long)pAttr->var));
+}
+
+#define CAV_STAT_ATTR(_name_, _stat_)                                  \
+	static struct dev_ext_attribute dev_attr_##_name_ = {          \
+		__ATTR(_name_, S_IRUGO, CavStatShow, NULL), (void *)(_stat_) \
+	}
+
+CAV_STAT_ATTR(rx_bytes, CAV_STAT_RX_BYTES);
+CAV_STAT_ATTR(rx_urbs, CAV_STAT_RX_URBS);
+CAV_STAT_ATTR(tx_bytes, CAV_STAT_TX_BYTES);
+CAV_STAT_ATTR(tx_urbs, CAV_STAT_TX_URBS);
+CAV_STAT_ATTR(tx_dropped_bytes, CAV_STAT_TX_DROPPED);
+CAV_STAT_ATTR(urb_eproto, CAV_STAT_URB_EPROTO);
+CAV_STAT_ATTR(urb_eilseq, CAV_STAT_URB_EILSEQ);
+CAV_STAT_ATTR(urb_etime, CAV_STAT_URB_ETIME);
+CAV_STAT_ATTR(urb_eoverflow, CAV_STAT_URB_EOVERFLOW);
+CAV_STAT_ATTR(urb_epipe, CAV_STAT_URB_EPIPE);
+CAV_STAT_ATTR(urb_other, CAV_STAT_URB_OTHER);
+CAV_STAT_ATTR(int_eoverflow, CAV_STAT_INT_EOVERFLOW);
+CAV_STAT_ATTR(int_notifications, CAV_STAT_INT_NOTIFY);
+CAV_STAT_ATTR(tty_overruns, CAV_STAT_TTY_OVERRUNS);
+CAV_STAT_ATTR(tty_dropped_bytes, CAV_STAT_TTY_DROPPED);
+CAV_STAT_ATTR(rx_dropped_bytes, CAV_STAT_RX_DROPPED);
+CAV_STAT_ATTR(rx_dropped_lines, CAV_STAT_RX_DROPPED_LINES);
+CAV_STAT_ATTR(pm_suspends, CAV_STAT_PM_SUSPENDS);
+CAV_STAT_ATTR(pm_resumes, CAV_STAT_PM_RESUMES);
+CAV_STAT_ATTR(pm_reset_resumes, CAV_STAT_PM_RESET_RESUMES);
+CAV_STAT_ATTR(pm_wake_writes, CAV_STAT_PM_WAKE_WRITES);
+CAV_STAT_ATTR(pm_suspended_ms, CAV_STAT_PM_SUSPENDED_MS);
+CAV_STAT_ATTR(recover_halts, CAV_STAT_RECOVER_HALTS);
+CAV_STAT_ATTR(recover_watchdog, CAV_STAT_RECOVER_WATCHDOG);
+CAV_STAT_ATTR(recover_resets, CAV_STAT_RECOVER_RESETS);
+CAV_STAT_ATTR(recover_failed, CAV_STAT_RECOVER_FAILED);
+CAV_STAT_ATTR(recover_us, CAV_STAT_RECOVER_US);
+
+// Duration of the last resume in microseconds, from the write that
+// requested it when there was one
+static ssize_t pm_resume_latency_us_show(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(context->ResumeLatencyUs));
+}
+static DEVICE_ATTR_RO(pm_resume_latency_us);
+
+static ssize_t pm_resume_latency_max_us_show(struct device *dev,
+					     struct device_attribute *attr,
+					     char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(context->ResumeLatencyMaxUs));
+}
+static DEVICE_ATTR_RO(pm_resume_latency_max_us);
+
+// Duration of the last recovery in microseconds, from the fault to the
+// engine running again
+static ssize_t recover_latency_us_show(struct device *dev,
+				       struct device_attribute *attr,
+				       char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(context->RecoverLatencyUs));
+}
+static DEVICE_ATTR_RO(recover_latency_us);
+
+static ssize_t recover_latency_max_us_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(context->RecoverLatencyMaxUs));
+}
+static DEVICE_ATTR_RO(recover_latency_max_us);
+
+// Milliseconds since bulk-IN data was last received, -1 if never
+static ssize_t last_rx_ms_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	cav_device_context *context = CavDevContext(dev);
+	unsigned long last = READ_ONCE(context->LastRxJiffies);
+
+	if (last == 0) {
+		return sprintf(buf, "-1\n");
+	}
+	return sprintf(buf, "%u\n", jiffies_to_msecs(jiffies - last));
+}
+static DEVICE_ATTR_RO(last_rx_ms);
+
+// Any write clears the counters
+static ssize_t reset_store(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	cav_device_context *context = CavDevContext(dev);
+
+	CavStatsReset(context);
+	WRITE_ONCE(context->ResumeLatencyMaxUs, 0);
+	WRITE_ONCE(context->RecoverLatencyMaxUs, 0);
+	return count;
+}
+static DEVICE_ATTR_WO(reset);
+
+static struct attribute *CavStatAttrs[] = {
+	&dev_attr_rx_bytes.attr.attr,
+	&dev_attr_rx_urbs.attr.attr,
+	&dev_attr_tx_bytes.attr.attr,
+	&dev_attr_tx_urbs.attr.attr,
+	&dev_attr_tx_dropped_bytes.attr.attr,
+	&dev_attr_urb_eproto.attr.attr,
+	&dev_attr_urb_eilseq.attr.attr,
+	&dev_attr_urb_etime.attr.attr,
+	&dev_attr_urb_eoverflow.attr.attr,
+	&dev_attr_urb_epipe.attr.attr,
+	&dev_attr_urb_other.attr.attr,
+	&dev_attr_int_eoverflow.attr.attr,
+	&dev_attr_int_notifications.attr.attr,
+	&dev_attr_tty_overruns.attr.attr,
+	&dev_attr_tty_dropped_bytes.attr.attr,
+	&dev_attr_rx_dropped_bytes.attr.attr,
+	&dev_attr_rx_dropped_lines.attr.attr,
+	&dev_attr_pm_suspends.attr.attr,
+	&dev_attr_pm_resumes.attr.attr,
+	&dev_attr_pm_reset_resumes.attr.attr,
+	&dev_attr_pm_wake_writes.attr.attr,
+	&dev_attr_pm_suspended_ms.attr.attr,
+	&dev_attr_recover_halts.attr.attr,
+	&dev_attr_recover_watchdog.attr.attr,
+	&dev_attr_recover_resets.attr.attr,
+	&dev_attr_recover_failed.attr.attr,
+	&dev_attr_recover_us.attr.attr,
+	&dev_attr_pm_resume_latency_us.attr,
+	&dev_attr_pm_resume_latency_max_us.attr,
+	&dev_attr_recover_latency_us.attr,
+	&dev_attr_recover_latency_max_us.attr,
+	&dev_attr_last_rx_ms.attr,
+	&dev_attr_reset.attr,
+	NULL
+};
+
+static const struct attribute_group CavStatAttrGroup = {
+	.name = "statistics",
+	.attrs = CavStatAttrs,
+};
+
+static const struct attribute_group *CavPortAttrGroups[] = {
+	&CavPortAttrGroup,
+	&CavStatAttrGroup,
+	NULL
+};
+
+/*===========================================================================
+METHOD:
+   CavSysfsAdd
+
+DESCRIPTION:
+   Add the per-port sysfs attributes
+
+PARAMETERS:
+   pPort: [ I ] - serial port structure
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavSysfsAdd(struct usb_serial_port *pPort)
+{
+	return sysfs_create_groups(&pPort->dev.kobj, CavPortAttrGroups);
+} // CavSysfsAdd
+
+/*===========================================================================
+METHOD:
+   CavSysfsRemove
+
+DESCRIPTION:
+   Remove the per-port sysfs attributes
+
+PARAMETERS:
+   pPort: [ I ] - serial port structure
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavSysfsRemove(struct usb_serial_port *pPort)
+{
+	sysfs_remove_groups(&pPort->dev.kobj, CavPortAttrGroups);
+} // CavSysfsRemove
@@ -0,0 +1,645 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/pm_runtime.h>
+#include <linux/timex.h>
+#include <kunit/test.h>
+#include "CavQMSerial.h"
+
+// KUnit suite of the logic that runs without a modem, against fake USB
+// objects. Built into CavQMSerial_test.ko by "make kunit".
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0))
+#error "make kunit needs Linux 6.2 or later"
+#endif
+
+// Write microbenchmark, batches of calls timed as a whole
+#define CAV_TEST_BATCHES 32
+#define CAV_TEST_BATCH_CALLS 256
+#define CAV_TEST_WRITE_SIZE 32
+
+// Fake device with one C10QM AT interface and its serial port
+typedef struct _cav_test_dev {
+	struct usb_device Udev;
+	struct usb_host_interface Alt;
+	struct usb_interface Intf;
+	struct usb_serial Serial;
+	struct usb_serial_port Port;
+	struct tty_struct Tty;
+	cav_device_context *Context;
+	cav_device_context *Other; // second port, see CavTestBenchWrite
+} cav_test_dev;
+
+/*===========================================================================
+METHOD:
+   CavTestRelease
+
+DESCRIPTION:
+   Release of the fake interface device, the memory belongs to the test
+
+PARAMETERS:
+   pDev: [ I ] - device being released
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTestRelease(struct device *pDev)
+{
+} // CavTestRelease
+
+/*===========================================================================
+METHOD:
+   CavTestRetryWork
+
+DESCRIPTION:
+   Stands in for the interrupt retry work, the tests only check that it
+   was scheduled
+
+PARAMETERS:
+   pWork: [ I ] - IntRetryWork of the context
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTestRetryWork(struct work_struct *pWork)
+{
+} // CavTestRetryWork
+
+/*===========================================================================
+METHOD:
+   CavTestContext
+
+DESCRIPTION:
+   Allocate a context for the fake port the way CavProbe and CavAttach
+   do, without URBs. The bulk-OUT engine is set up if the port has a
+   bulk-OUT endpoint.
+
+PARAMETERS:
+   test: [ I ] - running test
+   pDev: [ I ] - fake device
+
+RETURN VALUE:
+   context, the test fails if it cannot be allocated
+===========================================================================*/
+static cav_device_context *CavTestContext(struct kunit *test,
+					  cav_test_dev *pDev)
+{
+	cav_device_context *context;
+
+	context = kzalloc(sizeof(cav_device_context), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, context);
+	context->InterfaceNumber = pDev->Alt.desc.bInterfaceNumber;
+	context->pProfile =
+		CavProfileLookup(&pDev->Intf, NULL, &context->pSku);
+	KUNIT_ASSERT_NOT_NULL(test, context->pProfile);
+	context->bDevClosed = 1;
+	context->MySerial = &pDev->Serial;
+	context->MyPort = &pDev->Port;
+	kref_init(&context->Ref);
+	mutex_init(&context->OpenLock);
+	spin_lock_init(&context->AccessLock);
+	INIT_DELAYED_WORK(&context->IntRetryWork, CavTestRetryWork);
+	CavRecoverInit(context);
+	init_completion(&context->InitDone);
+	complete_all(&context->InitDone);
+	CavScriptInit(context);
+	KUNIT_ASSERT_EQ(test, CavStatsAlloc(context), 0);
+	KUNIT_ASSERT_EQ(test, CavTxAlloc(context, &pDev->Port), 0);
+	return context;
+} // CavTestContext
+
+/*===========================================================================
+METHOD:
+   CavTestContextFree
+
+DESCRIPTION:
+   Free a context of CavTestContext
+
+PARAMETERS:
+   context: [ I ] - context, may be NULL
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTestContextFree(cav_device_context *context)
+{
+	if (context == NULL) {
+		return;
+	}
+	cancel_delayed_work_sync(&context->IntRetryWork);
+	usb_free_urb(context->pIntUrb);
+	CavDbgSetMask(context, 0);
+	CavTxFree(context);
+	CavStatsFree(context);
+	kfree(context);
+} // CavTestContextFree
+
+/*===========================================================================
+METHOD:
+   CavTestInit
+
+DESCRIPTION:
+   Build the fake device of a test: a high speed device, interface 2 of
+   the C10QM and an open ttyUSB0. The port has no bulk endpoints of its
+   own, so usb_serial_generic_open and close touch no URBs. The interface
+   is active with runtime PM disabled, as with power/control "on", and
+   holds the reference usb-serial keeps while the port is closed.
+
+PARAMETERS:
+   test: [ I ] - test about to run
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static int CavTestInit(struct kunit *test)
+{
+	cav_test_dev *pDev;
+
+	pDev = kunit_kzalloc(test, sizeof(cav_test_dev), GFP_KERNEL);
+	if (pDev == NULL) {
+		return -ENOMEM;
+	}
+	pDev->Udev.speed = USB_SPEED_HIGH;
+	device_initialize(&pDev->Udev.dev);
+	pDev->Udev.dev.release = CavTestRelease;
+	pDev->Alt.desc.bInterfaceNumber = C10QM_AT_INTF_NUM;
+	pDev->Intf.cur_altsetting = &pDev->Alt;
+	device_initialize(&pDev->Intf.dev);
+	pDev->Intf.dev.parent = &pDev->Udev.dev;
+	pDev->Intf.dev.release = CavTestRelease;
+	if (pm_runtime_set_active(&pDev->Intf.dev) != 0) {
+		put_device(&pDev->Intf.dev);
+		put_device(&pDev->Udev.dev);
+		return -EIO;
+	}
+	pm_runtime_get_noresume(&pDev->Intf.dev);
+	pDev->Serial.dev = &pDev->Udev;
+	pDev->Serial.interface = &pDev->Intf;
+	pDev->Port.serial = &pDev->Serial;
+	pDev->Port.port.tty = &pDev->Tty;
+	strscpy(pDev->Tty.name, "ttyUSB0", sizeof(pDev->Tty.name));
+
+	test->priv = pDev;
+	return 0;
+} // CavTestInit
+
+/*===========================================================================
+METHOD:
+   CavTestExit
+
+DESCRIPTION:
+   Tear down the fake device of a test
+
+PARAMETERS:
+   test: [ I ] - finished test
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTestExit(struct kunit *test)
+{
+	cav_test_dev *pDev = test->priv;
+
+	CavTxSubmitHook = NULL;
+	CavTestContextFree(pDev->Context);
+	CavTestContextFree(pDev->Other);
+	pm_runtime_put_noidle(&pDev->Intf.dev);
+	pm_runtime_set_suspended(&pDev->Intf.dev);
+	put_device(&pDev->Intf.dev);
+	put_device(&pDev->Udev.dev);
+} // CavTestExit
+
+/*===========================================================================
+METHOD:
+   CavTestExpectPmUsage
+
+DESCRIPTION:
+   Check the runtime PM usage count of the fake interface, nothing to
+   check without CONFIG_PM
+
+PARAMETERS:
+   test:     [ I ] - running test
+   expected: [ I ] - expected usage count
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTestExpectPmUsage(struct kunit *test, int expected)
+{
+#ifdef CONFIG_PM
+	cav_test_dev *pDev = test->priv;
+
+	KUNIT_EXPECT_EQ(test, atomic_read(&pDev->Intf.dev.power.usage_count),
+			expected);
+#endif
+} // CavTestExpectPmUsage
+
+// Bulk-OUT URBs accepted by CavTestSubmit
+static unsigned int CavTestSubmits;
+
+/*===========================================================================
+METHOD:
+   CavTestSubmit
+
+DESCRIPTION:
+   Stands in for usb_submit_urb of the write engine and accepts every
+   URB, CavTestTimeWrites then completes it the way CavTxCallback does
+
+PARAMETERS:
+   pURB: [ I ] - bulk-OUT URB
+
+RETURN VALUE:
+   int - zero
+===========================================================================*/
+static int CavTestSubmit(struct urb *pURB)
+{
+	CavTestSubmits++;
+	return 0;
+} // CavTestSubmit
+
+/*===========================================================================
+METHOD:
+   CavTestIntComplete
+
+DESCRIPTION:
+   Complete the interrupt URB with a status. The fake device refuses
+   submissions, so a resubmission only shows in the interval that
+   usb_fill_int_urb sets.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   status:  [ I ] - URB status
+
+RETURN VALUE:
+   bool - true if IntCallback resubmitted the URB at once
+===========================================================================*/
+static bool CavTestIntComplete(cav_device_context *context, int status)
+{
+	struct urb *pUrb = context->pIntUrb;
+
+	pUrb->status = status;
+	pUrb->actual_length = 0;
+	pUrb->interval = 0;
+	IntCallback(pUrb);
+	return pUrb->interval != 0;
+} // CavTestIntComplete
+
+/*===========================================================================
+METHOD:
+   CavTestIntSetup
+
+DESCRIPTION:
+   Give the context of a test an interrupt URB as CavOpen leaves it
+
+PARAMETERS:
+   test: [ I ] - running test
+
+RETURN VALUE:
+   context
+===========================================================================*/
+static cav_device_context *CavTestIntSetup(struct kunit *test)
+{
+	cav_test_dev *pDev = test->priv;
+	cav_device_context *context = CavTestContext(test, pDev);
+	struct urb *pUrb;
+
+	pDev->Context = context;
+	pUrb = usb_alloc_urb(0, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, pUrb);
+	usb_fill_int_urb(pUrb, &pDev->Udev, 0, context->IntBuffer,
+			 CAV_INT_BUF_SIZE, IntCallback, context, 1);
+	context->pIntUrb = pUrb;
+	context->bInterruptPresent = 1;
+	context->bDevClosed = 0;
+	return context;
+} // CavTestIntSetup
+
+// Interfaces with a role in the C10QM profile, dynamic IDs included
+static void CavTestProfileLookup(struct kunit *test)
+{
+	cav_test_dev *pDev = test->priv;
+	const cav_intf_profile *pProfile;
+	const cav_sku *pSku = NULL;
+	struct usb_device_id id = {};
+	int intf;
+
+	pProfile = CavProfileLookup(&pDev->Intf, NULL, &pSku);
+	KUNIT_ASSERT_NOT_NULL(test, pProfile);
+	KUNIT_ASSERT_NOT_NULL(test, pSku);
+	KUNIT_EXPECT_STREQ(test, pSku->Name, "C10QM");
+	KUNIT_EXPECT_EQ(test, pProfile->Role, CAV_ROLE_AT);
+
+	pDev->Alt.desc.bInterfaceNumber = C10QM_GNSS_INTF_NUM;
+	pProfile = CavProfileLookup(&pDev->Intf, &id, &pSku);
+	KUNIT_ASSERT_NOT_NULL(test, pProfile);
+	KUNIT_EXPECT_EQ(test, pProfile->Role, CAV_ROLE_GNSS);
+
+	for (intf = 0; intf < 256; intf++) {
+		if ((intf == C10QM_AT_INTF_NUM) ||
+		    (intf == C10QM_GNSS_INTF_NUM)) {
+			continue;
+		}
+		pDev->Alt.desc.bInterfaceNumber = intf;
+		KUNIT_EXPECT_NULL(test,
+				  CavProfileLookup(&pDev->Intf, NULL, &pSku));
+	}
+}
+
+// Name of the tty, then of the context, then CAV_ID_STR
+static void CavTestPortName(struct kunit *test)
+{
+	cav_test_dev *pDev = test->priv;
+	cav_device_context *context = CavTestContext(test, pDev);
+
+	pDev->Context = context;
+	KUNIT_EXPECT_STREQ(test, CavPort(NULL, NULL), CAV_ID_STR);
+	KUNIT_EXPECT_STREQ(test, CavPort(NULL, &pDev->Port), "ttyUSB0");
+	KUNIT_EXPECT_STREQ(test, CavPort(context, NULL), "ttyUSB0");
+
+	strscpy(context->PortName, "ttyUSB7", CAV_PORT_NAME_LEN);
+	KUNIT_EXPECT_STREQ(test, CavPort(context, NULL), "ttyUSB7");
+
+	pDev->Port.port.tty = NULL;
+	context->PortName[0] = 0;
+	KUNIT_EXPECT_STREQ(test, CavPort(NULL, &pDev->Port), CAV_ID_STR);
+	KUNIT_EXPECT_STREQ(test, CavPort(context, NULL), CAV_ID_STR);
+}
+
+// Nothing is dumped while the data category is off, then every length
+// is dumped in full up to the 298 bytes that fit the line buffer. Run
+// under KASAN for the buffer bounds.
+static void CavTestPrintHex(struct kunit *test)
+{
+	cav_test_dev *pDev = test->priv;
+	cav_device_context *context = CavTestContext(test, pDev);
+	static const int lengths[] = { -1, 0, 1, 297, 298, 299, 890, 896,
+				       4096 };
+	static const int dumped[] = { 0, 0, 1, 297, 298, 298, 298, 298, 298 };
+	unsigned char *pData;
+	int index;
+
+	pDev->Context = context;
+	pData = kunit_kzalloc(test, 4096, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, pData);
+	for (index = 0; index < 4096; index++) {
+		pData[index] = index;
+	}
+
+	for (index = 0; index < ARRAY_SIZE(lengths); index++) {
+		KUNIT_EXPECT_EQ(test,
+				PrintHex(context, pData, lengths[index],
+					 "TEST"),
+				0);
+	}
+	CavDbgSetMask(context, BIT(CAV_DBG_DATA));
+	for (index = 0; index < ARRAY_SIZE(lengths); index++) {
+		KUNIT_EXPECT_EQ_MSG(test,
+				    PrintHex(context, pData, lengths[index],
+					     "TEST"),
+				    dumped[index], "length %d",
+				    lengths[index]);
+	}
+	CavDbgSetMask(context, 0);
+}
+
+// Backoff of the delayed resubmission
+static void CavTestIntRetryMs(struct kunit *test)
+{
+	KUNIT_EXPECT_EQ(test, CavIntRetryMs(0), CAV_INT_RETRY_MS_MIN);
+	KUNIT_EXPECT_EQ(test, CavIntRetryMs(CAV_ERR_CNT_LIMIT + 1),
+			CAV_INT_RETRY_MS_MIN);
+	KUNIT_EXPECT_EQ(test, CavIntRetryMs(CAV_ERR_CNT_LIMIT + 2),
+			2 * CAV_INT_RETRY_MS_MIN);
+	KUNIT_EXPECT_EQ(test, CavIntRetryMs(CAV_ERR_CNT_LIMIT + 4),
+			8 * CAV_INT_RETRY_MS_MIN);
+	KUNIT_EXPECT_EQ(test, CavIntRetryMs(CAV_ERR_CNT_LIMIT + 100),
+			CAV_INT_RETRY_MS_MAX);
+	KUNIT_EXPECT_EQ(test, CavIntRetryMs(INT_MAX), CAV_INT_RETRY_MS_MAX);
+}
+
+// Notifications and EOVERFLOW resubmit, unlinks stop the URB
+static void CavTestIntStatus(struct kunit *test)
+{
+	cav_device_context *context = CavTestIntSetup(test);
+
+	KUNIT_EXPECT_TRUE(test, CavTestIntComplete(context, 0));
+	KUNIT_EXPECT_EQ(test, CavStatRead(context, CAV_STAT_INT_NOTIFY), 1);
+	KUNIT_EXPECT_TRUE(test, CavTestIntComplete(context, -EOVERFLOW));
+	KUNIT_EXPECT_EQ(test, CavStatRead(context, CAV_STAT_INT_EOVERFLOW), 1);
+	KUNIT_EXPECT_EQ(test, context->IntErrCnt, 0);
+
+	KUNIT_EXPECT_FALSE(test, CavTestIntComplete(context, -ENOENT));
+	KUNIT_EXPECT_FALSE(test, CavTestIntComplete(context, -ECONNRESET));
+	KUNIT_EXPECT_FALSE(test, CavTestIntComplete(context, -ESHUTDOWN));
+	KUNIT_EXPECT_EQ(test, context->IntErrCnt, 0);
+	KUNIT_EXPECT_FALSE(test, delayed_work_pending(&context->IntRetryWork));
+}
+
+// Errors resubmit at once up to CAV_ERR_CNT_LIMIT, then back off
+static void CavTestIntErrors(struct kunit *test)
+{
+	cav_device_context *context = CavTestIntSetup(test);
+	int count;
+
+	for (count = 1; count <= CAV_ERR_CNT_LIMIT; count++) {
+		KUNIT_EXPECT_TRUE(test, CavTestIntComplete(context, -EPROTO));
+		KUNIT_EXPECT_EQ(test, context->IntErrCnt, count);
+	}
+	KUNIT_EXPECT_FALSE(test, delayed_work_pending(&context->IntRetryWork));
+
+	KUNIT_EXPECT_FALSE(test, CavTestIntComplete(context, -EPROTO));
+	KUNIT_EXPECT_EQ(test, context->IntErrCnt, CAV_ERR_CNT_LIMIT + 1);
+	KUNIT_EXPECT_EQ(test, context->IntLastStatus, -EPROTO);
+	KUNIT_EXPECT_TRUE(test, delayed_work_pending(&context->IntRetryWork));
+	KUNIT_EXPECT_EQ(test, CavStatRead(context, CAV_STAT_URB_EPROTO),
+			CAV_ERR_CNT_LIMIT + 1);
+	cancel_delayed_work_sync(&context->IntRetryWork);
+
+	// A notification ends the error run
+	KUNIT_EXPECT_TRUE(test, CavTestIntComplete(context, 0));
+	KUNIT_EXPECT_EQ(test, context->IntErrCnt, 0);
+}
+
+// Nothing is resubmitted or scheduled once the port is closed
+static void CavTestIntClosed(struct kunit *test)
+{
+	cav_device_context *context = CavTestIntSetup(test);
+	int count;
+
+	context->bDevClosed = 1;
+	KUNIT_EXPECT_FALSE(test, CavTestIntComplete(context, 0));
+	for (count = 0; count <= CAV_ERR_CNT_LIMIT; count++) {
+		KUNIT_EXPECT_FALSE(test,
+				   CavTestIntComplete(context, -EPROTO));
+	}
+	KUNIT_EXPECT_FALSE(test, delayed_work_pending(&context->IntRetryWork));
+}
+
+// One open at a time, a failed open or a close gives the port back. An
+// open port drops the runtime PM reference of usb-serial, close takes it
+// again.
+static void CavTestOpenRefCount(struct kunit *test)
+{
+	cav_test_dev *pDev = test->priv;
+	cav_device_context *context = CavTestContext(test, pDev);
+
+	pDev->Context = context;
+	usb_set_serial_data(&pDev->Serial, context);
+	CavTestExpectPmUsage(test, 1);
+
+	KUNIT_ASSERT_EQ(test, CavOpen(&pDev->Tty, &pDev->Port), 0);
+	KUNIT_EXPECT_EQ(test, context->OpenRefCount, 1);
+	KUNIT_EXPECT_EQ(test, context->bDevClosed, 0);
+	KUNIT_EXPECT_STREQ(test, context->PortName, "ttyUSB0");
+	CavTestExpectPmUsage(test, 0);
+
+	KUNIT_EXPECT_EQ(test, CavOpen(&pDev->Tty, &pDev->Port), -EIO);
+	KUNIT_EXPECT_EQ(test, context->OpenRefCount, 1);
+	CavTestExpectPmUsage(test, 0);
+
+	CavClose(&pDev->Port);
+	KUNIT_EXPECT_EQ(test, context->OpenRefCount, 0);
+	KUNIT_EXPECT_EQ(test, context->bDevClosed, 1);
+	CavTestExpectPmUsage(test, 1);
+
+	KUNIT_ASSERT_EQ(test, CavOpen(&pDev->Tty, &pDev->Port), 0);
+	KUNIT_EXPECT_EQ(test, context->OpenRefCount, 1);
+	CavClose(&pDev->Port);
+	KUNIT_EXPECT_EQ(test, context->OpenRefCount, 0);
+	CavTestExpectPmUsage(test, 1);
+
+	// A failed endpoint handshake refuses the open
+	context->InitStatus = -EPROTO;
+	KUNIT_EXPECT_EQ(test, CavOpen(&pDev->Tty, &pDev->Port), -EPROTO);
+	KUNIT_EXPECT_EQ(test, context->OpenRefCount, 0);
+	CavTestExpectPmUsage(test, 1);
+}
+
+/*===========================================================================
+METHOD:
+   CavTestTimeWrites
+
+DESCRIPTION:
+   Time CAV_TEST_BATCHES batches of CAV_TEST_BATCH_CALLS CavWrite calls.
+   The write queue is emptied between batches. Before every call the
+   URBs CavTestSubmit accepted are completed, without the TTY wakeup of
+   CavTxCallback.
+
+PARAMETERS:
+   test:     [ I ] - running test
+   pLabel:   [ I ] - name of the measurement in the test log
+   urbsFree: [ I ] - TxUrbsFree before every call
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTestTimeWrites(struct kunit *test, const char *pLabel,
+			      unsigned long urbsFree)
+{
+	cav_test_dev *pDev = test->priv;
+	cav_device_context *context = pDev->Context;
+	unsigned char buf[CAV_TEST_WRITE_SIZE];
+	u64 minCycles = U64_MAX, minNs = U64_MAX;
+	cycles_t startCycles;
+	u64 startNs;
+	int batch, call;
+
+	memset(buf, 'A', sizeof(buf));
+	for (batch = 0; batch < CAV_TEST_BATCHES; batch++) {
+		kfifo_reset(&context->TxFifo);
+		startNs = ktime_get_ns();
+		startCycles = get_cycles();
+		for (call = 0; call < CAV_TEST_BATCH_CALLS; call++) {
+			context->TxUrbsFree = urbsFree;
+			context->TxInFlight = 0;
+			CavWrite(&pDev->Tty, &pDev->Port, buf, sizeof(buf));
+		}
+		minCycles = min_t(u64, minCycles, get_cycles() - startCycles);
+		minNs = min_t(u64, minNs, ktime_get_ns() - startNs);
+	}
+	kunit_info(test, "%-28s %6llu cycles %6llu ns per call\n", pLabel,
+		   minCycles / CAV_TEST_BATCH_CALLS,
+		   minNs / CAV_TEST_BATCH_CALLS);
+} // CavTestTimeWrites
+
+// Cost of a 32 byte CavWrite, the best batch of each measurement. With
+// every URB busy the data is only queued, with one idle URB it is also
+// moved into the URB and submitted to CavTestSubmit, which accepts it
+// without doing I/O. Diagnostics are the debug categories, enabled on
+// this port or only on another port (patched static keys).
+static void CavTestBenchWrite(struct kunit *test)
+{
+	cav_test_dev *pDev = test->priv;
+	cav_device_context *context;
+	unsigned long allFree;
+
+	pDev->Port.bulk_out_size = 512;
+	pDev->Port.bulk_out_endpointAddress = 0x01;
+	context = CavTestContext(test, pDev);
+	pDev->Context = context;
+	pDev->Other = CavTestContext(test, pDev);
+	usb_set_serial_data(&pDev->Serial, context);
+	KUNIT_ASSERT_GT(test, context->TxUrbCount, 0);
+	allFree = context->TxUrbsFree;
+
+	CavTestTimeWrites(test, "queue", 0);
+	CavDbgSetMask(pDev->Other, CAV_DBG_ALL);
+	CavTestTimeWrites(test, "queue, other port debug", 0);
+	CavDbgSetMask(context, CAV_DBG_ALL);
+	CavTestTimeWrites(test, "queue, debug", 0);
+	CavDbgSetMask(context, 0);
+	CavDbgSetMask(pDev->Other, 0);
+
+	CavTxSubmitHook = CavTestSubmit;
+	CavTestSubmits = 0;
+	CavTestTimeWrites(test, "queue+submit", BIT(0));
+	CavDbgSetMask(pDev->Other, CAV_DBG_ALL);
+	CavTestTimeWrites(test, "queue+submit, other port debug", BIT(0));
+	CavDbgSetMask(pDev->Other, 0);
+	CavTxSubmitHook = NULL;
+
+	// Every call was submitted, none took the submit failure path
+	KUNIT_EXPECT_EQ(test, CavTestSubmits,
+			2 * CAV_TEST_BATCHES * CAV_TEST_BATCH_CALLS);
+	KUNIT_EXPECT_EQ(test, CavStatRead(context, CAV_STAT_TX_DROPPED), 0);
+	context->TxUrbsFree = allFree;
+	context->TxInFlight = 0;
+}
+
+static struct kunit_case CavTestCases[] = {
+	KUNIT_CASE(CavTestProfileLookup),
+	KUNIT_CASE(CavTestPortName),
+	KUNIT_CASE(CavTestPrintHex),
+	KUNIT_CASE(CavTestIntRetryMs),
+	KUNIT_CASE(CavTestIntStatus),
+	KUNIT_CASE(CavTestIntErrors),
+	KUNIT_CASE(CavTestIntClosed),
+	KUNIT_CASE(CavTestOpenRefCount),
+	KUNIT_CASE(CavTestBenchWrite),
+	{}
+};
+
+static struct kunit_suite CavTestSuite = {
+	.name = "CavQMSerial",
+	.init = CavTestInit,
+	.exit = CavTestExit,
+	.test_cases = CavTestCases,
+};
+kunit_test_suite(CavTestSuite);
+
+MODULE_AUTHOR(DRIVER_AUTHOR);
+MODULE_DESCRIPTION(DRIVER_DESC " KUnit tests");
+MODULE_LICENSE("Dual BSD/GPL");
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0))
+MODULE_IMPORT_NS("EXPORTED_FOR_KUNIT_TESTING");
+#else
+MODULE_IMPORT_NS(EXPORTED_FOR_KUNIT_TESTING);
+#endif
@@ -0,0 +1,133 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cavqm
+
+#if !defined(_CAV_QM_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _CAV_QM_TRACE_H_
+
+//---------------------------------------------------------------------------
+// Tracepoints, enable with
+//    echo 1 > /sys/kernel/tracing/events/cavqm/enable
+// or record with perf record -e 'cavqm:*'
+//
+// minor is the ttyUSB number of the port
+//---------------------------------------------------------------------------
+#include <linux/tracepoint.h>
+#include <linux/usb.h>
+
+DECLARE_EVENT_CLASS(cav_urb,
+	TP_PROTO(int minor, struct urb *pURB, int status),
+	TP_ARGS(minor, pURB, status),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(const void *, urb)
+		__field(u8, ep)
+		__field(u32, length)
+		__field(int, status)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->urb = pURB;
+		__entry->ep = usb_pipeendpoint(pURB->pipe) |
+			      (usb_pipein(pURB->pipe) ? USB_DIR_IN : 0);
+		__entry->length = status == 0 && pURB->actual_length != 0 ?
+					  pURB->actual_length :
+					  pURB->transfer_buffer_length;
+		__entry->status = status;
+	),
+	TP_printk("ttyUSB%d urb=%p ep=%02x len=%u status=%d", __entry->minor,
+		  __entry->urb, __entry->ep, __entry->length, __entry->status)
+);
+
+// URB handed to the host controller, status is the usb_submit_urb result
+DEFINE_EVENT(cav_urb, cav_urb_submit,
+	TP_PROTO(int minor, struct urb *pURB, int status),
+	TP_ARGS(minor, pURB, status)
+);
+
+// URB completion, len is actual_length on success
+DEFINE_EVENT(cav_urb, cav_urb_complete,
+	TP_PROTO(int minor, struct urb *pURB, int status),
+	TP_ARGS(minor, pURB, status)
+);
+
+TRACE_EVENT(cav_open,
+	TP_PROTO(int minor, int status),
+	TP_ARGS(minor, status),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(int, status)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->status = status;
+	),
+	TP_printk("ttyUSB%d status=%d", __entry->minor, __entry->status)
+);
+
+TRACE_EVENT(cav_close,
+	TP_PROTO(int minor),
+	TP_ARGS(minor),
+	TP_STRUCT__entry(
+		__field(int, minor)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+	),
+	TP_printk("ttyUSB%d", __entry->minor)
+);
+
+TRACE_EVENT(cav_dtr_rts,
+	TP_PROTO(int minor, u16 value, int result),
+	TP_ARGS(minor, value, result),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(u16, value)
+		__field(int, result)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->value = value;
+		__entry->result = result;
+	),
+	TP_printk("ttyUSB%d dtr=%d rts=%d result=%d", __entry->minor,
+		  !!(__entry->value & 0x01), !!(__entry->value & 0x02),
+		  __entry->result)
+);
+
+// Interrupt endpoint completion, notification and value are taken from
+// the CDC notification header when the device sent one
+TRACE_EVENT(cav_int_notify,
+	TP_PROTO(int minor, struct urb *pURB),
+	TP_ARGS(minor, pURB),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(int, status)
+		__field(u32, length)
+		__field(u8, notification)
+		__field(u16, value)
+	),
+	TP_fast_assign(
+		const u8 *pData = pURB->transfer_buffer;
+
+		__entry->minor = minor;
+		__entry->status = pURB->status;
+		__entry->length = pURB->actual_length;
+		__entry->notification =
+			pURB->actual_length >= 2 ? pData[1] : 0;
+		__entry->value = pURB->actual_length >= 10 ?
+					 (pData[9] << 8) | pData[8] :
+					 0;
+	),
+	TP_printk("ttyUSB%d status=%d len=%u notification=%02x value=%04x",
+		  __entry->minor, __entry->status, __entry->length,
+		  __entry->notification, __entry->value)
+);
+
+#endif /* _CAV_QM_TRACE_H_ */
+
+// This part must be outside the header guard
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE CavQMTrace
+#include <trace/define_trace.h>
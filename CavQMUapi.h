@@ -0,0 +1,106 @@
+#ifndef _CAV_QM_UAPI_H_
+#define _CAV_QM_UAPI_H_
+
+//---------------------------------------------------------------------------
+// Interface shared with user space applications
+//---------------------------------------------------------------------------
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+// GNSS ring buffer, /dev/cavgnssN
+//
+// mmap() the device from offset 0 with a length of
+// data_offset + data_size. The first page holds struct cav_gnss_ring_ctrl,
+// the received NMEA stream follows at data_offset.
+//
+// head and tail are free running byte counters, the data of byte N is at
+// data_offset + (N & (data_size - 1)). The driver only advances head,
+// the application only advances tail. poll() reports POLLIN while
+// head != tail.
+//
+// With CAV_GNSS_RING_FANOUT set in flags the driver ignores tail and
+// overwrites the oldest data, every reader keeps its own cursor and the
+// mapping must be read-only (PROT_READ). read()
+// returns the data after the cursor of the file and poll() reports POLLIN
+// while there is some. Readers of the mapping lost data when
+// head - cursor > data_size.
+#define CAV_GNSS_RING_MAGIC 0x47564143 // "CAVG"
+#define CAV_GNSS_RING_VERSION 1
+#define CAV_GNSS_RING_FANOUT 0x00000001
+
+struct cav_gnss_ring_ctrl {
+	__u32 magic;
+	__u32 version;
+	__u32 data_offset;
+	__u32 data_size;
+	__u32 overruns; // bytes dropped while the ring was full
+	__u32 flags; // CAV_GNSS_RING_*
+	__u32 reserved0[10];
+
+	// Written by the driver, own cache line
+	__u32 head;
+	__u32 reserved1[15];
+
+	// Written by the application, own cache line
+	__u32 tail;
+	__u32 reserved2[15];
+};
+
+// AT command broker, /dev/cavatN
+//
+// Every open file is a client with at most one command in progress.
+// write() queues one AT command, read() blocks until its final result
+// code and returns the response lines. Commands of all clients are sent
+// to the modem one at a time, in the order they were written.
+#define CAV_AT_NONE 0
+#define CAV_AT_OK 1 // OK or CONNECT
+#define CAV_AT_ERROR 2 // ERROR, +CME ERROR, +CMS ERROR, NO CARRIER, ...
+#define CAV_AT_TIMEOUT 3
+
+struct cav_at_result {
+	__u32 status; // CAV_AT_*
+	__u32 rtt_us; // sent to final result code
+	__u32 queue_us; // written to sent
+	__u32 resp_len;
+};
+
+#define CAV_IOC_MAGIC 'C'
+// Timeout of the next commands of this file in ms, __u32
+#define CAV_AT_IOC_SET_TIMEOUT _IOW(CAV_IOC_MAGIC, 1, __u32)
+// Result of the last completed command of this file
+#define CAV_AT_IOC_GET_RESULT _IOR(CAV_IOC_MAGIC, 2, struct cav_at_result)
+
+// GNSS record read mode. After CAV_GNSS_IOC_SET_RECORDS with a nonzero
+// argument, read() on a fan-out /dev/cavgnssN returns one record per
+// bulk-IN transfer: the header below, len data bytes, then padding to a
+// multiple of 8 bytes. Only whole records are returned, except when the
+// first one does not fit; it is then cut and CAV_GNSS_REC_TRUNCATED set.
+#define CAV_GNSS_REC_TRUNCATED 0x00000001
+
+struct cav_gnss_record {
+	__u64 time_ns; // CLOCK_MONOTONIC at URB completion
+	__u64 real_ns; // CLOCK_REALTIME at URB completion
+	__u32 frame; // USB frame number at URB completion
+	__u32 len; // data bytes following the header
+	__u32 flags; // CAV_GNSS_REC_*
+	__u32 dropped; // records lost just before this one
+};
+
+// __u32, nonzero selects record mode for this file
+#define CAV_GNSS_IOC_SET_RECORDS _IOW(CAV_IOC_MAGIC, 3, __u32)
+
+// /dev/cavurcN: read() returns whole records, one per unsolicited result
+// code line, without the line terminator. seq counts the URCs of the port
+// and shows the events a slow reader lost.
+#define CAV_URC_TEXT_MAX 240
+#define CAV_URC_EVENTS 64 // kept per port, power of two
+
+struct cav_urc_event {
+	__u64 time_ns; // CLOCK_MONOTONIC when the line started
+	__u32 seq;
+	__u16 len;
+	__u16 reserved;
+	char text[CAV_URC_TEXT_MAX]; // not NUL terminated
+};
+
+#endif /* _CAV_QM_UAPI_H_ */
@@ -0,0 +1,822 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/kfifo.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/ctype.h>
+#include "CavQMSerial.h"
+#include "CavQMUapi.h"
+
+// Create /dev/cavurcN next to the AT ttyUSB node
+static bool urc_cdev;
+
+// Initial prefix table of new ports, comma separated
+static char *urc_prefixes = CAV_URC_PREFIXES_DEFAULT;
+
+// Line classifier states
+#define CAV_URC_LINE_START 0 // matching the start of a line
+#define CAV_URC_PASS 1 // rest of a line that is not a URC
+#define CAV_URC_EVENT 2 // rest of a URC line
+
+// Open file of /dev/cavurcN
+typedef struct _cav_urc_reader {
+	struct list_head List;
+	struct _cav_urc *pUrc;
+	struct mutex ReadLock;
+	u32 Cursor; // sequence number of the next event returned by read()
+	u64 Dropped; // events overwritten before this reader got them
+} cav_urc_reader;
+
+typedef struct _cav_urc {
+	cav_device_context *Context;
+	cav_char_dev Char;
+	spinlock_t Lock; // everything below
+	wait_queue_head_t Wait;
+	struct list_head Readers;
+	int Users; // diverting only while someone listens
+	int NumPrefixes;
+	char Prefix[CAV_URC_PREFIXES][CAV_URC_PREFIX_MAX];
+	u8 PrefixLen[CAV_URC_PREFIXES];
+	int State;
+	bool bSkipLf; // swallow the LF after the CR ending a URC
+	bool bDataMode; // after CONNECT, until NO CARRIER or DCD drops
+	unsigned int WatchLen; // length of the line being received
+	char Watch[CAV_URC_WATCH_MAX]; // its start
+	unsigned int PendingLen; // line start held back while it may match
+	char Pending[CAV_URC_PREFIX_MAX];
+	struct cav_urc_event Event; // URC being received
+	u32 Head; // sequence number of the next event
+	u64 Matched;
+	struct cav_urc_event Events[CAV_URC_EVENTS];
+} cav_urc;
+
+/*===========================================================================
+METHOD:
+   CavUrcParse
+
+DESCRIPTION:
+   Replace the prefix table from a comma separated list. Called with the
+   URC lock held.
+
+PARAMETERS:
+   pUrc: [ I ] - URC router of the port
+   buf:  [ I ] - prefix list, blanks around the prefixes are ignored
+
+RETURN VALUE:
+   int - zero for success
+       - -EINVAL for too many or too long prefixes
+===========================================================================*/
+static int CavUrcParse(cav_urc *pUrc, const char *buf)
+{
+	char prefix[CAV_URC_PREFIXES][CAV_URC_PREFIX_MAX];
+	u8 prefixLen[CAV_URC_PREFIXES];
+	const char *pEnd;
+	int count = 0;
+	size_t len;
+
+	while (*buf != 0) {
+		buf = skip_spaces(buf);
+		pEnd = strchrnul(buf, ',');
+		len = pEnd - buf;
+		while ((len > 0) && isspace(buf[len - 1])) {
+			len--;
+		}
+		if (len > 0) {
+			if ((count == CAV_URC_PREFIXES) ||
+			    (len >= CAV_URC_PREFIX_MAX)) {
+				return -EINVAL;
+			}
+			memcpy(prefix[count], buf, len);
+			prefixLen[count++] = len;
+		}
+		buf = (*pEnd == ',') ? pEnd + 1 : pEnd;
+	}
+
+	memcpy(pUrc->Prefix, prefix, sizeof(prefix));
+	memcpy(pUrc->PrefixLen, prefixLen, sizeof(prefixLen));
+	pUrc->NumPrefixes = count;
+	return 0;
+} // CavUrcParse
+
+/*===========================================================================
+METHOD:
+   CavUrcMatch
+
+DESCRIPTION:
+   Match the start of a line against the prefix table
+
+PARAMETERS:
+   pUrc: [ I ] - URC router of the port
+
+RETURN VALUE:
+   int - 1 if the line starts with a prefix
+       - 0 if it may still do so
+       - -1 if it does not
+===========================================================================*/
+static int CavUrcMatch(cav_urc *pUrc)
+{
+	unsigned int len = pUrc->PendingLen;
+	int index, nRetval = -1;
+
+	for (index = 0; index < pUrc->NumPrefixes; index++) {
+		if (memcmp(pUrc->Pending, pUrc->Prefix[index],
+			   min_t(unsigned int, len, pUrc->PrefixLen[index])) !=
+		    0) {
+			continue;
+		}
+		if (len >= pUrc->PrefixLen[index]) {
+			return 1;
+		}
+		nRetval = 0;
+	}
+	return nRetval;
+} // CavUrcMatch
+
+/*===========================================================================
+METHOD:
+   CavUrcPost
+
+DESCRIPTION:
+   Add the URC just received to the event ring and wake up the listeners.
+   Called with the URC lock held.
+
+PARAMETERS:
+   pUrc: [ I ] - URC router of the port
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavUrcPost(cav_urc *pUrc)
+{
+	struct cav_urc_event *pEvent =
+		&pUrc->Events[pUrc->Head & (CAV_URC_EVENTS - 1)];
+
+	pUrc->Event.seq = pUrc->Head++;
+	*pEvent = pUrc->Event;
+	pUrc->Matched++;
+	wake_up_interruptible(&pUrc->Wait);
+} // CavUrcPost
+
+/*===========================================================================
+METHOD:
+   CavUrcWatch
+
+DESCRIPTION:
+   Follow the result codes in received AT data, whether or not anyone
+   listens. A final result code answers the last command written, CONNECT
+   enters data mode and NO CARRIER leaves it. Called with the URC lock
+   held.
+
+PARAMETERS:
+   pUrc: [ I ] - URC router of the port
+   ch:   [ I ] - received character
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavUrcWatch(cav_urc *pUrc, char ch)
+{
+	unsigned int len = pUrc->WatchLen;
+	int final;
+
+	if ((ch != '\r') && (ch != '\n')) {
+		if (len < CAV_URC_WATCH_MAX - 1) {
+			pUrc->Watch[len] = ch;
+		}
+		if (len < CAV_URC_WATCH_MAX) {
+			pUrc->WatchLen++;
+		}
+		return;
+	}
+	if (len == 0) {
+		return;
+	}
+	pUrc->WatchLen = 0;
+	pUrc->Watch[min_t(unsigned int, len, CAV_URC_WATCH_MAX - 1)] = 0;
+
+	if (pUrc->bDataMode) {
+		if (strcmp(pUrc->Watch, "NO CARRIER") == 0) {
+			pUrc->bDataMode = false;
+			WRITE_ONCE(pUrc->Context->TxCmdAt, 0);
+		}
+		return;
+	}
+	final = CavAtFinal(pUrc->Watch, len);
+	if (final == 0) {
+		return;
+	}
+	WRITE_ONCE(pUrc->Context->TxCmdAt, 0);
+	if ((final == CAV_AT_OK) && (len >= 7) &&
+	    (memcmp(pUrc->Watch, "CONNECT", 7) == 0)) {
+		pUrc->bDataMode = true;
+	}
+} // CavUrcWatch
+
+/*===========================================================================
+METHOD:
+   CavUrcBusy
+
+DESCRIPTION:
+   Check whether a line may be the response to a command or data of a
+   connection, neither is classified. Called with the URC lock held.
+
+PARAMETERS:
+   pUrc: [ I ] - URC router of the port
+
+RETURN VALUE:
+   bool - true to pass the line on untouched
+===========================================================================*/
+static bool CavUrcBusy(cav_urc *pUrc)
+{
+	cav_device_context *context = pUrc->Context;
+	unsigned long cmdAt = READ_ONCE(context->TxCmdAt);
+
+	if (pUrc->bDataMode || CavAtBusy(context)) {
+		return true;
+	}
+	// A command that never got an answer stops counting after the
+	// default broker timeout
+	return (cmdAt != 0) &&
+	       time_before(jiffies,
+			   cmdAt + msecs_to_jiffies(CAV_AT_TIMEOUT_MS_DEFAULT));
+} // CavUrcBusy
+
+/*===========================================================================
+METHOD:
+   CavUrcRx
+
+DESCRIPTION:
+   Classify received AT data line by line. Lines starting with a prefix
+   of the table become events of /dev/cavurcN, everything else is passed
+   on to the AT broker and the TTY. The start of a line is held back
+   until it is known not to be a URC. Lines received while a command
+   waits for its final result code or in data mode are not classified.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pData:   [ I ] - received data
+   len:     [ I ] - number of bytes received
+
+RETURN VALUE:
+   bool - false if the data was not looked at, the caller delivers it
+===========================================================================*/
+bool CavUrcRx(cav_device_context *context, const unsigned char *pData,
+	      int len)
+{
+	cav_urc *pUrc = context->pUrc;
+	unsigned long flags;
+	int index, run = 0;
+	char ch;
+
+	if (pUrc == NULL) {
+		return false;
+	}
+
+	spin_lock_irqsave(&pUrc->Lock, flags);
+	if (pUrc->Users == 0) {
+		for (index = 0; index < len; index++) {
+			CavUrcWatch(pUrc, pData[index]);
+		}
+		spin_unlock_irqrestore(&pUrc->Lock, flags);
+		return false;
+	}
+	for (index = 0; index < len; index++) {
+		ch = pData[index];
+		CavUrcWatch(pUrc, ch);
+		switch (pUrc->State) {
+		case CAV_URC_PASS:
+			if ((ch == '\r') || (ch == '\n')) {
+				pUrc->State = CAV_URC_LINE_START;
+			}
+			continue;
+		case CAV_URC_EVENT:
+			if ((ch == '\r') || (ch == '\n')) {
+				CavUrcPost(pUrc);
+				pUrc->bSkipLf = (ch == '\r');
+				pUrc->State = CAV_URC_LINE_START;
+			} else if (pUrc->Event.len < CAV_URC_TEXT_MAX) {
+				pUrc->Event.text[pUrc->Event.len++] = ch;
+			}
+			run = index + 1;
+			continue;
+		default:
+			break;
+		}
+
+		// Start of a line
+		if ((ch == '\n') && pUrc->bSkipLf) {
+			pUrc->bSkipLf = false;
+			run = index + 1;
+			continue;
+		}
+		pUrc->bSkipLf = false;
+		if ((ch == '\r') || (ch == '\n')) {
+			if (pUrc->PendingLen != 0) {
+				// The line ended while it could still
+				// match, the terminator follows it
+				CavRxDeliver(context,
+					     (unsigned char *)pUrc->Pending,
+					     pUrc->PendingLen);
+				pUrc->PendingLen = 0;
+			}
+			continue;
+		}
+		if ((pUrc->PendingLen == 0) && CavUrcBusy(pUrc)) {
+			pUrc->State = CAV_URC_PASS;
+			continue;
+		}
+		if (pUrc->PendingLen == 0) {
+			// Hand over the data before the line
+			CavRxDeliver(context, pData + run, index - run);
+		}
+		pUrc->Pending[pUrc->PendingLen++] = ch;
+		run = index + 1;
+
+		switch (CavUrcMatch(pUrc)) {
+		case 1:
+			memset(&pUrc->Event, 0, sizeof(pUrc->Event));
+			pUrc->Event.time_ns = ktime_get_ns();
+			memcpy(pUrc->Event.text, pUrc->Pending,
+			       pUrc->PendingLen);
+			pUrc->Event.len = pUrc->PendingLen;
+			pUrc->PendingLen = 0;
+			pUrc->State = CAV_URC_EVENT;
+			break;
+		case -1:
+			CavRxDeliver(context, (unsigned char *)pUrc->Pending,
+				     pUrc->PendingLen);
+			pUrc->PendingLen = 0;
+			pUrc->State = CAV_URC_PASS;
+			break;
+		default:
+			break;
+		}
+	}
+	// Whatever is not held back or part of a URC
+	CavRxDeliver(context, pData + run, len - run);
+	spin_unlock_irqrestore(&pUrc->Lock, flags);
+
+	return true;
+} // CavUrcRx
+
+/*===========================================================================
+METHOD:
+   CavUrcCarrierLost
+
+DESCRIPTION:
+   DCD dropped, the connection is over and URCs are classified again
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavUrcCarrierLost(cav_device_context *context)
+{
+	cav_urc *pUrc = context->pUrc;
+	unsigned long flags;
+
+	if (pUrc == NULL) {
+		return;
+	}
+	spin_lock_irqsave(&pUrc->Lock, flags);
+	pUrc->bDataMode = false;
+	spin_unlock_irqrestore(&pUrc->Lock, flags);
+} // CavUrcCarrierLost
+
+/*===========================================================================
+METHOD:
+   CavUrcOpen
+
+DESCRIPTION:
+   Open /dev/cavurcN, the listener gets the events received from now on
+
+PARAMETERS:
+   pInode: [ I ] - inode being opened
+   pFile:  [ I ] - file being opened
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static int CavUrcOpen(struct inode *pInode, struct file *pFile)
+{
+	cav_char_dev *pChar = CavCharOpen(pInode);
+	cav_device_context *context;
+	cav_urc_reader *pReader;
+	cav_urc *pUrc;
+	unsigned long flags;
+	int nRetval;
+
+	if (pChar == NULL) {
+		return -ENODEV;
+	}
+	context = pChar->Context;
+	pUrc = context->pUrc;
+
+	nRetval = CavWaitReady(context);
+	if (nRetval != 0) {
+		CavContextPut(context);
+		return nRetval;
+	}
+
+	pReader = kzalloc(sizeof(cav_urc_reader), GFP_KERNEL);
+	if (pReader == NULL) {
+		CavContextPut(context);
+		return -ENOMEM;
+	}
+	pReader->pUrc = pUrc;
+	mutex_init(&pReader->ReadLock);
+
+	nRetval = CavRxGet(context);
+	if (nRetval != 0) {
+		kfree(pReader);
+		CavContextPut(context);
+		return nRetval;
+	}
+
+	spin_lock_irqsave(&pUrc->Lock, flags);
+	if (pUrc->Users++ == 0) {
+		pUrc->State = CAV_URC_PASS;
+		pUrc->PendingLen = 0;
+	}
+	pReader->Cursor = pUrc->Head;
+	list_add_tail(&pReader->List, &pUrc->Readers);
+	spin_unlock_irqrestore(&pUrc->Lock, flags);
+
+	pFile->private_data = pReader;
+	return nonseekable_open(pInode, pFile);
+} // CavUrcOpen
+
+/*===========================================================================
+METHOD:
+   CavUrcRelease
+
+DESCRIPTION:
+   Close /dev/cavurcN, the last listener stops the diversion and hands a
+   held back line start to the TTY
+
+PARAMETERS:
+   pInode: [ I ] - inode being closed
+   pFile:  [ I ] - file being closed
+
+RETURN VALUE:
+   int - zero
+===========================================================================*/
+static int CavUrcRelease(struct inode *pInode, struct file *pFile)
+{
+	cav_urc_reader *pReader = pFile->private_data;
+	cav_urc *pUrc = pReader->pUrc;
+	cav_device_context *context = pUrc->Context;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pUrc->Lock, flags);
+	list_del(&pReader->List);
+	if ((--pUrc->Users == 0) && (pUrc->PendingLen != 0)) {
+		CavRxDeliver(context, (unsigned char *)pUrc->Pending,
+			     pUrc->PendingLen);
+		pUrc->PendingLen = 0;
+	}
+	spin_unlock_irqrestore(&pUrc->Lock, flags);
+	kfree(pReader);
+
+	CavRxPut(context);
+	CavContextPut(context);
+	return 0;
+} // CavUrcRelease
+
+/*===========================================================================
+METHOD:
+   CavUrcRead
+
+DESCRIPTION:
+   Return whole struct cav_urc_event records after the cursor of the
+   reader. A reader that fell behind by more than the ring skips to the
+   oldest event still kept and counts the rest as dropped.
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pBuf:  [ O ] - user buffer
+   count: [ I ] - size of pBuf, at least one record
+   pPos:  [ I ] - unused, the device is not seekable
+
+RETURN VALUE:
+   ssize_t - number of bytes read, zero once the device is gone
+           - negative errno on error
+===========================================================================*/
+static ssize_t CavUrcRead(struct file *pFile, char __user *pBuf,
+			  size_t count, loff_t *pPos)
+{
+	cav_urc_reader *pReader = pFile->private_data;
+	cav_urc *pUrc = pReader->pUrc;
+	cav_device_context *context = pUrc->Context;
+	struct cav_urc_event event;
+	unsigned long flags;
+	ssize_t nRetval = 0;
+	u32 avail;
+
+	if (count < sizeof(event)) {
+		return -EINVAL;
+	}
+	if (mutex_lock_interruptible(&pReader->ReadLock) != 0) {
+		return -ERESTARTSYS;
+	}
+
+	while (count - nRetval >= sizeof(event)) {
+		spin_lock_irqsave(&pUrc->Lock, flags);
+		avail = pUrc->Head - pReader->Cursor;
+		if (avail > CAV_URC_EVENTS) {
+			pReader->Dropped += avail - CAV_URC_EVENTS;
+			pReader->Cursor = pUrc->Head - CAV_URC_EVENTS;
+			avail = CAV_URC_EVENTS;
+		}
+		if (avail != 0) {
+			event = pUrc->Events[pReader->Cursor &
+					     (CAV_URC_EVENTS - 1)];
+			pReader->Cursor++;
+		}
+		spin_unlock_irqrestore(&pUrc->Lock, flags);
+
+		if (avail != 0) {
+			if (copy_to_user(pBuf + nRetval, &event,
+					 sizeof(event)) != 0) {
+				nRetval = -EFAULT;
+				break;
+			}
+			nRetval += sizeof(event);
+			continue;
+		}
+		if ((nRetval != 0) || (context->bDevRemoved != 0)) {
+			break;
+		}
+		if ((pFile->f_flags & O_NONBLOCK) != 0) {
+			nRetval = -EAGAIN;
+			break;
+		}
+		if (wait_event_interruptible(
+			    pUrc->Wait,
+			    (READ_ONCE(pUrc->Head) !=
+			     READ_ONCE(pReader->Cursor)) ||
+				    (context->bDevRemoved != 0)) != 0) {
+			nRetval = -ERESTARTSYS;
+			break;
+		}
+	}
+
+	mutex_unlock(&pReader->ReadLock);
+	return nRetval;
+} // CavUrcRead
+
+/*===========================================================================
+METHOD:
+   CavUrcPoll
+
+DESCRIPTION:
+   Report POLLIN while events after the cursor of the reader are kept
+
+PARAMETERS:
+   pFile: [ I ] - open file
+   pWait: [ I ] - poll table
+
+RETURN VALUE:
+   poll mask
+===========================================================================*/
+static __poll_t CavUrcPoll(struct file *pFile, poll_table *pWait)
+{
+	cav_urc_reader *pReader = pFile->private_data;
+	cav_urc *pUrc = pReader->pUrc;
+	__poll_t mask = 0;
+
+	poll_wait(pFile, &pUrc->Wait, pWait);
+	if (READ_ONCE(pUrc->Head) != READ_ONCE(pReader->Cursor)) {
+		mask |= EPOLLIN | EPOLLRDNORM;
+	}
+	if (pUrc->Context->bDevRemoved != 0) {
+		mask |= EPOLLHUP | EPOLLERR;
+	}
+	return mask;
+} // CavUrcPoll
+
+static const struct file_operations CavUrcFops = {
+	.owner = THIS_MODULE,
+	.open = CavUrcOpen,
+	.release = CavUrcRelease,
+	.read = CavUrcRead,
+	.poll = CavUrcPoll,
+};
+
+/*===========================================================================
+METHOD:
+   CavUrcAdd
+
+DESCRIPTION:
+   Allocate the URC router and create /dev/cavurcN for an AT port
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success or if the device is not wanted
+===========================================================================*/
+int CavUrcAdd(cav_device_context *context)
+{
+	cav_urc *pUrc;
+	int nRetval;
+
+	if ((urc_cdev == false) || (context->pProfile->Role != CAV_ROLE_AT) ||
+	    (context->RxUrbCount == 0)) {
+		return 0;
+	}
+
+	pUrc = kzalloc(sizeof(cav_urc), GFP_KERNEL);
+	if (pUrc == NULL) {
+		return -ENOMEM;
+	}
+	pUrc->Context = context;
+	spin_lock_init(&pUrc->Lock);
+	init_waitqueue_head(&pUrc->Wait);
+	INIT_LIST_HEAD(&pUrc->Readers);
+	if ((urc_prefixes != NULL) && (CavUrcParse(pUrc, urc_prefixes) != 0)) {
+		CavDbg(context, CAV_DBG_PROBE, "invalid urc_prefixes\n");
+	}
+	context->pUrc = pUrc;
+
+	nRetval = CavCharAdd(&pUrc->Char, context, &CavUrcFops, "cavurc");
+	if (nRetval != 0) {
+		context->pUrc = NULL;
+		kfree(pUrc);
+	}
+	return nRetval;
+} // CavUrcAdd
+
+/*===========================================================================
+METHOD:
+   CavUrcRemove
+
+DESCRIPTION:
+   Remove /dev/cavurcN, listeners still open read end of file
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavUrcRemove(cav_device_context *context)
+{
+	if (context->pUrc == NULL) {
+		return;
+	}
+	CavCharRemove(&context->pUrc->Char);
+} // CavUrcRemove
+
+/*===========================================================================
+METHOD:
+   CavUrcDisconnect
+
+DESCRIPTION:
+   Wake up the listeners blocked in read or poll
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavUrcDisconnect(cav_device_context *context)
+{
+	if (context->pUrc == NULL) {
+		return;
+	}
+	wake_up_interruptible(&context->pUrc->Wait);
+} // CavUrcDisconnect
+
+/*===========================================================================
+METHOD:
+   CavUrcFree
+
+DESCRIPTION:
+   Free the URC router, called when the last context reference is dropped
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavUrcFree(cav_device_context *context)
+{
+	kfree(context->pUrc);
+	context->pUrc = NULL;
+} // CavUrcFree
+
+/*===========================================================================
+METHOD:
+   CavUrcPrefixesShow / CavUrcPrefixesStore
+
+DESCRIPTION:
+   Read or replace the prefix table of a port
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   buf:     [ I/O ] - comma separated prefix list
+
+RETURN VALUE:
+   Show:  number of bytes written to buf
+   Store: zero for success, negative errno on error
+===========================================================================*/
+ssize_t CavUrcPrefixesShow(cav_device_context *context, char *buf)
+{
+	cav_urc *pUrc = context->pUrc;
+	unsigned long flags;
+	ssize_t len = 0;
+	int index;
+
+	if (pUrc == NULL) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&pUrc->Lock, flags);
+	for (index = 0; index < pUrc->NumPrefixes; index++) {
+		len += sprintf(buf + len, "%s%.*s", (index != 0) ? "," : "",
+			       pUrc->PrefixLen[index], pUrc->Prefix[index]);
+	}
+	spin_unlock_irqrestore(&pUrc->Lock, flags);
+	len += sprintf(buf + len, "\n");
+	return len;
+} // CavUrcPrefixesShow
+
+int CavUrcPrefixesStore(cav_device_context *context, const char *buf)
+{
+	cav_urc *pUrc = context->pUrc;
+	unsigned long flags;
+	int nRetval;
+
+	if (pUrc == NULL) {
+		return -ENODEV;
+	}
+
+	spin_lock_irqsave(&pUrc->Lock, flags);
+	nRetval = CavUrcParse(pUrc, buf);
+	spin_unlock_irqrestore(&pUrc->Lock, flags);
+	return nRetval;
+} // CavUrcPrefixesStore
+
+/*===========================================================================
+METHOD:
+   CavUrcStatsShow
+
+DESCRIPTION:
+   Print the number of URCs diverted and the listeners with their drops
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   buf:     [ O ] - PAGE_SIZE sysfs buffer
+
+RETURN VALUE:
+   number of bytes written to buf
+===========================================================================*/
+ssize_t CavUrcStatsShow(cav_device_context *context, char *buf)
+{
+	cav_urc *pUrc = context->pUrc;
+	cav_urc_reader *pReader;
+	unsigned long flags;
+	ssize_t len;
+	u32 lag;
+	u64 dropped;
+
+	if (pUrc == NULL) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&pUrc->Lock, flags);
+	len = sprintf(buf, "events=%llu listeners=%d\n", pUrc->Matched,
+		      pUrc->Users);
+	list_for_each_entry(pReader, &pUrc->Readers, List) {
+		lag = pUrc->Head - pReader->Cursor;
+		dropped = pReader->Dropped;
+		if (lag > CAV_URC_EVENTS) {
+			dropped += lag - CAV_URC_EVENTS;
+			lag = CAV_URC_EVENTS;
+		}
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "lag=%u dropped=%llu\n", lag, dropped);
+	}
+	spin_unlock_irqrestore(&pUrc->Lock, flags);
+	return len;
+} // CavUrcStatsShow
+
+module_param(urc_cdev, bool, S_IRUGO);
+MODULE_PARM_DESC(urc_cdev, "Create /dev/cavurcN URC event device");
+module_param(urc_prefixes, charp, S_IRUGO);
+MODULE_PARM_DESC(urc_prefixes, "Comma separated URC prefixes of new ports");
@@ -0,0 +1,745 @@
+//---------------------------------------------------------------------------
+// Include Files
+//---------------------------------------------------------------------------
+#include <linux/slab.h>
+#include <linux/tty.h>
+#include <linux/usb.h>
+#include <linux/usb/serial.h>
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/kfifo.h>
+#include "CavQMSerial.h"
+#include "CavQMTrace.h"
+
+// Number of bulk-OUT URBs allowed in flight per port
+static uint tx_urbs = CAV_TX_URBS_DEFAULT;
+
+// Size of the per-port write queue in bytes
+static uint tx_fifo_size = CAV_TX_FIFO_SIZE_DEFAULT;
+
+// Initial write coalescing window of every port in microseconds
+static uint tx_coalesce_us;
+
+static void CavTxCallback(struct urb *pURB);
+static enum hrtimer_restart CavTxTimer(struct hrtimer *pTimer);
+
+#ifdef CAV_KUNIT
+// Set by the KUnit write benchmark, which has no host controller
+int (*CavTxSubmitHook)(struct urb *pURB);
+CAV_KUNIT_EXPORT(CavTxSubmitHook);
+#endif
+
+/*===========================================================================
+METHOD:
+   CavTxSubmit
+
+DESCRIPTION:
+   Submit a bulk-OUT URB
+
+PARAMETERS:
+   pURB: [ I ] - URB to submit
+
+RETURN VALUE:
+   int - zero for success
+       - negative errno on error
+===========================================================================*/
+static inline int CavTxSubmit(struct urb *pURB)
+{
+#ifdef CAV_KUNIT
+	if (CavTxSubmitHook != NULL) {
+		return CavTxSubmitHook(pURB);
+	}
+#endif
+	return usb_submit_urb(pURB, GFP_ATOMIC);
+} // CavTxSubmit
+
+/*===========================================================================
+METHOD:
+   CavTxAlloc
+
+DESCRIPTION:
+   Allocate the write queue and the bulk-OUT URBs of the write engine
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   pPort:   [ I ] - serial port owning the bulk-OUT endpoint
+
+RETURN VALUE:
+   int - negative error code on failure
+         zero on success
+===========================================================================*/
+int CavTxAlloc(cav_device_context *context, struct usb_serial_port *pPort)
+{
+	struct usb_device *pDev = pPort->serial->dev;
+	unsigned int pipe, urbCount;
+	int index;
+
+	spin_lock_init(&context->TxLock);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0))
+	hrtimer_setup(&context->TxTimer, CavTxTimer, CLOCK_MONOTONIC,
+		      HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&context->TxTimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	context->TxTimer.function = CavTxTimer;
+#endif
+	context->TxCoalesceUs = min_t(uint, tx_coalesce_us,
+				      CAV_TX_COALESCE_US_MAX);
+	context->TxUrbCount = 0;
+	context->TxUrbsFree = 0;
+	context->TxInFlight = 0;
+	context->TxFullCount = 0;
+	if (pPort->bulk_out_size == 0) {
+		CavDbg(context, CAV_DBG_TX,
+		       "no bulk-OUT endpoint, write engine disabled\n");
+		return 0;
+	}
+
+	if (kfifo_alloc(&context->TxFifo, max_t(uint, tx_fifo_size, PAGE_SIZE),
+			GFP_KERNEL) != 0) {
+		return -ENOMEM;
+	}
+
+	pipe = usb_sndbulkpipe(pDev, pPort->bulk_out_endpointAddress);
+	urbCount = context->pProfile->TxUrbs ?: tx_urbs;
+	urbCount = clamp_t(uint, urbCount, 1, CAV_MAX_TX_URBS);
+	context->TxBufSize = roundup(CAV_TX_BUF_SIZE, pPort->bulk_out_size);
+
+	for (index = 0; index < urbCount; index++) {
+		struct urb *pURB;
+		unsigned char *pBuffer;
+
+		pURB = usb_alloc_urb(0, GFP_KERNEL);
+		if (pURB == NULL) {
+			goto alloc_failed;
+		}
+		pBuffer = kmalloc(context->TxBufSize, GFP_KERNEL);
+		if (pBuffer == NULL) {
+			usb_free_urb(pURB);
+			goto alloc_failed;
+		}
+		usb_fill_bulk_urb(pURB, pDev, pipe, pBuffer, 0, CavTxCallback,
+				  context);
+		pURB->transfer_flags |= URB_FREE_BUFFER;
+		if ((context->pProfile->Quirks & CAV_QUIRK_TX_ZLP) != 0) {
+			pURB->transfer_flags |= URB_ZERO_PACKET;
+		}
+
+		context->TxUrb[index] = pURB;
+		context->TxUrbCount++;
+		context->TxUrbsFree |= BIT(index);
+	}
+
+	CavDbg(context, CAV_DBG_TX,
+	       "%d bulk-OUT URBs of %d bytes, %u byte queue\n",
+	       context->TxUrbCount, context->TxBufSize,
+	       kfifo_size(&context->TxFifo));
+	return 0;
+
+alloc_failed:
+	CavTxFree(context);
+	return -ENOMEM;
+} // CavTxAlloc
+CAV_KUNIT_EXPORT(CavTxAlloc);
+
+/*===========================================================================
+METHOD:
+   CavTxFree
+
+DESCRIPTION:
+   Release the write queue and bulk-OUT URBs, the engine must be stopped
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavTxFree(cav_device_context *context)
+{
+	int index;
+
+	for (index = 0; index < context->TxUrbCount; index++) {
+		usb_free_urb(context->TxUrb[index]);
+		context->TxUrb[index] = NULL;
+	}
+	context->TxUrbCount = 0;
+	context->TxUrbsFree = 0;
+	kfifo_free(&context->TxFifo);
+} // CavTxFree
+CAV_KUNIT_EXPORT(CavTxFree);
+
+/*===========================================================================
+METHOD:
+   CavTxStop
+
+DESCRIPTION:
+   Kill the bulk-OUT URBs in flight and discard queued data
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavTxStop(cav_device_context *context)
+{
+	unsigned long flags;
+	int index;
+
+	hrtimer_cancel(&context->TxTimer);
+	for (index = 0; index < context->TxUrbCount; index++) {
+		usb_kill_urb(context->TxUrb[index]);
+	}
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	if (context->TxUrbCount > 0) {
+		kfifo_reset_out(&context->TxFifo);
+		context->TxTakenBytes = context->TxQueuedBytes;
+		context->TxStampTail = context->TxStampHead;
+	}
+	context->bTxHeld = false;
+	context->bTxFlush = false;
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	// A broker command waiting for room would see no more completions
+	CavAtTxRoom(context);
+} // CavTxStop
+
+/*===========================================================================
+METHOD:
+   CavTxStamp
+
+DESCRIPTION:
+   Record the time of a write for the CAV_HIST_TX histogram. While the
+   ring is full the newest stamp also covers later writes. Called with
+   TxLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   queued:  [ I ] - number of bytes queued by the write
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTxStamp(cav_device_context *context, int queued)
+{
+	cav_tx_stamp *pStamp;
+
+	context->TxQueuedBytes += queued;
+	if (context->TxStampHead - context->TxStampTail == CAV_TX_STAMPS) {
+		pStamp = &context->TxStamps[(context->TxStampHead - 1) %
+					    CAV_TX_STAMPS];
+	} else {
+		pStamp = &context->TxStamps[context->TxStampHead++ %
+					    CAV_TX_STAMPS];
+		pStamp->Time = ktime_get();
+	}
+	pStamp->End = context->TxQueuedBytes;
+} // CavTxStamp
+
+/*===========================================================================
+METHOD:
+   CavTxTake
+
+DESCRIPTION:
+   Account data moved from the write queue into a URB and drop the stamps
+   of writes that are sent completely. Called with TxLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   count:   [ I ] - number of bytes taken from the queue
+
+RETURN VALUE:
+   ktime_t - time of the oldest write in the data, 0 if unknown
+===========================================================================*/
+static ktime_t CavTxTake(cav_device_context *context, int count)
+{
+	cav_tx_stamp *pStamp;
+
+	while (context->TxStampTail != context->TxStampHead) {
+		pStamp = &context->TxStamps[context->TxStampTail %
+					    CAV_TX_STAMPS];
+		if ((s32)(pStamp->End - context->TxTakenBytes) > 0) {
+			context->TxTakenBytes += count;
+			return pStamp->Time;
+		}
+		context->TxStampTail++;
+	}
+	context->TxTakenBytes += count;
+	return 0;
+} // CavTxTake
+
+/*===========================================================================
+METHOD:
+   CavTxHold
+
+DESCRIPTION:
+   Decide whether queued data waits for more writes. Coalescing holds a
+   partial transfer for up to TxCoalesceUs, a full transfer of TxBufSize
+   bytes (a multiple of wMaxPacketSize) or a flush request sends it.
+   Called with TxLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   bool - true if the data stays queued
+===========================================================================*/
+static bool CavTxHold(cav_device_context *context)
+{
+	unsigned int windowUs = READ_ONCE(context->TxCoalesceUs);
+
+	if ((windowUs == 0) || context->bTxFlush ||
+	    (kfifo_len(&context->TxFifo) >= context->TxBufSize)) {
+		return false;
+	}
+	if (context->bTxHeld == false) {
+		context->bTxHeld = true;
+		context->TxHeldSince = ktime_get();
+		hrtimer_start(&context->TxTimer, us_to_ktime(windowUs),
+			      HRTIMER_MODE_REL);
+	}
+	return true;
+} // CavTxHold
+
+/*===========================================================================
+METHOD:
+   CavTxHeldSent
+
+DESCRIPTION:
+   Account a transfer that was held back, the window ends once the queue
+   is empty. Called with TxLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTxHeldSent(cav_device_context *context)
+{
+	u64 heldNs = ktime_to_ns(ktime_sub(ktime_get(), context->TxHeldSince));
+
+	context->TxHeldUrbs++;
+	context->TxHeldNs += heldNs;
+	context->TxHeldMaxNs = max(context->TxHeldMaxNs, heldNs);
+	if (kfifo_is_empty(&context->TxFifo)) {
+		context->bTxHeld = false;
+		context->bTxFlush = false;
+		hrtimer_try_to_cancel(&context->TxTimer);
+	}
+} // CavTxHeldSent
+
+/*===========================================================================
+METHOD:
+   CavTxTimer
+
+DESCRIPTION:
+   Coalescing window expired, send the held data
+
+PARAMETERS:
+   pTimer: [ I ] - TxTimer of the context
+
+RETURN VALUE:
+   HRTIMER_NORESTART
+===========================================================================*/
+static enum hrtimer_restart CavTxTimer(struct hrtimer *pTimer)
+{
+	cav_device_context *context =
+		container_of(pTimer, cav_device_context, TxTimer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	context->bTxFlush = context->bTxHeld;
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	CavTxKick(context);
+	return HRTIMER_NORESTART;
+} // CavTxTimer
+
+/*===========================================================================
+METHOD:
+   CavTxFlush
+
+DESCRIPTION:
+   End the coalescing window and send the held data right away
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavTxFlush(cav_device_context *context)
+{
+	unsigned long flags;
+	bool bHeld;
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	bHeld = context->bTxHeld;
+	context->bTxFlush = bHeld;
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	if (bHeld) {
+		CavTxKick(context);
+	}
+} // CavTxFlush
+
+/*===========================================================================
+METHOD:
+   CavTxKick
+
+DESCRIPTION:
+   Move queued data into every idle bulk-OUT URB. While the device is
+   suspended or a coalescing window is open the data stays queued, a
+   resume is requested in the first case.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+
+RETURN VALUE:
+   none
+===========================================================================*/
+void CavTxKick(cav_device_context *context)
+{
+	struct urb *pURB;
+	unsigned long flags;
+	int index, count, status;
+
+	for (;;) {
+		spin_lock_irqsave(&context->TxLock, flags);
+		if ((context->TxUrbsFree == 0) ||
+		    kfifo_is_empty(&context->TxFifo) || CavTxHold(context)) {
+			spin_unlock_irqrestore(&context->TxLock, flags);
+			return;
+		}
+		if (context->bSuspended != 0) {
+			CavPmWake(context);
+			spin_unlock_irqrestore(&context->TxLock, flags);
+			return;
+		}
+		index = __ffs(context->TxUrbsFree);
+		pURB = context->TxUrb[index];
+		count = kfifo_out(&context->TxFifo, pURB->transfer_buffer,
+				  context->TxBufSize);
+		context->TxUrbsFree &= ~BIT(index);
+		context->TxInFlight += count;
+		context->TxUrbStamp[index] = CavTxTake(context, count);
+		if (context->bTxHeld) {
+			CavTxHeldSent(context);
+		} else if (kfifo_is_empty(&context->TxFifo)) {
+			// A '\r' sent without a window must not keep later
+			// writes from being held
+			context->bTxFlush = false;
+		}
+		spin_unlock_irqrestore(&context->TxLock, flags);
+
+		pURB->transfer_buffer_length = count;
+		usb_mark_last_busy(context->MySerial->dev);
+		CavCapture(context, pURB, 'S', -EINPROGRESS,
+			   pURB->transfer_buffer, count);
+		status = CavTxSubmit(pURB);
+		trace_cav_urb_submit(context->MyPort->minor, pURB, status);
+		if (status != 0) {
+			CavDbg(context, CAV_DBG_TX,
+			       "failed submitting write urb %d, error %d\n",
+			       index, status);
+			// write() accepted the data and it left the fifo, it
+			// cannot go back in front of later writes
+			CavStatAdd(context, CAV_STAT_TX_DROPPED, count);
+			spin_lock_irqsave(&context->TxLock, flags);
+			context->TxUrbsFree |= BIT(index);
+			context->TxInFlight -= count;
+			spin_unlock_irqrestore(&context->TxLock, flags);
+			return;
+		}
+	}
+} // CavTxKick
+
+/*===========================================================================
+METHOD:
+   CavTxCallback
+
+DESCRIPTION:
+   Bulk-OUT completion, refill the URB from the write queue
+
+PARAMETERS:
+   pURB: [ I ] - completed URB
+
+RETURN VALUE:
+   none
+===========================================================================*/
+static void CavTxCallback(struct urb *pURB)
+{
+	cav_device_context *context = (cav_device_context *)pURB->context;
+	unsigned long flags;
+	ktime_t writeTime;
+	int index;
+
+	for (index = 0; index < context->TxUrbCount; index++) {
+		if (context->TxUrb[index] == pURB) {
+			break;
+		}
+	}
+	if (index == context->TxUrbCount) {
+		return;
+	}
+	trace_cav_urb_complete(context->MyPort->minor, pURB, pURB->status);
+	CavCapture(context, pURB, 'C', pURB->status, NULL,
+		   pURB->actual_length);
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	writeTime = context->TxUrbStamp[index];
+	context->TxUrbsFree |= BIT(index);
+	context->TxInFlight -= pURB->transfer_buffer_length;
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	switch (pURB->status) {
+	case 0:
+		usb_mark_last_busy(context->MySerial->dev);
+		CavStatInc(context, CAV_STAT_TX_URBS);
+		CavStatAdd(context, CAV_STAT_TX_BYTES, pURB->actual_length);
+		if (writeTime != 0) {
+			CavHistAdd(context, CAV_HIST_TX, writeTime,
+				   ktime_get());
+		}
+		break;
+	case -ENOENT:
+	case -ECONNRESET:
+	case -ESHUTDOWN:
+		// Killed or device gone
+		return;
+	case -EPIPE:
+		CavDbg(context, CAV_DBG_TX, "bulk-OUT endpoint stalled\n");
+		CavStatUrbError(context, pURB->status);
+		CavRecoverRequest(context, CAV_RECOVER_TX_HALT);
+		return;
+	default:
+		CavDbg(context, CAV_DBG_TX,
+		       "nonzero write bulk status received: %d\n",
+		       pURB->status);
+		CavStatUrbError(context, pURB->status);
+		break;
+	}
+
+	CavTxKick(context);
+	CavAtTxRoom(context);
+	tty_port_tty_wakeup(&context->MyPort->port);
+} // CavTxCallback
+
+/*===========================================================================
+METHOD:
+   CavTxQueueLocked
+
+DESCRIPTION:
+   Append data to the write queue. A '\r' ends an AT command and closes
+   the coalescing window. Called with TxLock held.
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   buf:     [ I ] - data to send
+   count:   [ I ] - number of bytes in buf
+
+RETURN VALUE:
+   number of bytes queued
+===========================================================================*/
+static int CavTxQueueLocked(cav_device_context *context,
+			    const unsigned char *buf, int count)
+{
+	int queued;
+
+	queued = kfifo_in(&context->TxFifo, buf, count);
+	if (queued < count) {
+		context->TxFullCount++;
+	}
+	if (queued != 0) {
+		CavTxStamp(context, queued);
+	}
+	if (context->bTxHeld && (queued != 0)) {
+		context->TxSaved++;
+	}
+	if (((context->TxCoalesceUs != 0) || (context->pUrc != NULL)) &&
+	    (memchr(buf, '\r', queued) != NULL)) {
+		// CavUrcRx leaves the response of the command alone
+		WRITE_ONCE(context->TxCmdAt, jiffies | 1);
+		if (context->TxCoalesceUs != 0) {
+			context->bTxFlush = true;
+		}
+	}
+	return queued;
+} // CavTxQueueLocked
+
+/*===========================================================================
+METHOD:
+   CavTxQueue
+
+DESCRIPTION:
+   Append data to the write queue, the caller kicks the write engine
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   buf:     [ I ] - data to send
+   count:   [ I ] - number of bytes in buf
+
+RETURN VALUE:
+   number of bytes queued
+===========================================================================*/
+int CavTxQueue(cav_device_context *context, const unsigned char *buf,
+	       int count)
+{
+	unsigned long flags;
+	int queued;
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	queued = CavTxQueueLocked(context, buf, count);
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	return queued;
+} // CavTxQueue
+
+/*===========================================================================
+METHOD:
+   CavTxQueueAll
+
+DESCRIPTION:
+   Append data to the write queue only if all of it fits, the caller
+   kicks the write engine
+
+PARAMETERS:
+   context: [ I ] - private context for the serial device
+   buf:     [ I ] - data to send
+   count:   [ I ] - number of bytes in buf
+
+RETURN VALUE:
+   bool - false if the queue has no room for count bytes
+===========================================================================*/
+bool CavTxQueueAll(cav_device_context *context, const unsigned char *buf,
+		   int count)
+{
+	unsigned long flags;
+	bool bQueued = false;
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	if (kfifo_avail(&context->TxFifo) >= count) {
+		CavTxQueueLocked(context, buf, count);
+		bQueued = true;
+	}
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	return bQueued;
+} // CavTxQueueAll
+
+/*===========================================================================
+METHOD:
+   CavWrite
+
+DESCRIPTION:
+   Write data over the USB BULK pipe
+
+PARAMETERS:
+   tty:    [ I ] - TTY structure associated with the serial device
+   pPort:  [ I ] - the serial port structure
+   buf:    [ I ] - buffer containing the USB bulk OUT data
+   count:  [ I ] - number of bytes of the USB bulk OUT data
+
+RETURN VALUE:
+   int - number of bytes queued
+       - negative errno on error
+===========================================================================*/
+int CavWrite(struct tty_struct *tty, struct usb_serial_port *pPort,
+	      const unsigned char *buf, int count)
+{
+	cav_device_context *context = usb_get_serial_data(pPort->serial);
+	int queued;
+
+	if (context->TxUrbCount == 0) {
+		return usb_serial_generic_write(tty, pPort, buf, count);
+	}
+	if (count == 0) {
+		return 0;
+	}
+
+	queued = CavTxQueue(context, buf, count);
+	CavTxKick(context);
+	return queued;
+} // CavWrite
+CAV_KUNIT_EXPORT(CavWrite);
+
+/*===========================================================================
+METHOD:
+   CavWriteRoom
+
+DESCRIPTION:
+   Free space left in the write queue
+
+PARAMETERS:
+   tty: [ I ] - TTY structure associated with the serial device
+
+RETURN VALUE:
+   number of bytes CavWrite can accept
+===========================================================================*/
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 14, 0))
+unsigned int CavWriteRoom(struct tty_struct *tty)
+#else
+int CavWriteRoom(struct tty_struct *tty)
+#endif
+{
+	struct usb_serial_port *pPort = tty->driver_data;
+	cav_device_context *context = usb_get_serial_data(pPort->serial);
+	unsigned long flags;
+	unsigned int room;
+
+	if (context->TxUrbCount == 0) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	room = kfifo_avail(&context->TxFifo);
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	return room;
+} // CavWriteRoom
+
+/*===========================================================================
+METHOD:
+   CavCharsInBuffer
+
+DESCRIPTION:
+   Bytes queued or in flight on the bulk-OUT pipe. poll() and TIOCOUTQ
+   also ask, so this does not end a coalescing window, a tcdrain() waits
+   for it to expire.
+
+PARAMETERS:
+   tty: [ I ] - TTY structure associated with the serial device
+
+RETURN VALUE:
+   number of bytes not yet acknowledged by the device
+===========================================================================*/
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 14, 0))
+unsigned int CavCharsInBuffer(struct tty_struct *tty)
+#else
+int CavCharsInBuffer(struct tty_struct *tty)
+#endif
+{
+	struct usb_serial_port *pPort = tty->driver_data;
+	cav_device_context *context = usb_get_serial_data(pPort->serial);
+	unsigned long flags;
+	unsigned int chars;
+
+	if (context->TxUrbCount == 0) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&context->TxLock, flags);
+	chars = kfifo_len(&context->TxFifo) + context->TxInFlight;
+	spin_unlock_irqrestore(&context->TxLock, flags);
+
+	return chars;
+} // CavCharsInBuffer
+
+module_param(tx_urbs, uint, S_IRUGO);
+MODULE_PARM_DESC(tx_urbs, "Bulk-OUT URBs allowed in flight per port");
+module_param(tx_fifo_size, uint, S_IRUGO);
+MODULE_PARM_DESC(tx_fifo_size, "Per-port write queue size in bytes");
+module_param(tx_coalesce_us, uint, S_IRUGO);
+MODULE_PARM_DESC(tx_coalesce_us, "Initial write coalescing window in us");
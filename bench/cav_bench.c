@@ -0,0 +1,521 @@
+// Host side of the CavQMSerial benchmarks, run against ports of modems
+// emulated by cav_emu.
+//
+// Usage: cav_bench [-t seconds] [-n count] [-s size] [-l label]
+//                  [-r reopen ms] test tty...
+//   rx    - read from every tty at once for -t seconds (emulator: source)
+//   tx    - write to every tty at once for -t seconds (emulator: sink)
+//   rtt   - -n round trips of -s byte messages on each tty (emulator: echo)
+//   open  - -n open/close cycles of each tty
+//   probe - write a numbered line every millisecond for -t seconds and
+//           read the echo back (emulator: echo -N)
+//
+// Prints one row per measurement: label, ports, MB/s over all ports,
+// p50/p99/p999 latency in microseconds and CPU use in percent of one core.
+// The latency is that of the read()/write() calls for rx and tx, of a
+// whole round trip for rtt and of open() and close() for open. CPU use
+// is system wide, the emulator is included.
+//
+// probe measures the recovery from faults instead and prints: label,
+// ports, the longest gap between echoed lines and between DSR changes
+// reported by TIOCGICOUNT in milliseconds, lines written, lines lost and
+// reopens. A tty that fails or has echoed nothing for -r ms (default 1000)
+// is closed and opened again, retrying until the device is back.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+#define CAV_MAX_PORTS 64
+#define CAV_BUF_SIZE 65536
+#define CAV_PROBE_PERIOD_NS 1000000ull
+#define CAV_PROBE_LINE 9 // "%08u\n"
+// Time for the last echoes to come back after the last write
+#define CAV_PROBE_DRAIN_NS 500000000ull
+
+struct cav_samples {
+	uint64_t *pNs;
+	size_t count;
+	size_t size;
+};
+
+struct cav_job {
+	const char *pPath;
+	pthread_t thread;
+	uint64_t bytes;
+	uint64_t errors;
+	struct cav_samples lat; // open() for the open test
+	struct cav_samples lat2; // close() for the open test
+	uint64_t sent; // probe test
+	uint64_t received;
+	uint64_t reopens;
+	uint64_t dataGapNs;
+	uint64_t notifyGapNs;
+};
+
+static const char *test;
+static int seconds = 5;
+static long count = 10000;
+static size_t size = 32;
+static int reopenMs = 1000;
+static struct cav_job jobs[CAV_MAX_PORTS];
+static int jobCount;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void add_sample(struct cav_samples *pSamples, uint64_t ns)
+{
+	if (pSamples->count == pSamples->size) {
+		pSamples->size = pSamples->size ? pSamples->size * 2 : 4096;
+		pSamples->pNs = realloc(pSamples->pNs,
+					pSamples->size * sizeof(uint64_t));
+		if (pSamples->pNs == NULL) {
+			perror("cav_bench");
+			exit(1);
+		}
+	}
+	pSamples->pNs[pSamples->count++] = ns;
+}
+
+static int compare_ns(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double percentile_us(struct cav_samples *pSamples, double p)
+{
+	if (pSamples->count == 0) {
+		return 0;
+	}
+	return pSamples->pNs[(size_t)((pSamples->count - 1) * p)] / 1000.0;
+}
+
+// Busy and total jiffies of all CPUs
+static void cpu_times(uint64_t *pBusy, uint64_t *pTotal)
+{
+	unsigned long long v[8] = { 0 };
+	FILE *pFile = fopen("/proc/stat", "r");
+
+	*pBusy = *pTotal = 0;
+	if (pFile == NULL) {
+		return;
+	}
+	if (fscanf(pFile, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0],
+		   &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) == 8) {
+		// user nice system idle iowait irq softirq steal
+		*pBusy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+		*pTotal = *pBusy + v[3] + v[4];
+	}
+	fclose(pFile);
+}
+
+static int try_open_raw(const char *pPath)
+{
+	struct termios tio;
+	int fd = open(pPath, O_RDWR | O_NOCTTY);
+
+	if (fd < 0) {
+		return -1;
+	}
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tio.c_cflag &= ~CRTSCTS;
+		tio.c_cflag |= CLOCAL | CREAD;
+		tio.c_cc[VMIN] = 1;
+		tio.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+
+static int open_raw(const char *pPath)
+{
+	int fd = try_open_raw(pPath);
+
+	if (fd < 0) {
+		perror(pPath);
+		exit(1);
+	}
+	return fd;
+}
+
+static void *rx_thread(void *arg)
+{
+	struct cav_job *pJob = arg;
+	struct pollfd pfd = { .events = POLLIN };
+	char *buf = malloc(CAV_BUF_SIZE);
+	uint64_t start, end = now_ns() + seconds * 1000000000ull;
+	ssize_t len;
+
+	pfd.fd = open_raw(pJob->pPath);
+	while ((start = now_ns()) < end) {
+		if (poll(&pfd, 1, 100) <= 0) {
+			continue;
+		}
+		len = read(pfd.fd, buf, CAV_BUF_SIZE);
+		if (len <= 0) {
+			pJob->errors++;
+			break;
+		}
+		add_sample(&pJob->lat, now_ns() - start);
+		pJob->bytes += len;
+	}
+	close(pfd.fd);
+	free(buf);
+	return NULL;
+}
+
+static void *tx_thread(void *arg)
+{
+	struct cav_job *pJob = arg;
+	char *buf = calloc(1, 4096);
+	uint64_t start, end = now_ns() + seconds * 1000000000ull;
+	ssize_t len;
+	int fd = open_raw(pJob->pPath);
+
+	while ((start = now_ns()) < end) {
+		len = write(fd, buf, 4096);
+		if (len <= 0) {
+			pJob->errors++;
+			break;
+		}
+		add_sample(&pJob->lat, now_ns() - start);
+		pJob->bytes += len;
+	}
+	tcdrain(fd);
+	close(fd);
+	free(buf);
+	return NULL;
+}
+
+static void *rtt_thread(void *arg)
+{
+	struct cav_job *pJob = arg;
+	char *msg = malloc(size), *reply = malloc(size);
+	uint64_t start;
+	size_t got;
+	ssize_t len;
+	long index;
+	int fd = open_raw(pJob->pPath);
+
+	for (index = 0; index < count; index++) {
+		memset(msg, 'a' + index % 26, size);
+		start = now_ns();
+		if (write(fd, msg, size) != (ssize_t)size) {
+			pJob->errors++;
+			break;
+		}
+		for (got = 0; got < size; got += len) {
+			len = read(fd, reply + got, size - got);
+			if (len <= 0) {
+				break;
+			}
+		}
+		add_sample(&pJob->lat, now_ns() - start);
+		pJob->bytes += 2 * size;
+		if ((got < size) || (memcmp(msg, reply, size) != 0)) {
+			pJob->errors++;
+		}
+	}
+	close(fd);
+	free(msg);
+	free(reply);
+	return NULL;
+}
+
+static void *open_thread(void *arg)
+{
+	struct cav_job *pJob = arg;
+	uint64_t start;
+	long index;
+	int fd;
+
+	for (index = 0; index < count; index++) {
+		start = now_ns();
+		fd = open(pJob->pPath, O_RDWR | O_NOCTTY);
+		if (fd < 0) {
+			pJob->errors++;
+			continue;
+		}
+		add_sample(&pJob->lat, now_ns() - start);
+		start = now_ns();
+		close(fd);
+		add_sample(&pJob->lat2, now_ns() - start);
+	}
+	return NULL;
+}
+
+static void max_gap(uint64_t *pGap, uint64_t *pLast, uint64_t now)
+{
+	if (now - *pLast > *pGap) {
+		*pGap = now - *pLast;
+	}
+	*pLast = now;
+}
+
+// Count the complete numbered lines in buf, keep a partial one at the start
+static size_t probe_parse(struct cav_job *pJob, char *buf, size_t used,
+			  uint64_t now, uint64_t *pLastData)
+{
+	size_t start = 0, index;
+
+	for (index = 0; index < used; index++) {
+		if (buf[index] != '\n') {
+			continue;
+		}
+		if ((index - start == CAV_PROBE_LINE - 1) &&
+		    (strspn(buf + start, "0123456789") == CAV_PROBE_LINE - 1)) {
+			pJob->received++;
+			max_gap(&pJob->dataGapNs, pLastData, now);
+		}
+		start = index + 1;
+	}
+	memmove(buf, buf + start, used - start);
+	return used - start;
+}
+
+static void *probe_thread(void *arg)
+{
+	struct cav_job *pJob = arg;
+	struct serial_icounter_struct icount;
+	struct pollfd pfd = { .fd = -1, .events = POLLIN };
+	char line[CAV_PROBE_LINE + 1], buf[4096];
+	uint64_t now, nextWrite, lastData, lastNotify, lastOpen;
+	uint64_t stop = now_ns() + seconds * 1000000000ull;
+	uint64_t reopenNs = reopenMs * 1000000ull;
+	size_t used = 0;
+	ssize_t len;
+	int dsr = -1, timeout;
+
+	pfd.fd = open_raw(pJob->pPath);
+	lastData = lastNotify = lastOpen = nextWrite = now_ns();
+	while ((now = now_ns()) < stop + CAV_PROBE_DRAIN_NS) {
+		if (pfd.fd < 0) {
+			pfd.fd = try_open_raw(pJob->pPath);
+			if (pfd.fd < 0) {
+				usleep(10000);
+				continue;
+			}
+			pJob->reopens++;
+			lastOpen = now;
+			used = 0;
+		}
+		if ((now >= nextWrite) && (now < stop)) {
+			snprintf(line, sizeof(line), "%08llu\n",
+				 (unsigned long long)pJob->sent % 100000000);
+			if (write(pfd.fd, line, CAV_PROBE_LINE) !=
+			    CAV_PROBE_LINE) {
+				goto reopen;
+			}
+			pJob->sent++;
+			nextWrite += CAV_PROBE_PERIOD_NS;
+			if (nextWrite < now) {
+				// Blocked in write, don't catch up in a burst
+				nextWrite = now + CAV_PROBE_PERIOD_NS;
+			}
+		}
+
+		timeout = 1;
+		if (nextWrite > now) {
+			timeout = (nextWrite - now + 999999) / 1000000;
+		}
+		if (poll(&pfd, 1, timeout) < 0) {
+			goto reopen;
+		}
+		now = now_ns();
+		if ((pfd.revents & POLLIN) != 0) {
+			len = read(pfd.fd, buf + used, sizeof(buf) - used);
+			if (len <= 0) {
+				goto reopen;
+			}
+			used = probe_parse(pJob, buf, used + len, now,
+					   &lastData);
+			if (used == sizeof(buf)) {
+				used = 0;
+			}
+		} else if ((pfd.revents & (POLLHUP | POLLERR)) != 0) {
+			goto reopen;
+		}
+		if (ioctl(pfd.fd, TIOCGICOUNT, &icount) == 0) {
+			if ((dsr != -1) && (icount.dsr != dsr)) {
+				max_gap(&pJob->notifyGapNs, &lastNotify, now);
+			}
+			dsr = icount.dsr;
+		}
+		if ((now < stop) && (now - lastData > reopenNs) &&
+		    (now - lastOpen > reopenNs)) {
+			goto reopen;
+		}
+		continue;
+reopen:
+		close(pfd.fd);
+		pfd.fd = -1;
+		dsr = -1;
+	}
+	if (pfd.fd >= 0) {
+		close(pfd.fd);
+	}
+	// A fault the device never recovered from
+	max_gap(&pJob->dataGapNs, &lastData, stop);
+	max_gap(&pJob->notifyGapNs, &lastNotify, stop);
+	return NULL;
+}
+
+static void report_probe(const char *pLabel)
+{
+	uint64_t dataGap = 0, notifyGap = 0, sent = 0, received = 0;
+	uint64_t reopens = 0;
+	int job;
+
+	for (job = 0; job < jobCount; job++) {
+		if (jobs[job].dataGapNs > dataGap) {
+			dataGap = jobs[job].dataGapNs;
+		}
+		if (jobs[job].notifyGapNs > notifyGap) {
+			notifyGap = jobs[job].notifyGapNs;
+		}
+		sent += jobs[job].sent;
+		received += jobs[job].received;
+		reopens += jobs[job].reopens;
+	}
+	printf("%-12s %5d %9.1f %9.1f %9llu %9llu %7llu\n", pLabel, jobCount,
+	       dataGap / 1e6, notifyGap / 1e6, (unsigned long long)sent,
+	       (unsigned long long)(sent > received ? sent - received : 0),
+	       (unsigned long long)reopens);
+}
+
+static void report(const char *pLabel, int secondLat, double elapsed,
+		   double cpu)
+{
+	struct cav_samples all = { 0 };
+	uint64_t bytes = 0, errors = 0;
+	int job;
+	size_t index;
+
+	for (job = 0; job < jobCount; job++) {
+		struct cav_samples *pLat =
+			secondLat ? &jobs[job].lat2 : &jobs[job].lat;
+
+		for (index = 0; index < pLat->count; index++) {
+			add_sample(&all, pLat->pNs[index]);
+		}
+		bytes += jobs[job].bytes;
+		errors += jobs[job].errors;
+	}
+	qsort(all.pNs, all.count, sizeof(uint64_t), compare_ns);
+
+	printf("%-12s %5d %9.2f %9.1f %9.1f %9.1f %6.1f", pLabel, jobCount,
+	       bytes / elapsed / 1e6, percentile_us(&all, 0.5),
+	       percentile_us(&all, 0.99), percentile_us(&all, 0.999), cpu);
+	if (errors != 0) {
+		printf("  errors=%llu", (unsigned long long)errors);
+	}
+	printf("\n");
+	free(all.pNs);
+}
+
+int main(int argc, char **argv)
+{
+	void *(*run)(void *);
+	const char *label = NULL;
+	char label2[64];
+	uint64_t start, busy0, total0, busy1, total1;
+	double elapsed, cpu = 0;
+	int opt, job;
+
+	while ((opt = getopt(argc, argv, "t:n:s:l:r:")) != -1) {
+		switch (opt) {
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			label = optarg;
+			break;
+		case 'r':
+			reopenMs = atoi(optarg);
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+	if ((argc - optind < 2) || (argc - optind - 1 > CAV_MAX_PORTS) ||
+	    (size == 0)) {
+		fprintf(stderr, "usage: cav_bench [-t seconds] [-n count] "
+				"[-s size] [-l label] [-r reopen ms] "
+				"rx|tx|rtt|open|probe tty...\n");
+		return 1;
+	}
+	test = argv[optind++];
+	if (strcmp(test, "rx") == 0) {
+		run = rx_thread;
+	} else if (strcmp(test, "tx") == 0) {
+		run = tx_thread;
+	} else if (strcmp(test, "rtt") == 0) {
+		run = rtt_thread;
+	} else if (strcmp(test, "open") == 0) {
+		run = open_thread;
+	} else if (strcmp(test, "probe") == 0) {
+		run = probe_thread;
+	} else {
+		fprintf(stderr, "cav_bench: unknown test %s\n", test);
+		return 1;
+	}
+	if (label == NULL) {
+		label = test;
+	}
+
+	cpu_times(&busy0, &total0);
+	start = now_ns();
+	for (; optind < argc; optind++) {
+		jobs[jobCount].pPath = argv[optind];
+		pthread_create(&jobs[jobCount].thread, NULL, run,
+			       &jobs[jobCount]);
+		jobCount++;
+	}
+	for (job = 0; job < jobCount; job++) {
+		pthread_join(jobs[job].thread, NULL);
+	}
+	elapsed = (now_ns() - start) / 1e9;
+	cpu_times(&busy1, &total1);
+	if (total1 > total0) {
+		cpu = 100.0 * sysconf(_SC_NPROCESSORS_ONLN) *
+		      (busy1 - busy0) / (total1 - total0);
+	}
+
+	if (strcmp(test, "probe") == 0) {
+		report_probe(label);
+	} else if (strcmp(test, "open") == 0) {
+		snprintf(label2, sizeof(label2), "%s-close", label);
+		report(label, 0, elapsed, cpu);
+		report(label2, 1, elapsed, cpu);
+	} else {
+		report(label, 0, elapsed, cpu);
+	}
+	return 0;
+}
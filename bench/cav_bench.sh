@@ -0,0 +1,68 @@
+#!/bin/bash
+#
+# Loopback benchmark suite for CavQMSerial, run by "make bench".
+#
+# Runs against C10QM modems emulated by bench/cav_gadget.sh. Tests:
+#   rx       bulk-IN throughput of the AT port (emulator sends)
+#   tx       bulk-OUT throughput of the AT port (emulator discards)
+#   rtt      round trips of small messages on the AT port (emulator echoes)
+#   open     open() and close() latency of the AT port
+#   scale-N  bulk-IN throughput with N modems, both ports of each streaming
+# Every row reports MB/s, p50/p99/p999 latency in microseconds and the
+# system wide CPU use in percent of one core, see bench/cav_bench.c.
+#
+# Usage: sudo bench/cav_bench.sh [-n max_devices] [-t seconds] [-c count]
+#                                [-s size] [-k module]
+#
+# max_devices (default 4) is limited by dummy_hcd to 32. The driver module
+# defaults to ./CavQMSerial_mod.ko.
+
+set -u
+
+MAX_DEVICES=4
+SECONDS_PER_RUN=5
+COUNT=10000
+SIZE=32
+MODULE=./CavQMSerial_mod.ko
+
+while getopts "n:t:c:s:k:h" opt; do
+	case $opt in
+	n) MAX_DEVICES=$OPTARG ;;
+	t) SECONDS_PER_RUN=$OPTARG ;;
+	c) COUNT=$OPTARG ;;
+	s) SIZE=$OPTARG ;;
+	k) MODULE=$OPTARG ;;
+	*)
+		sed -n '3,18p' "$0"
+		exit 1
+		;;
+	esac
+done
+
+. "$(dirname "$0")/cav_gadget.sh"
+gadget_setup
+
+printf "%-12s %5s %9s %9s %9s %9s %6s\n" test ports MB/s p50_us p99_us \
+	p999_us cpu%
+
+run_emus 1 source
+"$BENCH/cav_bench" -t "$SECONDS_PER_RUN" rx $(host_ports 0 2)
+stop_emus
+
+run_emus 1 sink
+"$BENCH/cav_bench" -t "$SECONDS_PER_RUN" tx $(host_ports 0 2)
+stop_emus
+
+run_emus 1 echo
+"$BENCH/cav_bench" -n "$COUNT" -s "$SIZE" rtt $(host_ports 0 2)
+"$BENCH/cav_bench" -n $((COUNT / 10)) open $(host_ports 0 2)
+stop_emus
+
+n=1
+while [ $n -le "$MAX_DEVICES" ]; do
+	run_emus $n source
+	"$BENCH/cav_bench" -t "$SECONDS_PER_RUN" -l "scale-$n" rx \
+		$(for i in $(seq 0 $((n - 1))); do host_ports "$i"; done)
+	stop_emus
+	n=$((n * 2))
+done
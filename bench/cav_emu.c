@@ -0,0 +1,464 @@
+// C10QM emulator for the CavQMSerial benchmarks.
+//
+// Serves a FunctionFS instance with the interface layout of the C10QM:
+// interfaces 0 and 1 without endpoints, then the AT (2) and GNSS (3)
+// interfaces with a bulk-IN, a bulk-OUT and an interrupt-IN endpoint
+// each. Both ports handle data the same way:
+//   echo   - send back what the host writes
+//   source - send a stream of NMEA-sized lines as fast as the host reads
+//   sink   - discard what the host writes
+// CDC class requests of the host (line coding, DTR/RTS) are accepted.
+// With -N the AT port sends a SERIAL_STATE notification every -N ms that
+// toggles DSR, so the host can tell when the interrupt pipe works.
+//
+// A fault script (-f) is run on SIGUSR1, one action per line:
+//   <delay ms> stall in|out|int [port]  halt an endpoint until cleared
+//   <delay ms> babble [port]            send more than the host URB holds
+//                                       on the interrupt endpoint
+//   <delay ms> slow <ms>                read bulk-OUT one packet per <ms>,
+//                                       0 drains at full speed again
+//   <delay ms> disconnect <ms>          unbind the gadget from its UDC
+//                                       (-u) and bind it again after <ms>
+// The delay counts from the previous action, port defaults to 0 (AT).
+//
+// Usage: cav_emu -m echo|source|sink [-N ms] [-f script] [-u UDC file]
+//                <functionfs mount point>
+//
+// "ready" is printed once the descriptors are written, the gadget can be
+// bound to a UDC from then on.
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/usb/cdc.h>
+#include <linux/usb/ch9.h>
+#include <linux/usb/functionfs.h>
+
+#define CAV_PORTS 2
+#define CAV_BUF_SIZE 16384
+#define CAV_HS_MPS 512
+// Larger than the 256 byte interrupt URB of the driver, to babble
+#define CAV_INT_HS_MPS 512
+
+enum cav_mode { CAV_ECHO, CAV_SOURCE, CAV_SINK };
+
+struct cav_port_desc {
+	struct usb_interface_descriptor intf;
+	struct usb_endpoint_descriptor_no_audio in;
+	struct usb_endpoint_descriptor_no_audio out;
+	struct usb_endpoint_descriptor_no_audio notify;
+} __attribute__((packed));
+
+struct cav_speed_desc {
+	struct usb_interface_descriptor filler[2];
+	struct cav_port_desc port[CAV_PORTS];
+} __attribute__((packed));
+
+static struct {
+	struct usb_functionfs_descs_head_v2 header;
+	__le32 fs_count;
+	__le32 hs_count;
+	struct cav_speed_desc fs;
+	struct cav_speed_desc hs;
+} __attribute__((packed)) descriptors;
+
+static struct usb_functionfs_strings_head strings;
+
+struct cav_port {
+	int in; // ep files, numbered in descriptor order
+	int out;
+	int notify;
+	int number;
+};
+
+static enum cav_mode mode;
+static struct cav_port ports[CAV_PORTS];
+static int notifyMs;
+static const char *scriptPath;
+static const char *udcPath;
+static volatile int slowMs;
+
+static void fill_ep(struct usb_endpoint_descriptor_no_audio *pEp,
+		    int address, int type, int maxPacket, int interval)
+{
+	pEp->bLength = sizeof(*pEp);
+	pEp->bDescriptorType = USB_DT_ENDPOINT;
+	pEp->bEndpointAddress = address;
+	pEp->bmAttributes = type;
+	pEp->wMaxPacketSize = htole16(maxPacket);
+	pEp->bInterval = interval;
+}
+
+static void fill_intf(struct usb_interface_descriptor *pIntf, int number,
+		      int endpoints)
+{
+	pIntf->bLength = sizeof(*pIntf);
+	pIntf->bDescriptorType = USB_DT_INTERFACE;
+	pIntf->bInterfaceNumber = number;
+	pIntf->bNumEndpoints = endpoints;
+	pIntf->bInterfaceClass = USB_CLASS_VENDOR_SPEC;
+	pIntf->bInterfaceSubClass = USB_CLASS_VENDOR_SPEC;
+	pIntf->bInterfaceProtocol = USB_CLASS_VENDOR_SPEC;
+}
+
+// Endpoint addresses only identify the endpoints to FunctionFS, it picks
+// the UDC endpoints itself
+static void fill_speed(struct cav_speed_desc *pDesc, int bulkMps,
+		       int intMps, int interval)
+{
+	int port, ep;
+
+	fill_intf(&pDesc->filler[0], 0, 0);
+	fill_intf(&pDesc->filler[1], 1, 0);
+	for (port = 0; port < CAV_PORTS; port++) {
+		ep = 1 + port * 3;
+		fill_intf(&pDesc->port[port].intf, 2 + port, 3);
+		fill_ep(&pDesc->port[port].in, USB_DIR_IN | ep,
+			USB_ENDPOINT_XFER_BULK, bulkMps, 0);
+		fill_ep(&pDesc->port[port].out, USB_DIR_OUT | (ep + 1),
+			USB_ENDPOINT_XFER_BULK, bulkMps, 0);
+		fill_ep(&pDesc->port[port].notify, USB_DIR_IN | (ep + 2),
+			USB_ENDPOINT_XFER_INT, intMps, interval);
+	}
+}
+
+static void write_descriptors(int ep0)
+{
+	int count = 2 + CAV_PORTS * 4;
+
+	descriptors.header.magic = htole32(FUNCTIONFS_DESCRIPTORS_MAGIC_V2);
+	descriptors.header.flags =
+		htole32(FUNCTIONFS_HAS_FS_DESC | FUNCTIONFS_HAS_HS_DESC);
+	descriptors.header.length = htole32(sizeof(descriptors));
+	descriptors.fs_count = htole32(count);
+	descriptors.hs_count = htole32(count);
+	fill_speed(&descriptors.fs, 64, 64, 32);
+	fill_speed(&descriptors.hs, CAV_HS_MPS, CAV_INT_HS_MPS, 9);
+
+	strings.magic = htole32(FUNCTIONFS_STRINGS_MAGIC);
+	strings.length = htole32(sizeof(strings));
+
+	if ((write(ep0, &descriptors, sizeof(descriptors)) < 0) ||
+	    (write(ep0, &strings, sizeof(strings)) < 0)) {
+		perror("cav_emu: descriptors");
+		exit(1);
+	}
+}
+
+static int open_ep(const char *dir, int number)
+{
+	char path[4096];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/ep%d", dir, number);
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	return fd;
+}
+
+static ssize_t read_out(struct cav_port *pPort, char *buf)
+{
+	int ms = slowMs;
+
+	if (ms == 0) {
+		return read(pPort->out, buf, CAV_BUF_SIZE);
+	}
+	usleep(ms * 1000);
+	return read(pPort->out, buf, CAV_HS_MPS);
+}
+
+// I/O fails while the host has the configuration disabled, the next call
+// blocks until it is enabled again
+static void *port_thread(void *arg)
+{
+	struct cav_port *pPort = arg;
+	static const char line[] = "$GPGGA,123519,4807.038,N,01131.000,E,1,"
+				   "08,0.9,545.4,M,46.9,M,,*47\r\n";
+	char *buf = malloc(CAV_BUF_SIZE);
+	size_t used;
+	ssize_t len = 0;
+
+	if (buf == NULL) {
+		return NULL;
+	}
+	for (used = 0; used + sizeof(line) - 1 <= CAV_BUF_SIZE;
+	     used += sizeof(line) - 1) {
+		memcpy(buf + used, line, sizeof(line) - 1);
+	}
+
+	for (;;) {
+		switch (mode) {
+		case CAV_SOURCE:
+			len = write(pPort->in, buf, used);
+			break;
+		case CAV_SINK:
+			len = read_out(pPort, buf);
+			break;
+		case CAV_ECHO:
+			len = read_out(pPort, buf);
+			if (len <= 0) {
+				break;
+			}
+			write(pPort->in, buf, len);
+			if ((len % CAV_HS_MPS) == 0) {
+				// End the transfer for the host URB
+				write(pPort->in, buf, 0);
+			}
+			break;
+		}
+		if (len < 0) {
+			// Unbound, don't spin until the endpoints come back
+			usleep(1000);
+		}
+	}
+	return NULL;
+}
+
+// SERIAL_STATE with DCD set and DSR toggled every time
+static void *notify_thread(void *arg)
+{
+	struct cav_port *pPort = arg;
+	unsigned char msg[sizeof(struct usb_cdc_notification) + 2];
+	struct usb_cdc_notification *pNotify = (void *)msg;
+	int state = 0;
+
+	pNotify->bmRequestType = USB_DIR_IN | USB_TYPE_CLASS |
+				 USB_RECIP_INTERFACE;
+	pNotify->bNotificationType = USB_CDC_NOTIFY_SERIAL_STATE;
+	pNotify->wValue = 0;
+	pNotify->wIndex = htole16(pPort->number);
+	pNotify->wLength = htole16(2);
+	for (;;) {
+		usleep(notifyMs * 1000);
+		state ^= USB_CDC_SERIAL_STATE_DSR;
+		msg[sizeof(*pNotify)] = USB_CDC_SERIAL_STATE_DCD | state;
+		msg[sizeof(*pNotify) + 1] = 0;
+		if (write(pPort->notify, msg, sizeof(msg)) < 0) {
+			usleep(1000);
+		}
+	}
+	return NULL;
+}
+
+// FunctionFS halts an endpoint on I/O in the wrong direction. The halt is
+// set once the transfer in progress on the endpoint has finished.
+static void stall(int fd, int in)
+{
+	char byte = 0;
+
+	if (in) {
+		read(fd, &byte, 1);
+	} else {
+		write(fd, &byte, 1);
+	}
+}
+
+static void set_udc(const char *pName)
+{
+	FILE *pFile = fopen(udcPath, "w");
+
+	if (pFile == NULL) {
+		perror(udcPath);
+		return;
+	}
+	fprintf(pFile, "%s\n", pName);
+	fclose(pFile);
+}
+
+static void disconnect(int ms)
+{
+	char udc[256] = "";
+	FILE *pFile;
+
+	if (udcPath == NULL) {
+		fprintf(stderr, "cav_emu: disconnect needs -u\n");
+		return;
+	}
+	pFile = fopen(udcPath, "r");
+	if ((pFile == NULL) || (fgets(udc, sizeof(udc), pFile) == NULL)) {
+		perror(udcPath);
+		if (pFile != NULL) {
+			fclose(pFile);
+		}
+		return;
+	}
+	fclose(pFile);
+	udc[strcspn(udc, "\n")] = 0;
+	set_udc("");
+	usleep(ms * 1000);
+	set_udc(udc);
+}
+
+static void run_action(const char *pAction, const char *pArg, int port)
+{
+	char big[CAV_INT_HS_MPS] = { 0 };
+
+	if ((strcmp(pAction, "stall") == 0) && (strcmp(pArg, "in") == 0)) {
+		stall(ports[port].in, 1);
+	} else if ((strcmp(pAction, "stall") == 0) &&
+		   (strcmp(pArg, "out") == 0)) {
+		stall(ports[port].out, 0);
+	} else if ((strcmp(pAction, "stall") == 0) &&
+		   (strcmp(pArg, "int") == 0)) {
+		stall(ports[port].notify, 1);
+	} else if (strcmp(pAction, "babble") == 0) {
+		write(ports[port].notify, big, sizeof(big));
+	} else if (strcmp(pAction, "slow") == 0) {
+		slowMs = atoi(pArg);
+	} else if (strcmp(pAction, "disconnect") == 0) {
+		disconnect(atoi(pArg));
+	} else {
+		fprintf(stderr, "cav_emu: unknown action %s\n", pAction);
+	}
+}
+
+// Waits for SIGUSR1, blocked in all threads, then runs the script once
+static void *fault_thread(void *arg)
+{
+	sigset_t *pSet = arg;
+	char line[256], action[32], arg1[32], arg2[32];
+	FILE *pFile;
+	int sig, delay, fields, port;
+
+	sigwait(pSet, &sig);
+	pFile = fopen(scriptPath, "r");
+	if (pFile == NULL) {
+		perror(scriptPath);
+		return NULL;
+	}
+	while (fgets(line, sizeof(line), pFile) != NULL) {
+		arg1[0] = arg2[0] = 0;
+		fields = sscanf(line, "%d %31s %31s %31s", &delay, action, arg1,
+				arg2);
+		if (fields < 2) {
+			continue;
+		}
+		// The port is the second argument of stall, the first of babble
+		port = atoi(strcmp(action, "babble") == 0 ? arg1 : arg2);
+		if ((port < 0) || (port >= CAV_PORTS)) {
+			port = 0;
+		}
+		usleep(delay * 1000);
+		fprintf(stderr, "cav_emu: %s %s %s\n", action, arg1, arg2);
+		run_action(action, arg1, port);
+	}
+	fclose(pFile);
+	return NULL;
+}
+
+static void start_thread(void *(*run)(void *), void *arg)
+{
+	pthread_t thread;
+
+	if (pthread_create(&thread, NULL, run, arg) != 0) {
+		fprintf(stderr, "cav_emu: no thread\n");
+		exit(1);
+	}
+}
+
+// Accept every class request: zeros for IN, data is discarded for OUT
+static void handle_setup(int ep0, const struct usb_ctrlrequest *pSetup)
+{
+	unsigned char buf[256];
+	size_t len = le16toh(pSetup->wLength);
+
+	if (len > sizeof(buf)) {
+		len = sizeof(buf);
+	}
+	if ((pSetup->bRequestType & USB_DIR_IN) != 0) {
+		memset(buf, 0, len);
+		write(ep0, buf, len);
+	} else {
+		read(ep0, buf, len);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct usb_functionfs_event events[4];
+	sigset_t set;
+	const char *dir;
+	char path[4096];
+	ssize_t len;
+	int opt, ep0, port, index;
+
+	mode = CAV_ECHO;
+	while ((opt = getopt(argc, argv, "m:N:f:u:")) != -1) {
+		if (opt == 'N') {
+			notifyMs = atoi(optarg);
+		} else if (opt == 'f') {
+			scriptPath = optarg;
+		} else if (opt == 'u') {
+			udcPath = optarg;
+		} else if ((opt == 'm') && (strcmp(optarg, "echo") == 0)) {
+			mode = CAV_ECHO;
+		} else if ((opt == 'm') && (strcmp(optarg, "source") == 0)) {
+			mode = CAV_SOURCE;
+		} else if ((opt == 'm') && (strcmp(optarg, "sink") == 0)) {
+			mode = CAV_SINK;
+		} else {
+			optind = argc;
+			break;
+		}
+	}
+	if (optind != argc - 1) {
+		fprintf(stderr, "usage: cav_emu -m echo|source|sink [-N ms] "
+				"[-f script] [-u UDC file] <functionfs dir>\n");
+		return 1;
+	}
+	dir = argv[optind];
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	snprintf(path, sizeof(path), "%s/ep0", dir);
+	ep0 = open(path, O_RDWR);
+	if (ep0 < 0) {
+		perror(path);
+		return 1;
+	}
+	write_descriptors(ep0);
+
+	for (port = 0; port < CAV_PORTS; port++) {
+		ports[port].in = open_ep(dir, 1 + port * 3);
+		ports[port].out = open_ep(dir, 2 + port * 3);
+		ports[port].notify = open_ep(dir, 3 + port * 3);
+		ports[port].number = 2 + port;
+		start_thread(port_thread, &ports[port]);
+	}
+	if (notifyMs > 0) {
+		start_thread(notify_thread, &ports[0]);
+	}
+	if (scriptPath != NULL) {
+		start_thread(fault_thread, &set);
+	}
+	printf("ready\n");
+	fflush(stdout);
+
+	for (;;) {
+		len = read(ep0, events, sizeof(events));
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("cav_emu: ep0");
+			return 1;
+		}
+		for (index = 0; index < len / (ssize_t)sizeof(events[0]);
+		     index++) {
+			if (events[index].type == FUNCTIONFS_SETUP) {
+				handle_setup(ep0, &events[index].u.setup);
+			}
+		}
+	}
+}
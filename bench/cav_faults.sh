@@ -0,0 +1,86 @@
+#!/bin/bash
+#
+# Fault recovery suite for CavQMSerial, run by "make faults".
+#
+# Runs against a C10QM modem emulated by bench/cav_gadget.sh. For every
+# fault class cav_bench probes the AT port (see bench/cav_bench.c) while
+# the emulator echoes and sends a SERIAL_STATE notification every 10 ms.
+# One second into the run the fault is injected:
+#   none        no fault, the baseline
+#   stall-in    bulk-IN endpoint halted
+#   stall-out   bulk-OUT endpoint halted
+#   stall-int   interrupt endpoint halted
+#   eproto      -EPROTO storm of -e completions on the interrupt pipe,
+#               injected by the driver (CONFIG_FAULT_INJECTION_DEBUG_FS)
+#   babble      -EOVERFLOW on the interrupt pipe
+#   disconnect  surprise disconnect for 200 ms while writing
+#   slow        bulk-OUT drains one packet per 20 ms for 2 s
+# Every row reports the longest gap in the echoed data and in the
+# notifications in milliseconds, the lines written and lost and how often
+# the port had to be reopened.
+#
+# Usage: sudo bench/cav_faults.sh [-t seconds] [-e count] [-k module]
+
+set -u
+
+MAX_DEVICES=1
+SECONDS_PER_RUN=5
+EPROTO_COUNT=100
+MODULE=./CavQMSerial_mod.ko
+NOTIFY_MS=10
+FAIL_INT=/sys/kernel/debug/CavQMSerial/fail_int
+
+while getopts "t:e:k:h" opt; do
+	case $opt in
+	t) SECONDS_PER_RUN=$OPTARG ;;
+	e) EPROTO_COUNT=$OPTARG ;;
+	k) MODULE=$OPTARG ;;
+	*)
+		sed -n '3,22p' "$0"
+		exit 1
+		;;
+	esac
+done
+
+. "$(dirname "$0")/cav_gadget.sh"
+gadget_setup
+
+# run_fault <name> <script> [command]: probe the AT port, one second in
+# the emulator runs <script> and the shell runs <command>
+run_fault() {
+	local probe
+
+	printf "%b\n" "$2" >"$RUN/fault.script"
+	run_emus 1 echo -N "$NOTIFY_MS" -f "$RUN/fault.script"
+	"$BENCH/cav_bench" -t "$SECONDS_PER_RUN" -l "$1" probe \
+		$(host_ports 0 2) &
+	probe=$!
+	sleep 1
+	kill -USR1 "$(cat "$RUN/emu0.pid")"
+	if [ $# -gt 2 ]; then
+		eval "$3"
+	fi
+	wait $probe
+	stop_emus
+}
+
+printf "%-12s %5s %9s %9s %9s %9s %7s\n" fault ports data_ms notify_ms \
+	sent lost reopens
+
+run_fault none ""
+run_fault stall-in "0 stall in"
+run_fault stall-out "0 stall out"
+run_fault stall-int "0 stall int"
+if [ -d "$FAIL_INT" ]; then
+	echo 0 >"$FAIL_INT/verbose"
+	echo 1 >"$FAIL_INT/interval"
+	echo 100 >"$FAIL_INT/probability"
+	echo 0 >"$FAIL_INT/times"
+	run_fault eproto "" "echo $EPROTO_COUNT >$FAIL_INT/times"
+	echo 0 >"$FAIL_INT/probability"
+else
+	echo "eproto       skipped, needs CONFIG_FAULT_INJECTION_DEBUG_FS"
+fi
+run_fault babble "0 babble"
+run_fault disconnect "0 disconnect 200"
+run_fault slow "0 slow 20\n2000 slow 0"
@@ -0,0 +1,165 @@
+# Emulated C10QM modems for the scripts in bench/, sourced after they set
+# MAX_DEVICES and MODULE.
+#
+# Each modem is a dummy_hcd and configfs gadget with VID 0x05C6 / PID
+# 0x9025 and one FunctionFS function served by bench/cav_emu, which
+# exposes the AT (2) and GNSS (3) interfaces with bulk-IN, bulk-OUT and
+# interrupt-IN endpoints. gadget_setup loads the modules and creates the
+# gadgets, they are removed on exit.
+
+GADGETS=/sys/kernel/config/usb_gadget
+DRIVER="/sys/bus/usb-serial/drivers/CavSerial driver"
+PREFIX=cavloop
+BENCH=$(dirname "$0")
+
+bound_ports() {
+	ls "$DRIVER" 2>/dev/null | grep -c '^ttyUSB'
+}
+
+# wait_ports <count>: wait up to 30 s for the driver to own <count> ports
+wait_ports() {
+	local deadline=$(($(date +%s) + 30))
+
+	while [ "$(bound_ports)" -ne "$1" ]; do
+		if [ "$(date +%s)" -ge "$deadline" ]; then
+			echo "timeout waiting for $1 ports, have $(bound_ports)" >&2
+			return 1
+		fi
+		sleep 0.01
+	done
+}
+
+# make_gadget <index>: modem emulation bound to dummy_udc.<index> later
+make_gadget() {
+	local g=$GADGETS/$PREFIX$1
+
+	mkdir -p "$g/strings/0x409" "$g/configs/c.1/strings/0x409"
+	echo 0x05c6 >"$g/idVendor"
+	echo 0x9025 >"$g/idProduct"
+	echo "CAVLI" >"$g/strings/0x409/manufacturer"
+	echo "C10QM loopback $1" >"$g/strings/0x409/product"
+	printf "loop%04d" "$1" >"$g/strings/0x409/serialnumber"
+	echo "loopback" >"$g/configs/c.1/strings/0x409/configuration"
+	mkdir -p "$g/functions/ffs.$PREFIX$1"
+	ln -s "$g/functions/ffs.$PREFIX$1" "$g/configs/c.1/" 2>/dev/null
+	mkdir -p "$RUN/ffs$1"
+	mount -t functionfs "$PREFIX$1" "$RUN/ffs$1"
+}
+
+remove_gadget() {
+	local g=$GADGETS/$PREFIX$1
+
+	[ -d "$g" ] || return
+	echo "" >"$g/UDC" 2>/dev/null
+	stop_emu "$1"
+	umount "$RUN/ffs$1" 2>/dev/null
+	rm -f "$g/configs/c.1/ffs.$PREFIX$1"
+	rmdir "$g/configs/c.1/strings/0x409" "$g/configs/c.1" 2>/dev/null
+	rmdir "$g/functions/ffs.$PREFIX$1" 2>/dev/null
+	rmdir "$g/strings/0x409" "$g" 2>/dev/null
+}
+
+# start_emu <index> <mode> [cav_emu options]: serve the gadget, then plug it
+start_emu() {
+	local index=$1 mode=$2
+
+	shift 2
+	"$BENCH/cav_emu" -m "$mode" -u "$GADGETS/$PREFIX$index/UDC" "$@" \
+		"$RUN/ffs$index" >"$RUN/emu$index.log" 2>&1 &
+	echo $! >"$RUN/emu$index.pid"
+	while ! grep -q ready "$RUN/emu$index.log" 2>/dev/null; do
+		if ! kill -0 "$(cat "$RUN/emu$index.pid")" 2>/dev/null; then
+			cat "$RUN/emu$index.log" >&2
+			return 1
+		fi
+		sleep 0.01
+	done
+	echo "dummy_udc.$index" >"$GADGETS/$PREFIX$index/UDC"
+}
+
+# stop_emu <index>: unplug the gadget and stop its emulator
+stop_emu() {
+	echo "" >"$GADGETS/$PREFIX$1/UDC" 2>/dev/null
+	if [ -f "$RUN/emu$1.pid" ]; then
+		kill "$(cat "$RUN/emu$1.pid")" 2>/dev/null
+		wait "$(cat "$RUN/emu$1.pid")" 2>/dev/null
+		rm -f "$RUN/emu$1.pid"
+	fi
+}
+
+# run_emus <count> <mode> [cav_emu options]: plug <count> modems in <mode>
+run_emus() {
+	local count=$1 i
+
+	shift
+	for i in $(seq 0 $((count - 1))); do
+		start_emu "$i" "$@" || exit 1
+	done
+	wait_ports $((count * 2)) || exit 1
+}
+
+stop_emus() {
+	local i
+
+	for i in $(seq 0 $((MAX_DEVICES - 1))); do
+		stop_emu "$i"
+	done
+	wait_ports 0 || exit 1
+}
+
+# host_ports <gadget> [interface]: ttyUSB nodes of a plugged gadget
+host_ports() {
+	local port path
+
+	for port in $(ls "$DRIVER" | grep '^ttyUSB'); do
+		path=$(readlink -f "$DRIVER/$port")
+		case $path in
+		*/dummy_hcd.$1/*:1.${2:-[23]}/*)
+			echo "/dev/$port"
+			;;
+		esac
+	done
+}
+
+gadget_cleanup() {
+	local i
+
+	for i in $(seq 0 $((MAX_DEVICES - 1))); do
+		remove_gadget "$i"
+	done
+	rm -rf "$RUN"
+}
+
+gadget_setup() {
+	local i tool
+
+	if [ "$(id -u)" != 0 ]; then
+		echo "must run as root" >&2
+		exit 1
+	fi
+	if [ "$MAX_DEVICES" -lt 1 ] || [ "$MAX_DEVICES" -gt 32 ]; then
+		echo "max_devices must be 1-32" >&2
+		exit 1
+	fi
+	for tool in cav_emu cav_bench; do
+		if [ ! -x "$BENCH/$tool" ]; then
+			echo "$BENCH/$tool missing, run make bench" >&2
+			exit 1
+		fi
+	done
+
+	RUN=$(mktemp -d)
+	trap gadget_cleanup EXIT
+	modprobe libcomposite || exit 1
+	modprobe usb_f_fs || exit 1
+	modprobe dummy_hcd num="$MAX_DEVICES" || exit 1
+	mountpoint -q /sys/kernel/config ||
+		mount -t configfs none /sys/kernel/config
+	if [ ! -d "$DRIVER" ]; then
+		insmod "$MODULE" || exit 1
+	fi
+
+	for i in $(seq 0 $((MAX_DEVICES - 1))); do
+		make_gadget "$i"
+	done
+}
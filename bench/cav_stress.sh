@@ -0,0 +1,226 @@
+#!/bin/bash
+#
+# Multi-device stress benchmark for CavQMSerial.
+#
+# Emulates N C10QM modems with dummy_hcd and configfs gadgets. Every
+# gadget exposes four generic serial functions, so the driver binds to
+# interfaces 2 (AT) and 3 (GNSS) exactly as on the real module. For each
+# N (powers of two up to max_devices) the script reports
+#   - probe throughput: ports bound per second when N modems plug at once
+#   - RX/TX throughput per port with every port streaming in both
+#     directions while one extra modem is unplugged and replugged in a loop
+#   - unplug time of the N modems
+#
+# Usage: sudo bench/cav_stress.sh [-n max_devices] [-t seconds] [-k module]
+#
+# max_devices is limited by dummy_hcd to 31, one more UDC is used for the
+# plug/unplug loop. The driver module defaults to ./CavQMSerial_mod.ko.
+
+set -u
+
+MAX_DEVICES=8
+SECONDS_PER_RUN=5
+MODULE=./CavQMSerial_mod.ko
+GADGETS=/sys/kernel/config/usb_gadget
+DRIVER="/sys/bus/usb-serial/drivers/CavSerial driver"
+PREFIX=cavbench
+
+while getopts "n:t:k:h" opt; do
+	case $opt in
+	n) MAX_DEVICES=$OPTARG ;;
+	t) SECONDS_PER_RUN=$OPTARG ;;
+	k) MODULE=$OPTARG ;;
+	*)
+		sed -n '3,19p' "$0"
+		exit 1
+		;;
+	esac
+done
+
+if [ "$(id -u)" != 0 ]; then
+	echo "must run as root" >&2
+	exit 1
+fi
+if [ "$MAX_DEVICES" -lt 1 ] || [ "$MAX_DEVICES" -gt 31 ]; then
+	echo "max_devices must be 1-31" >&2
+	exit 1
+fi
+UDCS=$((MAX_DEVICES + 1))
+CHURN=$MAX_DEVICES
+
+now_ns() {
+	date +%s%N
+}
+
+bound_ports() {
+	ls "$DRIVER" 2>/dev/null | grep -c '^ttyUSB'
+}
+
+# wait_ports <count>: wait up to 30 s for the driver to own <count> ports
+wait_ports() {
+	local deadline=$(($(date +%s) + 30))
+
+	while [ "$(bound_ports)" -ne "$1" ]; do
+		if [ "$(date +%s)" -ge "$deadline" ]; then
+			echo "timeout waiting for $1 ports, have $(bound_ports)" >&2
+			return 1
+		fi
+		sleep 0.01
+	done
+}
+
+# make_gadget <index>: modem emulation bound to dummy_udc.<index> later
+make_gadget() {
+	local g=$GADGETS/$PREFIX$1
+	local f
+
+	mkdir -p "$g/strings/0x409" "$g/configs/c.1/strings/0x409"
+	echo 0x05c6 >"$g/idVendor"
+	echo 0x9025 >"$g/idProduct"
+	echo "CAVLI" >"$g/strings/0x409/manufacturer"
+	echo "C10QM bench $1" >"$g/strings/0x409/product"
+	printf "bench%04d" "$1" >"$g/strings/0x409/serialnumber"
+	echo "serial" >"$g/configs/c.1/strings/0x409/configuration"
+	for f in 0 1 2 3; do
+		mkdir -p "$g/functions/gser.$f"
+		ln -s "$g/functions/gser.$f" "$g/configs/c.1/" 2>/dev/null
+	done
+}
+
+remove_gadget() {
+	local g=$GADGETS/$PREFIX$1
+	local f
+
+	[ -d "$g" ] || return
+	echo "" >"$g/UDC" 2>/dev/null
+	rm -f "$g"/configs/c.1/gser.*
+	rmdir "$g/configs/c.1/strings/0x409" "$g/configs/c.1" 2>/dev/null
+	for f in 0 1 2 3; do
+		rmdir "$g/functions/gser.$f" 2>/dev/null
+	done
+	rmdir "$g/strings/0x409" "$g" 2>/dev/null
+}
+
+plug() {
+	echo "dummy_udc.$1" >"$GADGETS/$PREFIX$1/UDC"
+}
+
+unplug() {
+	echo "" >"$GADGETS/$PREFIX$1/UDC"
+}
+
+# gadget_tty <gadget> <interface>: ttyGS node of a gser function
+gadget_tty() {
+	echo "/dev/ttyGS$(cat "$GADGETS/$PREFIX$1/functions/gser.$2/port_num")"
+}
+
+# host_ports <gadget>: "ttyUSBn interface" pairs of a plugged gadget
+host_ports() {
+	local port path
+
+	for port in $(ls "$DRIVER" | grep '^ttyUSB'); do
+		path=$(readlink -f "$DRIVER/$port")
+		case $path in
+		*/dummy_hcd.$1/*)
+			echo "$port ${path##*:1.}" | sed 's,/.*,,'
+			;;
+		esac
+	done
+}
+
+cleanup() {
+	local i
+
+	jobs -p | xargs -r kill 2>/dev/null
+	wait 2>/dev/null
+	for i in $(seq 0 $((UDCS - 1))); do
+		remove_gadget "$i"
+	done
+}
+trap cleanup EXIT
+
+modprobe libcomposite || exit 1
+modprobe dummy_hcd num=$UDCS || exit 1
+mountpoint -q /sys/kernel/config || mount -t configfs none /sys/kernel/config
+if [ ! -d "$DRIVER" ]; then
+	insmod "$MODULE" || exit 1
+fi
+
+for i in $(seq 0 $((UDCS - 1))); do
+	make_gadget "$i"
+done
+
+# Plug and unplug the spare modem until the stop file appears
+churn() {
+	local cycles=0
+
+	while [ ! -e "$1" ]; do
+		plug $CHURN
+		sleep 0.2
+		unplug $CHURN
+		sleep 0.1
+		cycles=$((cycles + 1))
+	done
+	echo $cycles >"$1.cycles"
+}
+
+printf "%8s %6s %10s %10s %12s %12s %8s %10s\n" devices ports probe_ms \
+	probes/s rx_MB/s/port tx_MB/s/port churn unplug_ms
+
+n=1
+while [ $n -le "$MAX_DEVICES" ]; do
+	tmp=$(mktemp -d)
+
+	# Probe throughput
+	start=$(now_ns)
+	for i in $(seq 0 $((n - 1))); do
+		plug "$i"
+	done
+	wait_ports $((n * 2)) || exit 1
+	probe_ms=$((($(now_ns) - start) / 1000000))
+
+	# Traffic on every port in both directions, the gadget side counts
+	# TX bytes and the host side counts RX bytes
+	pids=""
+	for i in $(seq 0 $((n - 1))); do
+		while read -r port intf; do
+			gs=$(gadget_tty "$i" "$intf")
+			stty -F "/dev/$port" raw -echo
+			stty -F "$gs" raw -echo
+			(timeout "$SECONDS_PER_RUN" cat "$gs" | wc -c >"$tmp/tx.$port") &
+			pids="$pids $!"
+			(timeout "$SECONDS_PER_RUN" cat "/dev/$port" | wc -c >"$tmp/rx.$port") &
+			pids="$pids $!"
+			timeout "$SECONDS_PER_RUN" dd if=/dev/zero of="/dev/$port" bs=4k 2>/dev/null &
+			timeout "$SECONDS_PER_RUN" dd if=/dev/zero of="$gs" bs=4k 2>/dev/null &
+		done < <(host_ports "$i")
+	done
+	churn "$tmp/stop" &
+	churn_pid=$!
+	wait $pids
+	touch "$tmp/stop"
+	wait $churn_pid
+	wait
+
+	rx=$(cat "$tmp"/rx.* | awk '{ s += $1 } END { print s + 0 }')
+	tx=$(cat "$tmp"/tx.* | awk '{ s += $1 } END { print s + 0 }')
+	ports=$((n * 2))
+
+	# Unplug time
+	start=$(now_ns)
+	for i in $(seq 0 $((n - 1))); do
+		unplug "$i"
+	done
+	wait_ports 0 || exit 1
+	unplug_ms=$((($(now_ns) - start) / 1000000))
+
+	awk -v n=$n -v p=$ports -v ms=$probe_ms -v rx=$rx -v tx=$tx \
+		-v t="$SECONDS_PER_RUN" -v c="$(cat "$tmp/stop.cycles")" \
+		-v ums=$unplug_ms 'BEGIN {
+		printf "%8d %6d %10d %10.1f %12.2f %12.2f %8d %10d\n", n, p, ms,
+			p * 1000 / (ms ? ms : 1), rx / p / t / 1e6,
+			tx / p / t / 1e6, c, ums
+	}'
+	rm -rf "$tmp"
+	n=$((n * 2))
+done